@@ -1,3 +1,54 @@
+-- Core renderer: no Walnut/Vulkan dependency, shared by the app and the headless renderer
+project "RayTracingCore"
+   kind "StaticLib"
+   language "C++"
+   cppdialect "C++17"
+   staticruntime "off"
+
+   files { "src/Core/**.h", "src/Core/**.cpp" }
+
+   includedirs
+   {
+      "src/Core",
+      "../Walnut/vendor/glm",
+   }
+
+   targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
+   objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
+
+   -- Specialised render kernels (see RT_RENDER_KERNELS in src/Core/Renderer.h)
+   local renderKernels = { dynamic = 0, options = 1, full = 2 }
+   defines { "RT_RENDER_KERNELS=" .. renderKernels[_OPTIONS["render-kernels"] or "full"] }
+
+   -- Runtime dispatched AVX2 kernels (spheres, denoiser, resolve), the rest of the core stays baseline x64
+   filter { "files:src/Core/*AVX2.cpp", "action:vs*" }
+      buildoptions { "/arch:AVX2" }
+
+   filter { "files:src/Core/*AVX2.cpp", "action:not vs*" }
+      buildoptions { "-mavx2" }
+
+   filter "system:windows"
+      systemversion "latest"
+
+   filter "configurations:Debug"
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   -- Profiler zones and counters (src/Core/Profiler.h) are compiled out of shipping builds
+   filter "configurations:Dist"
+      defines { "RT_PROFILE=0" }
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
+
+   filter {}
+
+if not _OPTIONS["headless"] then
 project "RayTracing"
    kind "ConsoleApp"
    language "C++"
@@ -5,7 +56,7 @@ project "RayTracing"
    targetdir "bin/%{cfg.buildcfg}"
    staticruntime "off"
 
-   files { "src/**.h", "src/**.cpp" }
+   files { "src/*.h", "src/*.cpp" }
 
    includedirs
    {
@@ -16,11 +67,14 @@ project "RayTracing"
       "../Walnut/Walnut/src",
 
       "%{IncludeDir.VulkanSDK}",
+
+      "src/Core",
    }
 
    links
    {
-       "Walnut"
+       "Walnut",
+       "RayTracingCore"
    }
 
    targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
@@ -30,6 +84,9 @@ project "RayTracing"
       systemversion "latest"
       defines { "WL_PLATFORM_WINDOWS" }
 
+   filter "system:linux"
+      links { "pthread" }
+
    filter "configurations:Debug"
       defines { "WL_DEBUG" }
       runtime "Debug"
@@ -43,7 +100,97 @@ project "RayTracing"
 
    filter "configurations:Dist"
       kind "WindowedApp"
-      defines { "WL_DIST" }
+      defines { "WL_DIST", "RT_PROFILE=0" }
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
+
+   filter {}
+end
+
+-- Offline renderer for machines without a GPU: renders a scene to a ppm/png/exr file from the command line
+project "RayTracingHeadless"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++17"
+   staticruntime "off"
+
+   files { "src/Headless/**.h", "src/Headless/**.cpp" }
+
+   includedirs
+   {
+      "src/Core",
+      "../Walnut/vendor/glm",
+   }
+
+   links
+   {
+       "RayTracingCore"
+   }
+
+   targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
+   objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
+
+   filter "system:windows"
+      systemversion "latest"
+
+   filter "system:linux"
+      links { "pthread" }
+
+   filter "configurations:Debug"
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   filter "configurations:Dist"
+      defines { "RT_PROFILE=0" }
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
+
+project "RayTracingBenchmark"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++17"
+   staticruntime "off"
+
+   files { "src/Benchmark/**.h", "src/Benchmark/**.cpp" }
+
+   includedirs
+   {
+      "src/Core",
+      "../Walnut/vendor/glm",
+   }
+
+   links
+   {
+       "RayTracingCore"
+   }
+
+   targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
+   objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
+
+   filter "system:windows"
+      systemversion "latest"
+
+   filter "system:linux"
+      links { "pthread" }
+
+   filter "configurations:Debug"
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   filter "configurations:Dist"
+      defines { "RT_PROFILE=0" }
       runtime "Release"
       optimize "On"
-      symbols "Off"
\ No newline at end of file
+      symbols "Off"
@@ -0,0 +1,289 @@
+#include "Renderer.h"
+#include "Camera.h"
+#include "Scenes.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <functional>
+
+//Renders a fixed set of scenes with fixed cameras, resolutions and thread counts and reports the throughput as JSON
+//Only Renderer::Render is timed - no UI, no upload, no window size - so results can be compared between builds
+//Usage: RayTracingBenchmark [--width N] [--height N] [--frames N] [--warmup N] [--spheres N]
+//                           [--threads 1,2,4,...] [--variants default,scalar,...] [--scenes two-spheres,...]
+//                           [--output results.json]
+
+struct BenchmarkScene
+{
+    std::string Name;
+    std::function<Scene()> Create;
+    glm::vec3 Position;
+    glm::vec3 Direction;
+};
+
+//Renderer configurations to compare, applied on top of the default settings
+struct BenchmarkVariant
+{
+    std::string Name;
+    std::function<void(Renderer::Settings&)> Apply;
+    SIMDLevel RequiredLevel = SIMDLevel::Scalar;
+};
+
+struct BenchmarkOptions
+{
+    uint32_t Width = 640;
+    uint32_t Height = 360;
+    uint32_t Frames = 16;
+    uint32_t Warmup = 2;
+    uint32_t Spheres = 100000;
+    std::vector<uint32_t> Threads;
+    std::vector<std::string> Variants{ "default", "scalar", "packets", "wavefront" };
+    std::vector<std::string> Scenes;
+    std::string Output;
+};
+
+struct BenchmarkResult
+{
+    std::string Scene, Variant;
+    uint32_t Threads = 0;
+    double MsPerFrame = 0.0, MedianMsPerFrame = 0.0, MinMsPerFrame = 0.0;
+    double RaysPerSecond = 0.0, SamplesPerSecond = 0.0, RaysPerSample = 0.0;
+    double ScalingEfficiency = 1.0;
+};
+
+static std::vector<std::string> SplitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while(start <= list.size())
+    {
+        size_t end = list.find(',', start);
+        if(end == std::string::npos)
+            end = list.size();
+        if(end > start)
+            items.push_back(list.substr(start, end - start));
+        start = end + 1;
+    }
+    return items;
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: RayTracingBenchmark [--width N] [--height N] [--frames N] [--warmup N] [--spheres N]\n"
+                    "                           [--threads 1,2,4,...] [--variants default,scalar,...] [--scenes two-spheres,...]\n"
+                    "                           [--output results.json]\n"
+                    "Variants: default scalar sse avx2 packets wavefront no-bvh no-roulette no-nee\n"
+                    "Scenes: two-spheres random-spheres rough-spheres mirror-spheres lit-spheres\n");
+}
+
+static bool ParseArguments(int argc, char** argv, BenchmarkOptions& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if(arg == "--width" && hasValue)
+            options.Width = (uint32_t)atoi(argv[++i]);
+        else if(arg == "--height" && hasValue)
+            options.Height = (uint32_t)atoi(argv[++i]);
+        else if(arg == "--frames" && hasValue)
+            options.Frames = (uint32_t)atoi(argv[++i]);
+        else if(arg == "--warmup" && hasValue)
+            options.Warmup = (uint32_t)atoi(argv[++i]);
+        else if(arg == "--spheres" && hasValue)
+            options.Spheres = (uint32_t)atoi(argv[++i]);
+        else if(arg == "--threads" && hasValue)
+        {
+            options.Threads.clear();
+            for(const std::string& count : SplitList(argv[++i]))
+                options.Threads.push_back((uint32_t)atoi(count.c_str()));
+        }
+        else if(arg == "--variants" && hasValue)
+            options.Variants = SplitList(argv[++i]);
+        else if(arg == "--scenes" && hasValue)
+            options.Scenes = SplitList(argv[++i]);
+        else if(arg == "--output" && hasValue)
+            options.Output = argv[++i];
+        else
+            return false;
+    }
+
+    //Default: 1 thread, powers of 2 and every core
+    if(options.Threads.empty())
+    {
+        uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+        for(uint32_t count = 1; count < cores; count *= 2)
+            options.Threads.push_back(count);
+        options.Threads.push_back(cores);
+    }
+    for(uint32_t count : options.Threads)
+        if(count == 0)
+            return false;
+    return options.Width > 0 && options.Height > 0 && options.Frames > 0;
+}
+
+static BenchmarkResult RunBenchmark(const BenchmarkOptions& options, const BenchmarkScene& benchmarkScene, const Scene& scene,
+    const BenchmarkVariant& variant, uint32_t threads)
+{
+    Camera camera(45.0f, 0.1f, 100.0f);
+    camera.OnResize(options.Width, options.Height);
+    camera.SetPosition(benchmarkScene.Position);
+    camera.SetDirection(benchmarkScene.Direction);
+
+    Renderer renderer;
+    Renderer::Settings& settings = renderer.GetSettings();
+    settings.ThreadCount = threads;
+    variant.Apply(settings);
+    renderer.OnResize(options.Width, options.Height);
+
+    //Warmup frames build the acceleration structures and start the threads
+    for(uint32_t i = 0; i < options.Warmup; i++)
+        renderer.Render(scene, camera);
+
+    std::vector<double> frameTimes;
+    uint64_t rays = 0, samples = 0;
+    for(uint32_t i = 0; i < options.Frames; i++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        renderer.Render(scene, camera);
+        auto end = std::chrono::high_resolution_clock::now();
+        frameTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        rays += renderer.GetRaysLastFrame();
+        samples += renderer.GetSamplesLastFrame();
+    }
+
+    BenchmarkResult result;
+    result.Scene = benchmarkScene.Name;
+    result.Variant = variant.Name;
+    result.Threads = threads;
+
+    double totalMs = 0.0;
+    for(double ms : frameTimes)
+        totalMs += ms;
+    std::sort(frameTimes.begin(), frameTimes.end());
+    result.MsPerFrame = totalMs / frameTimes.size();
+    //Even count: the mean of the 2 middle frames
+    size_t middle = frameTimes.size() / 2;
+    result.MedianMsPerFrame = frameTimes.size() % 2 ? frameTimes[middle] : (frameTimes[middle - 1] + frameTimes[middle]) / 2.0;
+    result.MinMsPerFrame = frameTimes.front();
+    result.RaysPerSecond = rays / (totalMs / 1000.0);
+    result.SamplesPerSecond = samples / (totalMs / 1000.0);
+    result.RaysPerSample = samples > 0 ? (double)rays / samples : 0.0;
+    return result;
+}
+
+static void WriteJSON(FILE* file, const BenchmarkOptions& options, const std::vector<BenchmarkResult>& results)
+{
+    fprintf(file, "{\n");
+    fprintf(file, "  \"benchmark\": \"RayTracingBenchmark\",\n");
+    fprintf(file, "  \"format_version\": 1,\n");
+    fprintf(file, "  \"config\": { \"width\": %u, \"height\": %u, \"frames\": %u, \"warmup\": %u, \"random_spheres\": %u, "
+        "\"hardware_threads\": %u, \"simd_supported\": \"%s\" },\n", options.Width, options.Height, options.Frames,
+        options.Warmup, options.Spheres, std::thread::hardware_concurrency(), SphereKernels::GetLevelName(SphereKernels::GetSupportedLevel()));
+    fprintf(file, "  \"results\": [\n");
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult& r = results[i];
+        fprintf(file, "    { \"scene\": \"%s\", \"variant\": \"%s\", \"threads\": %u, \"ms_per_frame\": %.4f, "
+            "\"ms_per_frame_median\": %.4f, \"ms_per_frame_min\": %.4f, \"mrays_per_second\": %.4f, "
+            "\"samples_per_second\": %.1f, \"rays_per_sample\": %.4f, \"scaling_efficiency\": %.4f }%s\n",
+            r.Scene.c_str(), r.Variant.c_str(), r.Threads, r.MsPerFrame, r.MedianMsPerFrame, r.MinMsPerFrame,
+            r.RaysPerSecond / 1e6, r.SamplesPerSecond, r.RaysPerSample, r.ScalingEfficiency, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    if(!ParseArguments(argc, argv, options))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    //Canonical scenes, every one stresses something else: few big spheres, many small ones (BVH), incoherent
+    //bounces, paths that always use every bounce, and shadow rays towards several lights
+    uint32_t sphereCount = options.Spheres;
+    std::vector<BenchmarkScene> scenes = {
+        { "two-spheres", []() { return Scenes::TwoSpheres(); }, { 0.0f, 0.0f, 5.0f }, { 0.0f, 0.0f, -1.0f } },
+        { "random-spheres", [sphereCount]() { return Scenes::RandomSpheres(sphereCount); }, { 0.0f, 3.0f, 10.0f }, { 0.0f, -0.3f, -1.0f } },
+        { "rough-spheres", []() { return Scenes::RoughSpheres(); }, { 0.0f, 1.5f, 6.0f }, { 0.0f, -0.3f, -1.0f } },
+        { "mirror-spheres", []() { return Scenes::MirrorSpheres(); }, { 0.0f, 0.0f, 0.0f }, { 0.3f, 0.1f, -1.0f } },
+        { "lit-spheres", []() { return Scenes::LitSpheres(); }, { 0.0f, 1.5f, 6.0f }, { 0.0f, -0.3f, -1.0f } },
+    };
+
+    std::vector<BenchmarkVariant> variants = {
+        { "default", [](Renderer::Settings&) {} },
+        { "scalar", [](Renderer::Settings& settings) { settings.SIMD = SIMDLevel::Scalar; } },
+        { "sse", [](Renderer::Settings& settings) { settings.SIMD = SIMDLevel::SSE; }, SIMDLevel::SSE },
+        { "avx2", [](Renderer::Settings& settings) { settings.SIMD = SIMDLevel::AVX2; }, SIMDLevel::AVX2 },
+        { "packets", [](Renderer::Settings& settings) { settings.PacketTracing = true; } },
+        { "wavefront", [](Renderer::Settings& settings) { settings.Wavefront = true; } },
+        { "no-bvh", [](Renderer::Settings& settings) { settings.UseBVH = false; } },
+        { "no-roulette", [](Renderer::Settings& settings) { settings.RussianRoulette = false; } },
+        { "no-nee", [](Renderer::Settings& settings) { settings.NextEventEstimation = false; } },
+    };
+
+    std::vector<BenchmarkResult> results;
+    for(const BenchmarkScene& benchmarkScene : scenes)
+    {
+        if(!options.Scenes.empty() && std::find(options.Scenes.begin(), options.Scenes.end(), benchmarkScene.Name) == options.Scenes.end())
+            continue;
+        Scene scene = benchmarkScene.Create();
+
+        for(const std::string& variantName : options.Variants)
+        {
+            auto variant = std::find_if(variants.begin(), variants.end(), [&](const BenchmarkVariant& v) { return v.Name == variantName; });
+            if(variant == variants.end())
+            {
+                fprintf(stderr, "Unknown variant %s\n", variantName.c_str());
+                PrintUsage();
+                return 1;
+            }
+            if(variant->RequiredLevel > SphereKernels::GetSupportedLevel())
+            {
+                fprintf(stderr, "Skipping %s: not supported by this cpu\n", variantName.c_str());
+                continue;
+            }
+
+            size_t first = results.size();
+            for(uint32_t threads : options.Threads)
+            {
+                BenchmarkResult result = RunBenchmark(options, benchmarkScene, scene, *variant, threads);
+                fprintf(stderr, "%-16s %-10s %3u threads: %9.3f ms/frame %9.2f Mrays/s\n", result.Scene.c_str(),
+                    result.Variant.c_str(), threads, result.MsPerFrame, result.RaysPerSecond / 1e6);
+                results.push_back(result);
+            }
+
+            //Scaling efficiency: speedup over the smallest thread count divided by how many times more threads were used
+            auto baseline = std::min_element(results.begin() + first, results.end(),
+                [](const BenchmarkResult& a, const BenchmarkResult& b) { return a.Threads < b.Threads; });
+            BenchmarkResult base = *baseline;
+            for(size_t i = first; i < results.size(); i++)
+            {
+                double speedup = results[i].RaysPerSecond / std::max(base.RaysPerSecond, 1.0);
+                results[i].ScalingEfficiency = speedup / ((double)results[i].Threads / base.Threads);
+            }
+        }
+    }
+
+    FILE* file = options.Output.empty() ? stdout : fopen(options.Output.c_str(), "w");
+    if(!file)
+    {
+        fprintf(stderr, "Failed to write %s\n", options.Output.c_str());
+        return 1;
+    }
+    WriteJSON(file, options, results);
+    if(file != stdout)
+    {
+        fclose(file);
+        fprintf(stderr, "Saved %s\n", options.Output.c_str());
+    }
+    return 0;
+}
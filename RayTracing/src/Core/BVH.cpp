@@ -0,0 +1,507 @@
+#include "BVH.h"
+#include "Intersect.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <thread>
+
+namespace Utils
+{
+    //Number of buckets the centroids get sorted in per axis when looking for the best split
+    static constexpr int BinCount = 16;
+    //Leaves never get bigger than this, even when splitting is more expensive according to the SAH
+    //1 AVX2 register of spheres
+    static constexpr uint32_t MaxLeafSize = SphereSoA::Padding;
+    //SAH cost of visiting a node relative to testing 1 sphere - spheres are tested 4/8 at a time, boxes 2 at a time
+    static constexpr float TraversalCost = 2.0f;
+    //Subtrees with more primitives than this get built on their own thread
+    static constexpr uint32_t ParallelBuildThreshold = 4096;
+    //Deeper nodes always become leaves - bounds the traversal stack
+    static constexpr int MaxDepth = 64;
+    //Parent of the root
+    static constexpr uint32_t NoParent = UINT32_MAX;
+
+    //Temporary tree used while building - flattened into BVHNode's afterwards
+    struct BuildNode
+    {
+        AABB Bounds;
+        uint32_t First = 0, Count = 0;
+        std::unique_ptr<BuildNode> Left, Right;
+        uint32_t NodeCount = 1; //Nodes in this subtree, including itself
+    };
+
+    struct BuildContext
+    {
+        std::vector<AABB> PrimitiveBounds;
+        std::vector<glm::vec3> Centroids;
+        std::vector<uint32_t>& Indices;
+    };
+
+    static std::unique_ptr<BuildNode> BuildRecursive(BuildContext& context, uint32_t first, uint32_t count, int depth, int parallelDepth)
+    {
+        auto node = std::make_unique<BuildNode>();
+        node->First = first;
+        node->Count = count;
+
+        AABB centroidBounds;
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            uint32_t index = context.Indices[i];
+            node->Bounds.Grow(context.PrimitiveBounds[index]);
+            centroidBounds.Grow(context.Centroids[index]);
+        }
+
+        if (count <= 2 || depth >= Utils::MaxDepth)
+            return node;
+
+        //Binned SAH: drop every centroid in 1 of BinCount buckets per axis and evaluate the split planes between buckets
+        //Cost of a split = area(left) * count(left) + area(right) * count(right), cost of a leaf = area * count
+        float bestCost = FLT_MAX;
+        int bestAxis = -1, bestSplit = 0;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float extent = centroidBounds.Max[axis] - centroidBounds.Min[axis];
+            if (extent <= 0.0f)
+                continue;
+
+            AABB binBounds[BinCount];
+            uint32_t binCount[BinCount] = {};
+            float scale = BinCount / extent;
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                uint32_t index = context.Indices[i];
+                int bin = std::min(BinCount - 1, (int)((context.Centroids[index][axis] - centroidBounds.Min[axis]) * scale));
+                binCount[bin]++;
+                binBounds[bin].Grow(context.PrimitiveBounds[index]);
+            }
+
+            //Sweep from both sides to get the area and count left and right of every plane
+            float leftArea[BinCount - 1], rightArea[BinCount - 1];
+            uint32_t leftCount[BinCount - 1], rightCount[BinCount - 1];
+            AABB leftBox, rightBox;
+            uint32_t leftSum = 0, rightSum = 0;
+            for (int i = 0; i < BinCount - 1; i++)
+            {
+                leftSum += binCount[i];
+                leftCount[i] = leftSum;
+                leftBox.Grow(binBounds[i]);
+                leftArea[i] = leftBox.HalfArea();
+
+                rightSum += binCount[BinCount - 1 - i];
+                rightCount[BinCount - 2 - i] = rightSum;
+                rightBox.Grow(binBounds[BinCount - 1 - i]);
+                rightArea[BinCount - 2 - i] = rightBox.HalfArea();
+            }
+
+            for (int i = 0; i < BinCount - 1; i++)
+            {
+                if (leftCount[i] == 0 || rightCount[i] == 0)
+                    continue;
+                float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+
+        //All centroids in the same spot or splitting doesnt pay off
+        float leafCost = node->Bounds.HalfArea() * count;
+        float splitCost = node->Bounds.HalfArea() * TraversalCost + bestCost;
+        if (bestAxis < 0 || (splitCost >= leafCost && count <= MaxLeafSize))
+            return node;
+
+        float scale = BinCount / (centroidBounds.Max[bestAxis] - centroidBounds.Min[bestAxis]);
+        auto middle = std::partition(context.Indices.begin() + first, context.Indices.begin() + first + count, [&](uint32_t index)
+        {
+            int bin = std::min(BinCount - 1, (int)((context.Centroids[index][bestAxis] - centroidBounds.Min[bestAxis]) * scale));
+            return bin <= bestSplit;
+        });
+        uint32_t leftCount = (uint32_t)(middle - context.Indices.begin()) - first;
+
+        //Children work on disjoint ranges of the index array, so big subtrees can be built at the same time
+        if (count > ParallelBuildThreshold && parallelDepth > 0)
+        {
+            auto left = std::async(std::launch::async, BuildRecursive, std::ref(context), first, leftCount, depth + 1, parallelDepth - 1);
+            node->Right = BuildRecursive(context, first + leftCount, count - leftCount, depth + 1, parallelDepth - 1);
+            node->Left = left.get();
+        }
+        else
+        {
+            node->Left = BuildRecursive(context, first, leftCount, depth + 1, 0);
+            node->Right = BuildRecursive(context, first + leftCount, count - leftCount, depth + 1, 0);
+        }
+        node->Count = 0;
+        node->NodeCount = 1 + node->Left->NodeCount + node->Right->NodeCount;
+        return node;
+    }
+
+    //Depth first: left child directly after its parent, right child after the whole left subtree
+    static uint32_t Flatten(const BuildNode& buildNode, std::vector<BVHNode>& nodes)
+    {
+        uint32_t index = (uint32_t)nodes.size();
+        nodes.push_back({ buildNode.Bounds.Min, buildNode.First, buildNode.Bounds.Max, buildNode.Count });
+        if (buildNode.Count == 0)
+        {
+            Flatten(*buildNode.Left, nodes);
+            nodes[index].LeftFirst = Flatten(*buildNode.Right, nodes);
+        }
+        return index;
+    }
+}
+
+void BVH::Build(const SceneArray<Sphere>& spheres)
+{
+    Clear();
+    if (spheres.empty())
+        return;
+
+    Utils::BuildContext context { {}, {}, m_PrimitiveIndices };
+    context.PrimitiveBounds.resize(spheres.size());
+    context.Centroids.resize(spheres.size());
+    m_PrimitiveIndices.resize(spheres.size());
+    for (uint32_t i = 0; i < (uint32_t)spheres.size(); i++)
+    {
+        const Sphere& sphere = spheres[i];
+        glm::vec3 radius(glm::abs(sphere.Radius));
+        context.PrimitiveBounds[i] = { sphere.Position - radius, sphere.Position + radius };
+        context.Centroids[i] = sphere.Position;
+        m_PrimitiveIndices[i] = i;
+    }
+
+    //Enough parallel levels to keep every core busy on the top of the tree
+    int parallelDepth = 1;
+    while ((1u << parallelDepth) < std::max(1u, std::thread::hardware_concurrency()))
+        parallelDepth++;
+
+    auto root = Utils::BuildRecursive(context, 0, (uint32_t)spheres.size(), 0, parallelDepth);
+    m_Nodes.reserve(root->NodeCount);
+    Utils::Flatten(*root, m_Nodes);
+    m_Spheres.Build(spheres, &m_PrimitiveIndices);
+}
+
+void BVH::Load(const BVHNode* nodes, uint32_t nodeCount, const uint32_t* primitiveIndices, const SceneArray<Sphere>& spheres)
+{
+    //Nodes and leaf order are copied as is, only the leaf ordered SoA gets rebuilt - no binning or sorting
+    Clear();
+    m_Nodes.assign(nodes, nodes + nodeCount);
+    m_PrimitiveIndices.assign(primitiveIndices, primitiveIndices + spheres.size());
+    m_Spheres.Build(spheres, &m_PrimitiveIndices);
+}
+
+bool BVH::IsValid(const BVHNode* nodes, uint32_t nodeCount, const uint32_t* primitiveIndices, uint32_t sphereCount)
+{
+    if (nodeCount == 0)
+        return false;
+    for (uint32_t i = 0; i < sphereCount; i++)
+        if (primitiveIndices[i] >= sphereCount)
+            return false;
+
+    //Children always come after their parent (left right after it), so depths are known by the time a node is reached
+    //A tree has 1 parent per node: a node shared by 2 parents could get the depth of the shallower one
+    std::vector<uint8_t> depths(nodeCount, 0);
+    std::vector<bool> reached(nodeCount, false);
+    for (uint32_t i = 0; i < nodeCount; i++)
+    {
+        const BVHNode& node = nodes[i];
+        if (node.IsLeaf())
+        {
+            if ((uint64_t)node.LeftFirst + node.Count > sphereCount)
+                return false;
+            continue;
+        }
+        //Every inner node on the way down can leave 1 child on the traversal stack
+        if (depths[i] >= Utils::MaxDepth || i + 1 >= nodeCount || node.LeftFirst <= i + 1 || node.LeftFirst >= nodeCount ||
+            reached[i + 1] || reached[node.LeftFirst])
+            return false;
+        reached[i + 1] = reached[node.LeftFirst] = true;
+        depths[i + 1] = depths[node.LeftFirst] = (uint8_t)(depths[i] + 1);
+    }
+    return true;
+}
+
+bool BVH::Refit(const SceneArray<Sphere>& spheres, const std::vector<SceneRange>& ranges, float maxCostRatio)
+{
+    if (m_Nodes.empty())
+        return true;
+    if (m_Parents.empty())
+        PrepareRefit();
+
+    size_t changed = 0;
+    for (const SceneRange& range : ranges)
+    {
+        for (size_t i = range.First; i < range.First + range.Count; i++)
+            m_Spheres.Set(m_SphereSlots[i], spheres[i], (uint32_t)i);
+        changed += range.Count;
+    }
+
+    if (changed * Utils::MaxDepth > m_Nodes.size())
+    {
+        //Lots of edits: cheaper to refit every node once, from the back - children are always stored after their parent
+        for (size_t i = m_Nodes.size(); i-- > 0;)
+            RefitNode((uint32_t)i, spheres);
+    }
+    else
+    {
+        //Walk up from the leaf, a box that didnt change means its ancestors dont either
+        for (const SceneRange& range : ranges)
+        {
+            for (size_t i = range.First; i < range.First + range.Count; i++)
+            {
+                uint32_t node = m_SlotLeaves[m_SphereSlots[i]];
+                while (node != Utils::NoParent && RefitNode(node, spheres))
+                    node = m_Parents[node];
+            }
+        }
+    }
+
+    AABB root { m_Nodes[0].BoundsMin, m_Nodes[0].BoundsMax };
+    double cost = m_AreaSum / std::max(root.HalfArea(), FLT_MIN);
+    return cost <= maxCostRatio * m_BuildCost;
+}
+
+void BVH::PrepareRefit()
+{
+    m_Parents.assign(m_Nodes.size(), Utils::NoParent);
+    m_SlotLeaves.resize(m_PrimitiveIndices.size());
+    m_SphereSlots.resize(m_PrimitiveIndices.size());
+    m_AreaSum = 0.0;
+    for (uint32_t i = 0; i < (uint32_t)m_Nodes.size(); i++)
+    {
+        const BVHNode& node = m_Nodes[i];
+        m_AreaSum += AABB{ node.BoundsMin, node.BoundsMax }.HalfArea();
+        if (node.IsLeaf())
+        {
+            for (uint32_t slot = node.LeftFirst; slot < node.LeftFirst + node.Count; slot++)
+                m_SlotLeaves[slot] = i;
+        }
+        else
+        {
+            m_Parents[i + 1] = i;
+            m_Parents[node.LeftFirst] = i;
+        }
+    }
+    for (uint32_t slot = 0; slot < (uint32_t)m_PrimitiveIndices.size(); slot++)
+        m_SphereSlots[m_PrimitiveIndices[slot]] = slot;
+
+    AABB root { m_Nodes[0].BoundsMin, m_Nodes[0].BoundsMax };
+    m_BuildCost = m_AreaSum / std::max(root.HalfArea(), FLT_MIN);
+}
+
+bool BVH::RefitNode(uint32_t index, const SceneArray<Sphere>& spheres)
+{
+    BVHNode& node = m_Nodes[index];
+    AABB bounds;
+    if (node.IsLeaf())
+    {
+        //Same boxes as the build uses
+        for (uint32_t slot = node.LeftFirst; slot < node.LeftFirst + node.Count; slot++)
+        {
+            const Sphere& sphere = spheres[m_PrimitiveIndices[slot]];
+            glm::vec3 radius(glm::abs(sphere.Radius));
+            bounds.Grow(AABB{ sphere.Position - radius, sphere.Position + radius });
+        }
+    }
+    else
+    {
+        const BVHNode& left = m_Nodes[index + 1];
+        const BVHNode& right = m_Nodes[node.LeftFirst];
+        bounds.Grow(AABB{ left.BoundsMin, left.BoundsMax });
+        bounds.Grow(AABB{ right.BoundsMin, right.BoundsMax });
+    }
+
+    if (bounds.Min == node.BoundsMin && bounds.Max == node.BoundsMax)
+        return false;
+
+    m_AreaSum += (double)bounds.HalfArea() - AABB{ node.BoundsMin, node.BoundsMax }.HalfArea();
+    node.BoundsMin = bounds.Min;
+    node.BoundsMax = bounds.Max;
+    return true;
+}
+
+void BVH::Intersect(const Ray& ray, SphereKernels::IntersectFunction kernel, float& hitDistance, int& objectIndex) const
+{
+    if (m_Nodes.empty())
+        return;
+
+    const glm::vec3 inverseDirection = 1.0f / ray.Direction;
+    const BVHNode* nodes = m_Nodes.data();
+    if (Intersect::RayBox(ray.Origin, inverseDirection, nodes[0].BoundsMin, nodes[0].BoundsMax, hitDistance) == FLT_MAX)
+        return;
+
+    //Nodes we still have to visit together with the distance to their box, so we can skip them once we found a closer hit
+    struct StackEntry { uint32_t Node; float Distance; };
+    StackEntry stack[Utils::MaxDepth];
+    int stackSize = 0;
+
+    //Counted here and added to the profiler once at the end of the traversal
+    uint32_t sphereTests = 0;
+
+    uint32_t nodeIndex = 0;
+    while (true)
+    {
+        const BVHNode& node = nodes[nodeIndex];
+        if (node.IsLeaf())
+        {
+            kernel(m_Spheres, node.LeftFirst, node.Count, ray, hitDistance, objectIndex);
+            sphereTests += node.Count;
+        }
+        else
+        {
+            //Visit the closest child first, so hitDistance shrinks as early as possible and the other child can often be skipped
+            uint32_t nearChild = nodeIndex + 1, farChild = node.LeftFirst;
+            float nearDistance = Intersect::RayBox(ray.Origin, inverseDirection, nodes[nearChild].BoundsMin, nodes[nearChild].BoundsMax, hitDistance);
+            float farDistance = Intersect::RayBox(ray.Origin, inverseDirection, nodes[farChild].BoundsMin, nodes[farChild].BoundsMax, hitDistance);
+            if (farDistance < nearDistance)
+            {
+                std::swap(nearChild, farChild);
+                std::swap(nearDistance, farDistance);
+            }
+
+            if (nearDistance != FLT_MAX)
+            {
+                if (farDistance != FLT_MAX)
+                    stack[stackSize++] = { farChild, farDistance };
+                nodeIndex = nearChild;
+                continue;
+            }
+        }
+
+        //Pop until we find a node that can still contain a closer hit
+        bool found = false;
+        while (stackSize > 0 && !found)
+        {
+            StackEntry entry = stack[--stackSize];
+            if (entry.Distance < hitDistance)
+            {
+                nodeIndex = entry.Node;
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            RT_PROFILE_COUNT(SphereTests, sphereTests);
+            return;
+        }
+    }
+}
+
+int BVH::Occluded(const Ray& ray, SphereKernels::OccludedFunction kernel, float maxDistance) const
+{
+    if (m_Nodes.empty())
+        return -1;
+
+    const glm::vec3 inverseDirection = 1.0f / ray.Direction;
+    const BVHNode* nodes = m_Nodes.data();
+    if (Intersect::RayBox(ray.Origin, inverseDirection, nodes[0].BoundsMin, nodes[0].BoundsMax, maxDistance) == FLT_MAX)
+        return -1;
+
+    //Every box the ray passes within maxDistance gets visited until something blocks it, no sorting by distance -
+    //any blocker ends the search
+    uint32_t stack[Utils::MaxDepth];
+    int stackSize = 0;
+    uint32_t sphereTests = 0;
+    int occluder = -1;
+
+    uint32_t nodeIndex = 0;
+    while (true)
+    {
+        const BVHNode& node = nodes[nodeIndex];
+        if (node.IsLeaf())
+        {
+            sphereTests += node.Count;
+            occluder = kernel(m_Spheres, node.LeftFirst, node.Count, ray, maxDistance);
+            if (occluder >= 0)
+                break;
+        }
+        else
+        {
+            uint32_t left = nodeIndex + 1, right = node.LeftFirst;
+            bool hitLeft = Intersect::RayBox(ray.Origin, inverseDirection, nodes[left].BoundsMin, nodes[left].BoundsMax, maxDistance) != FLT_MAX;
+            bool hitRight = Intersect::RayBox(ray.Origin, inverseDirection, nodes[right].BoundsMin, nodes[right].BoundsMax, maxDistance) != FLT_MAX;
+            if (hitLeft && hitRight)
+                stack[stackSize++] = right;
+            if (hitLeft || hitRight)
+            {
+                nodeIndex = hitLeft ? left : right;
+                continue;
+            }
+        }
+
+        if (stackSize == 0)
+            break;
+        nodeIndex = stack[--stackSize];
+    }
+    RT_PROFILE_COUNT(SphereTests, sphereTests);
+    return occluder;
+}
+
+void BVH::IntersectPacket(RayPacket& packet) const
+{
+    if (m_Nodes.empty())
+        return;
+
+    //Nodes can only be skipped once they are behind the hit of every ray in the packet
+    float maxDistance = packet.GetMaxHitDistance();
+    const BVHNode* nodes = m_Nodes.data();
+    if (PacketTracing::IntersectBox(packet, nodes[0].BoundsMin, nodes[0].BoundsMax, maxDistance) == FLT_MAX)
+        return;
+
+    struct StackEntry { uint32_t Node; float Distance; };
+    StackEntry stack[Utils::MaxDepth];
+    int stackSize = 0;
+
+    uint32_t sphereTests = 0;
+
+    uint32_t nodeIndex = 0;
+    while (true)
+    {
+        const BVHNode& node = nodes[nodeIndex];
+        if (node.IsLeaf())
+        {
+            PacketTracing::IntersectSpheres(packet, m_Spheres, node.LeftFirst, node.Count);
+            sphereTests += node.Count * packet.Count;
+            maxDistance = packet.GetMaxHitDistance();
+        }
+        else
+        {
+            //Front to back using the lower bound of the entry distance over the packet
+            uint32_t nearChild = nodeIndex + 1, farChild = node.LeftFirst;
+            float nearDistance = PacketTracing::IntersectBox(packet, nodes[nearChild].BoundsMin, nodes[nearChild].BoundsMax, maxDistance);
+            float farDistance = PacketTracing::IntersectBox(packet, nodes[farChild].BoundsMin, nodes[farChild].BoundsMax, maxDistance);
+            if (farDistance < nearDistance)
+            {
+                std::swap(nearChild, farChild);
+                std::swap(nearDistance, farDistance);
+            }
+
+            if (nearDistance != FLT_MAX)
+            {
+                if (farDistance != FLT_MAX)
+                    stack[stackSize++] = { farChild, farDistance };
+                nodeIndex = nearChild;
+                continue;
+            }
+        }
+
+        bool found = false;
+        while (stackSize > 0 && !found)
+        {
+            StackEntry entry = stack[--stackSize];
+            if (entry.Distance < maxDistance)
+            {
+                nodeIndex = entry.Node;
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            RT_PROFILE_COUNT(SphereTests, sphereTests);
+            return;
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cfloat>
+#include <glm/glm.hpp>
+#include "Ray.h"
+#include "Scene.h"
+#include "SphereKernels.h"
+#include "RayPacket.h"
+
+//Axis aligned bounding box
+struct AABB
+{
+    glm::vec3 Min { FLT_MAX };
+    glm::vec3 Max { -FLT_MAX };
+
+    void Grow(const glm::vec3& point) { Min = glm::min(Min, point); Max = glm::max(Max, point); }
+    void Grow(const AABB& other) { Min = glm::min(Min, other.Min); Max = glm::max(Max, other.Max); }
+    //Half the surface area - SAH only compares areas so the factor 2 doesnt matter
+    float HalfArea() const
+    {
+        glm::vec3 e = Max - Min;
+        return e.x < 0.0f ? 0.0f : e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+};
+
+//32 bytes so 2 nodes fit in a cache line
+//Interior node: children are at index + 1 (left, stored right after its parent) and LeftFirst (right)
+//Leaf: Count > 0, primitives are entries [LeftFirst .. LeftFirst + Count) of the leaf ordered SoA
+struct BVHNode
+{
+    glm::vec3 BoundsMin;
+    uint32_t LeftFirst;
+    glm::vec3 BoundsMax;
+    uint32_t Count;
+
+    bool IsLeaf() const { return Count > 0; }
+};
+
+//Bounding volume hierarchy over the spheres of a scene
+//Built top down with a binned surface area heuristic, big subtrees are built in parallel
+//Nodes are flattened depth first into one array so traversal walks memory mostly forward
+class BVH
+{
+public:
+    void Build(const SceneArray<Sphere>& spheres);
+    //Take over a BVH built earlier for these spheres (e.g. stored in a scene file) instead of building one
+    void Load(const BVHNode* nodes, uint32_t nodeCount, const uint32_t* primitiveIndices, const SceneArray<Sphere>& spheres);
+    //Whether nodes and primitive indices from outside (a file) are safe to Load for sphereCount spheres: every index in
+    //range, children after their parent and no deeper than traversal can handle
+    static bool IsValid(const BVHNode* nodes, uint32_t nodeCount, const uint32_t* primitiveIndices, uint32_t sphereCount);
+    void Clear() { m_Nodes.clear(); m_PrimitiveIndices.clear(); m_Spheres = {}; m_Parents.clear(); m_SphereSlots.clear(); m_SlotLeaves.clear(); }
+    bool IsEmpty() const { return m_Nodes.empty(); }
+
+    //Spheres in ranges moved or changed size: refill their SoA entries and refit the boxes of their leaves and every
+    //ancestor bottom up, the tree itself stays the same - an edit costs a walk up the tree instead of a build
+    //Returns false once the tree got too loose to be worth keeping (SAH cost over maxCostRatio x the cost after the
+    //build), rebuild then
+    bool Refit(const SceneArray<Sphere>& spheres, const std::vector<SceneRange>& ranges, float maxCostRatio);
+
+    //Closest hit along the ray, only considers hits closer than hitDistance
+    //Updates hitDistance and objectIndex (index into the scene spheres) when a closer hit is found
+    //Leaves are tested with the given SIMD sphere kernel
+    void Intersect(const Ray& ray, SphereKernels::IntersectFunction kernel, float& hitDistance, int& objectIndex) const;
+    //Any hit closer than maxDistance (shadow rays): children in whatever order, done at the first leaf with a hit
+    //Returns the sphere in the way (index into the scene spheres), -1 when there is none
+    int Occluded(const Ray& ray, SphereKernels::OccludedFunction kernel, float maxDistance) const;
+    //Closest hits for a whole coherent packet: nodes are culled with interval arithmetic for all rays at once
+    void IntersectPacket(RayPacket& packet) const;
+
+    const std::vector<BVHNode>& GetNodes() const { return m_Nodes; }
+    const std::vector<uint32_t>& GetPrimitiveIndices() const { return m_PrimitiveIndices; }
+private:
+    std::vector<BVHNode> m_Nodes;
+    //Sphere indices in leaf order
+    std::vector<uint32_t> m_PrimitiveIndices;
+    //Sphere data in leaf order, so every leaf is 1 contiguous range for the SIMD kernels
+    SphereSoA m_Spheres;
+
+    //Refit data, filled by the first refit: parent of every node, leaf order position of every sphere and leaf node of
+    //every position
+    std::vector<uint32_t> m_Parents, m_SphereSlots, m_SlotLeaves;
+    //Half areas of all nodes summed, now and as a SAH cost (relative to the root) right after the build
+    double m_AreaSum = 0.0;
+    double m_BuildCost = 0.0;
+
+    void PrepareRefit();
+    bool RefitNode(uint32_t index, const SceneArray<Sphere>& spheres); //Recompute the box of a node, false when it didnt change
+};
@@ -0,0 +1,115 @@
+﻿#include "Camera.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+Camera::Camera(float verticalFOV, float nearClip, float farClip)
+	: m_VerticalFOV(verticalFOV), m_NearClip(nearClip), m_FarClip(farClip)
+{
+	//Set direction of where camera is looking and set its position in space
+	m_ForwardDirection = glm::vec3(0, 0, -1);
+	m_Position = glm::vec3(0, 0, 5);
+}
+
+//Recalculate all things dependent on width and height if camera gets resized
+void Camera::OnResize(uint32_t width, uint32_t height)
+{
+	if (width == m_ViewportWidth && height == m_ViewportHeight)
+		return;
+
+	m_ViewportWidth = width;
+	m_ViewportHeight = height;
+
+	RecalculateProjection();
+	RecalculateRayDirections();
+}
+
+void Camera::SetPosition(const glm::vec3& position)
+{
+	m_Position = position;
+	RecalculateView();
+	RecalculateRayDirections();
+}
+
+void Camera::SetDirection(const glm::vec3& direction)
+{
+	m_ForwardDirection = glm::normalize(direction);
+	RecalculateView();
+	RecalculateRayDirections();
+}
+
+void Camera::SetRayDirectionCaching(bool enabled)
+{
+	if (enabled == m_CacheRayDirections)
+		return;
+
+	m_CacheRayDirections = enabled;
+	if (enabled)
+		RecalculateRayDirections();
+	else
+		std::vector<glm::vec3>().swap(m_RayDirections); //Give the memory back
+}
+
+float Camera::GetRotationSpeed()
+{
+	return 0.3f;
+}
+
+//Creates perspective matrix for us based on FOV, width and height (aspect ratio) , near and far clip
+//Creates the frustum and maps the coords in our space to -1 and 1 to be able to display on screen
+void Camera::RecalculateProjection()
+{
+	m_Projection = glm::perspectiveFov(glm::radians(m_VerticalFOV), (float)m_ViewportWidth, (float)m_ViewportHeight, m_NearClip, m_FarClip);
+	//Get inverse projection -> useful later
+	m_InverseProjection = glm::inverse(m_Projection);
+}
+
+//Builds up view matrix
+void Camera::RecalculateView()
+{
+	//lookAt -> "Hey you are here and look at this point"
+	//Specify position, what point to look at and and up direction
+	m_View = glm::lookAt(m_Position, m_Position + m_ForwardDirection, glm::vec3(0, 1, 0));
+	//Inverting matrix to get inverse view -> will be useful in future
+	m_InverseView = glm::inverse(m_View);
+}
+
+//Cached calculations
+//Figure out ray directions from view and projection matrix
+void Camera::RecalculateRayDirections()
+{
+	//For a perspective projection the (unnormalized) direction is linear in the pixel position:
+	//direction = origin + x * deltaX + y * deltaY, so 3 corners of the image plane are enough
+	auto imagePlane = [this](float x, float y)
+	{
+		glm::vec4 target = m_InverseProjection * glm::vec4(x, y, 1, 1);
+		return glm::vec3(m_InverseView * glm::vec4(glm::vec3(target) / target.w, 0));
+	};
+	m_ImagePlaneOrigin = imagePlane(-1.0f, -1.0f);
+	m_ImagePlaneDeltaX = (imagePlane(1.0f, -1.0f) - m_ImagePlaneOrigin) / (float)glm::max(m_ViewportWidth, 1u);
+	m_ImagePlaneDeltaY = (imagePlane(-1.0f, 1.0f) - m_ImagePlaneOrigin) / (float)glm::max(m_ViewportHeight, 1u);
+
+	if (!m_CacheRayDirections)
+		return;
+
+	m_RayDirections.resize(m_ViewportWidth * m_ViewportHeight);
+
+	for (uint32_t y = 0; y < m_ViewportHeight; y++)
+	{
+		for (uint32_t x = 0; x < m_ViewportWidth; x++)
+		{
+			glm::vec2 coord = { (float)x / (float)m_ViewportWidth, (float)y / (float)m_ViewportHeight };
+			coord = coord * 2.0f - 1.0f; // Calculate -1 -> 1 coordinate
+			
+			//Here in the target we go back to world space from -1 -> 1
+			//We know the -1 -> 1 space = the pixels
+			//We need to do the opposite: we need to cast our ray in world space but we have -1 -> 1
+			//Need to reverse -> multiply with inverse of each matrix
+			//Target  = where we are targeting this vector
+			glm::vec4 target = m_InverseProjection * glm::vec4(coord.x, coord.y, 1, 1);
+			//Ray direction = inverse view * perspective division of target normalized
+			glm::vec3 rayDirection = glm::vec3(m_InverseView * glm::vec4(glm::normalize(glm::vec3(target) / target.w), 0)); // World space
+			//Cache results in vector
+			m_RayDirections[x + y * m_ViewportWidth] = rayDirection;
+		}
+	}
+}
\ No newline at end of file
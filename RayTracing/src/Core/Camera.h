@@ -20,6 +20,10 @@ public:
     //Recalculate projection matrix
     void OnResize(uint32_t width, uint32_t height);
 
+    //Place the camera without input (headless renders, scene files) - recalculates view and ray directions
+    void SetPosition(const glm::vec3& position);
+    void SetDirection(const glm::vec3& direction);
+
     //Getters for various details of camera
     const glm::mat4& GetProjection() const { return m_Projection; }
     const glm::mat4& GetInverseProjection() const { return m_InverseProjection; }
@@ -30,12 +34,31 @@ public:
     const glm::vec3& GetPosition() const { return m_Position; }
     //Where is it pointing
     const glm::vec3& GetDirection() const { return m_ForwardDirection; }
+    //Lens as passed to the constructor, enough to make the same camera somewhere else (distributed rendering)
+    float GetVerticalFOV() const { return m_VerticalFOV; }
+    float GetNearClip() const { return m_NearClip; }
+    float GetFarClip() const { return m_FarClip; }
+    //Size of the image the camera shoots rays through, set by OnResize
+    uint32_t GetViewportWidth() const { return m_ViewportWidth; }
+    uint32_t GetViewportHeight() const { return m_ViewportHeight; }
 
     //Convert camera projection matrices and view matrix, ... into ray directions and map to -1 and 1
     //On CPU might be slow --> will move to GPU and will be no problem
     //But for now we cache the directions so we dont have to recalculate when camera is not moving 
+    //Empty unless caching is enabled
     const std::vector<glm::vec3>& GetRayDirections() const { return m_RayDirections; }
 
+    //Ray direction through a point on the image, in pixels (x = 0.5 is the center of the first column)
+    //Computed on the fly from 3 vectors instead of a width * height buffer, and works for any sub-pixel position (jitter)
+    glm::vec3 GetRayDirection(float x, float y) const
+    {
+        return glm::normalize(m_ImagePlaneOrigin + x * m_ImagePlaneDeltaX + y * m_ImagePlaneDeltaY);
+    }
+
+    //Keep the width * height ray direction buffer up to date - costs memory and a full recalculation on every camera change
+    void SetRayDirectionCaching(bool enabled);
+    bool IsCachingRayDirections() const { return m_CacheRayDirections; }
+
     float GetRotationSpeed();
 private:
     void RecalculateProjection();
@@ -56,6 +79,12 @@ private:
 
     // Cached ray directions
     std::vector<glm::vec3> m_RayDirections;
+    bool m_CacheRayDirections = false;
+
+    //Image plane (1 unit in front of the camera, world space directions) at pixel 0,0 and the step per pixel in x and y
+    glm::vec3 m_ImagePlaneOrigin{ 0.0f, 0.0f, -1.0f };
+    glm::vec3 m_ImagePlaneDeltaX{ 0.0f };
+    glm::vec3 m_ImagePlaneDeltaY{ 0.0f };
 
     glm::vec2 m_LastMousePosition{ 0.0f, 0.0f };
 
@@ -0,0 +1,183 @@
+#include "Checkpoint.h"
+#include "MappedFile.h"
+
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace Utils
+{
+    static constexpr char CheckpointMagic[8] = { 'R', 'T', 'C', 'H', 'E', 'C', 'K', 0 };
+    static constexpr uint32_t CheckpointVersion = 2;
+    static constexpr uint32_t ByteOrderMark = 0x01020304;
+    static constexpr uint64_t ArrayAlignment = 64;
+
+    struct CheckpointHeader
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t ByteOrder;
+        uint32_t Width, Height;
+        uint32_t FrameIndex, FrameCounter;
+        uint64_t SceneHash, CameraHash, SettingsHash;
+        //Width * Height entries each
+        uint64_t AccumulationOffset, SampleCountOffset, LuminanceSquaredOffset;
+    };
+
+    static uint64_t AlignUp(uint64_t offset)
+    {
+        return (offset + ArrayAlignment - 1) / ArrayAlignment * ArrayAlignment;
+    }
+
+    static void AppendArray(std::vector<uint8_t>& out, uint64_t offset, const void* data, uint64_t size)
+    {
+        out.resize(offset, 0);
+        out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+    }
+
+    static constexpr uint64_t FNVOffsetBasis = 14695981039346656037ull;
+
+    static uint64_t HashBytes(const void* data, size_t size, uint64_t hash = FNVOffsetBasis)
+    {
+        const uint8_t* bytes = (const uint8_t*)data;
+        for(size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+}
+
+namespace Checkpoint
+{
+    uint64_t HashScene(const Scene& scene)
+    {
+        //Counts first, so moving the border between the arrays changes the hash too
+        uint64_t counts[3] = { scene.Spheres.size(), scene.Materials.size(), scene.Lights.size() };
+        uint64_t hash = Utils::HashBytes(counts, sizeof(counts));
+        hash = Utils::HashBytes(scene.Spheres.data(), scene.Spheres.size() * sizeof(Sphere), hash);
+        hash = Utils::HashBytes(scene.Materials.data(), scene.Materials.size() * sizeof(Material), hash);
+        return Utils::HashBytes(scene.Lights.data(), scene.Lights.size() * sizeof(Light), hash);
+    }
+
+    uint64_t HashCamera(const Camera& camera)
+    {
+        float lens[3] = { camera.GetVerticalFOV(), camera.GetNearClip(), camera.GetFarClip() };
+        uint32_t size[2] = { camera.GetViewportWidth(), camera.GetViewportHeight() };
+        uint64_t hash = Utils::HashBytes(lens, sizeof(lens));
+        hash = Utils::HashBytes(size, sizeof(size), hash);
+        hash = Utils::HashBytes(&camera.GetPosition(), sizeof(glm::vec3), hash);
+        return Utils::HashBytes(&camera.GetDirection(), sizeof(glm::vec3), hash);
+    }
+
+    uint64_t HashSettings(const Renderer::Settings& settings)
+    {
+        //Field by field, the struct's padding isnt part of the settings
+        uint32_t values[9] = { settings.MaxBounces, settings.RussianRoulette, settings.RouletteStartBounce, settings.NextEventEstimation,
+            settings.Jitter, settings.Adaptive, settings.AdaptiveMinSamples, settings.AdaptiveMaxSamples, 0 };
+        memcpy(&values[8], &settings.AdaptiveThreshold, sizeof(float));
+        return Utils::HashBytes(values, sizeof(values));
+    }
+
+    LoadResult Load(const std::string& path, Renderer& renderer, uint64_t sceneHash, uint64_t cameraHash, uint64_t settingsHash)
+    {
+        //Mapped, the arrays get copied into the renderer straight from the page cache
+        MappedFile file;
+        if(!file.Open(path))
+            return LoadResult::NotFound;
+        if(file.GetSize() < sizeof(Utils::CheckpointHeader))
+            return LoadResult::Invalid;
+
+        Utils::CheckpointHeader header;
+        memcpy(&header, file.GetData(), sizeof(header));
+        if(memcmp(header.Magic, Utils::CheckpointMagic, sizeof(header.Magic)) != 0 || header.Version != Utils::CheckpointVersion ||
+            header.ByteOrder != Utils::ByteOrderMark)
+            return LoadResult::Invalid;
+
+        uint64_t pixels = (uint64_t)header.Width * header.Height;
+        auto arrayInFile = [&](uint64_t offset, uint64_t elementSize)
+        {
+            return offset % Utils::ArrayAlignment == 0 && offset <= file.GetSize() && pixels <= (file.GetSize() - offset) / elementSize;
+        };
+        if(!arrayInFile(header.AccumulationOffset, sizeof(glm::vec4)) || !arrayInFile(header.SampleCountOffset, sizeof(uint32_t)) ||
+            !arrayInFile(header.LuminanceSquaredOffset, sizeof(float)))
+            return LoadResult::Invalid;
+
+        if(header.SceneHash != sceneHash || header.CameraHash != cameraHash || header.SettingsHash != settingsHash ||
+            header.Width != renderer.GetWidth() || header.Height != renderer.GetHeight())
+            return LoadResult::Mismatch;
+
+        const uint8_t* data = file.GetData();
+        renderer.RestoreAccumulation(header.FrameIndex, header.FrameCounter, (const glm::vec4*)(data + header.AccumulationOffset),
+            (const uint32_t*)(data + header.SampleCountOffset), (const float*)(data + header.LuminanceSquaredOffset));
+        return LoadResult::Loaded;
+    }
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    Wait();
+}
+
+bool CheckpointWriter::Write(const std::string& path, const Renderer& renderer, uint64_t sceneHash, uint64_t cameraHash, uint64_t settingsHash)
+{
+    if(m_Writing)
+        return false;
+    if(m_Thread.joinable())
+        m_Thread.join();
+
+    Utils::CheckpointHeader header = {};
+    memcpy(header.Magic, Utils::CheckpointMagic, sizeof(header.Magic));
+    header.Version = Utils::CheckpointVersion;
+    header.ByteOrder = Utils::ByteOrderMark;
+    header.Width = renderer.GetWidth();
+    header.Height = renderer.GetHeight();
+    header.FrameIndex = renderer.GetFrameIndex();
+    header.FrameCounter = renderer.GetFrameCounter();
+    header.SceneHash = sceneHash;
+    header.CameraHash = cameraHash;
+    header.SettingsHash = settingsHash;
+
+    uint64_t pixels = (uint64_t)header.Width * header.Height;
+    header.AccumulationOffset = Utils::AlignUp(sizeof(header));
+    header.SampleCountOffset = Utils::AlignUp(header.AccumulationOffset + pixels * sizeof(glm::vec4));
+    header.LuminanceSquaredOffset = Utils::AlignUp(header.SampleCountOffset + pixels * sizeof(uint32_t));
+
+    //The only part on the caller's thread: a copy of the buffers, so the renderer can go on changing them
+    m_Data.clear();
+    m_Data.reserve(header.LuminanceSquaredOffset + pixels * sizeof(float));
+    Utils::AppendArray(m_Data, 0, &header, sizeof(header));
+    Utils::AppendArray(m_Data, header.AccumulationOffset, renderer.GetAccumulationData(), pixels * sizeof(glm::vec4));
+    Utils::AppendArray(m_Data, header.SampleCountOffset, renderer.GetSampleCounts(), pixels * sizeof(uint32_t));
+    Utils::AppendArray(m_Data, header.LuminanceSquaredOffset, renderer.GetLuminanceSquaredData(), pixels * sizeof(float));
+
+    m_Writing = true;
+    m_Thread = std::thread([this, path]
+    {
+        std::string temporaryPath = path + ".tmp";
+        bool written;
+        {
+            std::ofstream stream(temporaryPath, std::ios::binary);
+            stream.write((const char*)m_Data.data(), (std::streamsize)m_Data.size());
+            written = (bool)stream;
+        }
+        //Replaces the old checkpoint in 1 step, there is always a complete one on disk
+        std::error_code error;
+        if(written)
+            std::filesystem::rename(temporaryPath, path, error);
+        else
+            std::remove(temporaryPath.c_str());
+        m_Succeeded = written && !error;
+        m_Writing = false;
+    });
+    return true;
+}
+
+bool CheckpointWriter::Wait()
+{
+    if(m_Thread.joinable())
+        m_Thread.join();
+    return m_Succeeded;
+}
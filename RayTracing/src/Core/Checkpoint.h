@@ -0,0 +1,57 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include "Renderer.h"
+
+//Checkpoints of long progressive renders (.rtcheckpoint): the renderer's accumulation state (see
+//Renderer::RestoreAccumulation) with hashes of the scene, camera and settings it was rendered from, so a render that got
+//stopped (restart, preemption) continues where its last checkpoint was instead of from 0 samples
+//Same layout idea as .rtbin: versioned header, then the arrays as they are in memory, 64 byte aligned
+namespace Checkpoint
+{
+    //FNV-1a over the sphere, material and light arrays
+    uint64_t HashScene(const Scene& scene);
+    //Everything about the camera that changes its rays: lens, position, direction and image size
+    uint64_t HashCamera(const Camera& camera);
+    //The settings that change what a sample estimates (bounces, roulette, light sampling, jitter, adaptive sampling) -
+    //samples taken with others cant be averaged with them
+    uint64_t HashSettings(const Renderer::Settings& settings);
+
+    enum class LoadResult
+    {
+        Loaded,
+        NotFound,
+        Invalid,    //Not a checkpoint, or written by a build with another layout
+        Mismatch    //Checkpoint of another scene, camera, image size or render settings
+    };
+
+    //Renderer has to be resized to the checkpoint's size already, nothing is restored unless the result is Loaded
+    LoadResult Load(const std::string& path, Renderer& renderer, uint64_t sceneHash, uint64_t cameraHash, uint64_t settingsHash);
+}
+
+//Writes checkpoints without holding up the render loop: Write only copies the renderer's buffers, a background thread
+//writes them to a temporary file and renames it over the last checkpoint - stopping in the middle of a write leaves
+//the previous checkpoint as it was
+class CheckpointWriter
+{
+public:
+    CheckpointWriter() = default;
+    ~CheckpointWriter();
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    //False without doing anything while the previous checkpoint is still being written
+    bool Write(const std::string& path, const Renderer& renderer, uint64_t sceneHash, uint64_t cameraHash, uint64_t settingsHash);
+    //Wait for the write in flight, false when it (or the last one) failed
+    bool Wait();
+    bool IsWriting() const { return m_Writing; }
+private:
+    std::thread m_Thread;
+    std::atomic<bool> m_Writing{ false };
+    //Only touched by the background thread while m_Writing
+    bool m_Succeeded = true;
+    std::vector<uint8_t> m_Data;
+};
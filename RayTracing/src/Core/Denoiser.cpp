@@ -0,0 +1,276 @@
+#include "Denoiser.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#if RT_X86
+    #include <emmintrin.h>
+#endif
+
+namespace Utils
+{
+    //Rows per job
+    static constexpr uint32_t DenoiseRangeSize = 4;
+
+    static float Luminance(float r, float g, float b)
+    {
+        return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    }
+
+#if RT_X86
+    //e^-x for x >= 0, good to ~1e-5 relative: 2^(integer part) goes straight into the exponent bits, a polynomial does
+    //the fraction - the weights dont need more and std::exp would be most of the filter's time
+    //0 from maxExponent on
+    static __m128 ExpNegative(__m128 x, float maxExponent)
+    {
+        __m128 inRange = _mm_cmplt_ps(x, _mm_set1_ps(maxExponent));
+        __m128 t = _mm_mul_ps(_mm_min_ps(x, _mm_set1_ps(maxExponent)), _mm_set1_ps(-1.44269504f));
+        //floor(t), cvtt rounds towards 0 which is 1 too high for negative fractions
+        __m128 whole = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+        whole = _mm_sub_ps(whole, _mm_and_ps(_mm_cmpgt_ps(whole, t), _mm_set1_ps(1.0f)));
+        __m128 fraction = _mm_sub_ps(t, whole);
+
+        __m128 p = _mm_set1_ps(0.0096181f);
+        p = _mm_add_ps(_mm_mul_ps(p, fraction), _mm_set1_ps(0.0555041f));
+        p = _mm_add_ps(_mm_mul_ps(p, fraction), _mm_set1_ps(0.2402265f));
+        p = _mm_add_ps(_mm_mul_ps(p, fraction), _mm_set1_ps(0.6931472f));
+        p = _mm_add_ps(_mm_mul_ps(p, fraction), _mm_set1_ps(1.0f));
+
+        __m128i exponent = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(whole), _mm_set1_epi32(127)), 23);
+        return _mm_and_ps(_mm_mul_ps(p, _mm_castsi128_ps(exponent)), inRange);
+    }
+#endif
+}
+
+void Denoiser::Denoise(const Settings& settings, const glm::vec4* accumulation, const uint32_t* sampleCounts, const float* luminanceSquared,
+    const glm::vec4* albedo, const glm::vec4* normalDepth, uint32_t width, uint32_t height, TileScheduler& scheduler, glm::vec4* output)
+{
+    RT_PROFILE_ZONE("A-trous");
+    m_Settings = settings;
+    if((int)m_Settings.SIMD > (int)SphereKernels::GetSupportedLevel())
+        m_Settings.SIMD = SphereKernels::GetSupportedLevel();
+    m_Width = width;
+    m_Height = height;
+    size_t pixels = (size_t)width * height;
+    if(pixels == 0)
+        return;
+
+    m_Color[0].Resize(pixels);
+    m_Color[1].Resize(pixels);
+    for(std::vector<float>* plane : { &m_NormalX, &m_NormalY, &m_NormalZ, &m_Depth, &m_AlbedoR, &m_AlbedoG, &m_AlbedoB,
+        &m_Variance, &m_InverseLuminanceSigma, &m_InverseDepthSigma })
+        plane->resize(pixels);
+
+    //Averages out of the sums, split into planes
+    scheduler.ParallelFor(height, Utils::DenoiseRangeSize, [&](uint32_t begin, uint32_t end, uint32_t threadIndex)
+    {
+        for(size_t i = (size_t)begin * width; i < (size_t)end * width; i++)
+        {
+            uint32_t n = sampleCounts[i];
+            glm::vec4 color = n > 0 ? accumulation[i] / (float)n : glm::vec4(0.0f);
+            m_Color[0].R[i] = color.r;
+            m_Color[0].G[i] = color.g;
+            m_Color[0].B[i] = color.b;
+            m_Color[0].L[i] = Utils::Luminance(color.r, color.g, color.b);
+
+            //Variance of the pixel's mean, unknown below 2 samples: blur as much as the luminance allows
+            float mean = m_Color[0].L[i];
+            m_Variance[i] = n > 1 ? glm::max(0.0f, (luminanceSquared[i] - (float)n * mean * mean) / (float)(n - 1)) / (float)n : 1.0f;
+        }
+        //Features in a loop of their own: that many arrays at once and the prefetcher loses track, 4x slower
+        for(size_t i = (size_t)begin * width; i < (size_t)end * width; i++)
+        {
+            float featureSamples = albedo[i].w;
+            float inverseSamples = featureSamples > 0.0f ? 1.0f / featureSamples : 0.0f;
+            m_AlbedoR[i] = albedo[i].r * inverseSamples;
+            m_AlbedoG[i] = albedo[i].g * inverseSamples;
+            m_AlbedoB[i] = albedo[i].b * inverseSamples;
+            m_NormalX[i] = normalDepth[i].x * inverseSamples;
+            m_NormalY[i] = normalDepth[i].y * inverseSamples;
+            m_NormalZ[i] = normalDepth[i].z * inverseSamples;
+            m_Depth[i] = normalDepth[i].w * inverseSamples;
+            m_InverseDepthSigma[i] = 1.0f / (m_Settings.DepthSigma * glm::max(m_Depth[i], 0.001f));
+        }
+    });
+
+    //1 pixel's variance from a handful of samples is itself noisy, a 3x3 average of it is steadier
+    scheduler.ParallelFor(height, Utils::DenoiseRangeSize, [&](uint32_t begin, uint32_t end, uint32_t threadIndex)
+    {
+        for(uint32_t y = begin; y < end; y++)
+        {
+            for(uint32_t x = 0; x < width; x++)
+            {
+                float sum = 0.0f;
+                uint32_t count = 0;
+                for(uint32_t qy = y > 0 ? y - 1 : 0; qy <= glm::min(y + 1, height - 1); qy++)
+                {
+                    for(uint32_t qx = x > 0 ? x - 1 : 0; qx <= glm::min(x + 1, width - 1); qx++)
+                    {
+                        sum += m_Variance[qx + (size_t)qy * width];
+                        count++;
+                    }
+                }
+                m_InverseLuminanceSigma[x + (size_t)y * width] = 1.0f / (m_Settings.LuminanceSigma * glm::sqrt(sum / (float)count) + 1e-4f);
+            }
+        }
+    });
+
+    //Ping pong between the 2 color buffers, taps twice as far apart every pass
+    uint32_t source = 0;
+    for(uint32_t iteration = 0; iteration < m_Settings.Iterations; iteration++)
+    {
+        uint32_t step = 1u << iteration;
+        const Planes& input = m_Color[source];
+        Planes& filtered = m_Color[source ^ 1];
+        scheduler.ParallelFor(height, Utils::DenoiseRangeSize, [&](uint32_t begin, uint32_t end, uint32_t threadIndex)
+        {
+            FilterRows(begin, end, step, input, filtered);
+        });
+        source ^= 1;
+    }
+
+    const Planes& result = m_Color[source];
+    scheduler.ParallelFor(height, Utils::DenoiseRangeSize, [&](uint32_t begin, uint32_t end, uint32_t threadIndex)
+    {
+        for(size_t i = (size_t)begin * width; i < (size_t)end * width; i++)
+            output[i] = glm::vec4(result.R[i], result.G[i], result.B[i], sampleCounts[i] > 0 ? 1.0f : 0.0f);
+    });
+}
+
+void Denoiser::FilterRows(uint32_t begin, uint32_t end, uint32_t step, const Planes& input, Planes& output)
+{
+    //Taps reach step pixels to either side, inside that border a group of pixels never needs a bounds check
+    uint32_t border = step;
+    uint32_t width = m_Settings.SIMD == SIMDLevel::AVX2 ? 8 : 4;
+    bool simd = RT_X86 && m_Settings.SIMD != SIMDLevel::Scalar && m_Width > 2 * border + width;
+    for(uint32_t y = begin; y < end; y++)
+    {
+        uint32_t x = 0;
+        if(simd)
+        {
+            for(; x < border; x++)
+                FilterPixel(x, y, step, input, output);
+#if RT_X86
+            if(m_Settings.SIMD == SIMDLevel::AVX2)
+            {
+                for(; x + 8 <= m_Width - border; x += 8)
+                    FilterPixelsAVX2(x, y, step, input, output);
+            }
+#endif
+            for(; x + 4 <= m_Width - border; x += 4)
+                FilterPixelsSSE(x, y, step, input, output);
+        }
+        for(; x < m_Width; x++)
+            FilterPixel(x, y, step, input, output);
+    }
+}
+
+void Denoiser::FilterPixel(uint32_t x, uint32_t y, uint32_t step, const Planes& input, Planes& output) const
+{
+    size_t p = x + (size_t)y * m_Width;
+    float luminance = input.L[p];
+    float inverseNormalSigma = 1.0f / (m_Settings.NormalSigma * m_Settings.NormalSigma);
+    float inverseAlbedoSigma = 1.0f / (m_Settings.AlbedoSigma * m_Settings.AlbedoSigma);
+    float inverseDepthSigma = m_InverseDepthSigma[p] / (float)step;
+
+    glm::vec3 sum(0.0f);
+    float weightSum = 0.0f;
+    for(int ky = 0; ky < 3; ky++)
+    {
+        int qy = (int)y + (ky - 1) * (int)step;
+        if(qy < 0 || qy >= (int)m_Height)
+            continue;
+        for(int kx = 0; kx < 3; kx++)
+        {
+            int qx = (int)x + (kx - 1) * (int)step;
+            if(qx < 0 || qx >= (int)m_Width)
+                continue;
+            size_t q = (size_t)qx + (size_t)qy * m_Width;
+
+            float luminanceDistance = std::abs(luminance - input.L[q]) * m_InverseLuminanceSigma[p];
+            glm::vec3 normal = glm::vec3(m_NormalX[p] - m_NormalX[q], m_NormalY[p] - m_NormalY[q], m_NormalZ[p] - m_NormalZ[q]);
+            glm::vec3 albedo = glm::vec3(m_AlbedoR[p] - m_AlbedoR[q], m_AlbedoG[p] - m_AlbedoG[q], m_AlbedoB[p] - m_AlbedoB[q]);
+            float depthDistance = std::abs(m_Depth[p] - m_Depth[q]) * inverseDepthSigma;
+            float exponent = luminanceDistance + glm::dot(normal, normal) * inverseNormalSigma + depthDistance +
+                glm::dot(albedo, albedo) * inverseAlbedoSigma;
+
+            float weight = exponent < MaxExponent ? Kernel[kx] * Kernel[ky] * std::exp(-exponent) : 0.0f;
+            sum += weight * glm::vec3(input.R[q], input.G[q], input.B[q]);
+            weightSum += weight;
+        }
+    }
+    //The center tap always has weight, weightSum is never 0
+    output.R[p] = sum.r / weightSum;
+    output.G[p] = sum.g / weightSum;
+    output.B[p] = sum.b / weightSum;
+    output.L[p] = Utils::Luminance(output.R[p], output.G[p], output.B[p]);
+}
+
+void Denoiser::FilterPixelsSSE(uint32_t x, uint32_t y, uint32_t step, const Planes& input, Planes& output) const
+{
+#if RT_X86
+    size_t p = x + (size_t)y * m_Width;
+    const __m128 luminanceR = _mm_set1_ps(0.2126f), luminanceG = _mm_set1_ps(0.7152f), luminanceB = _mm_set1_ps(0.0722f);
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 inverseNormalSigma = _mm_set1_ps(1.0f / (m_Settings.NormalSigma * m_Settings.NormalSigma));
+    const __m128 inverseAlbedoSigma = _mm_set1_ps(1.0f / (m_Settings.AlbedoSigma * m_Settings.AlbedoSigma));
+
+    //The 4 center pixels
+    __m128 luminance = _mm_loadu_ps(&input.L[p]);
+    __m128 inverseLuminanceSigma = _mm_loadu_ps(&m_InverseLuminanceSigma[p]);
+    __m128 inverseDepthSigma = _mm_mul_ps(_mm_loadu_ps(&m_InverseDepthSigma[p]), _mm_set1_ps(1.0f / (float)step));
+    __m128 normalX = _mm_loadu_ps(&m_NormalX[p]), normalY = _mm_loadu_ps(&m_NormalY[p]), normalZ = _mm_loadu_ps(&m_NormalZ[p]);
+    __m128 depth = _mm_loadu_ps(&m_Depth[p]);
+    __m128 albedoR = _mm_loadu_ps(&m_AlbedoR[p]), albedoG = _mm_loadu_ps(&m_AlbedoG[p]), albedoB = _mm_loadu_ps(&m_AlbedoB[p]);
+
+    __m128 sumR = _mm_setzero_ps(), sumG = _mm_setzero_ps(), sumB = _mm_setzero_ps(), weightSum = _mm_setzero_ps();
+    for(int ky = 0; ky < 3; ky++)
+    {
+        int qy = (int)y + (ky - 1) * (int)step;
+        if(qy < 0 || qy >= (int)m_Height)
+            continue;
+        for(int kx = 0; kx < 3; kx++)
+        {
+            //4 neighbours, each the same offset from its center pixel
+            size_t q = (size_t)((int)x + (kx - 1) * (int)step) + (size_t)qy * m_Width;
+            __m128 difference = _mm_sub_ps(luminance, _mm_loadu_ps(&input.L[q]));
+            __m128 exponent = _mm_mul_ps(_mm_and_ps(difference, signMask), inverseLuminanceSigma);
+
+            __m128 dx = _mm_sub_ps(normalX, _mm_loadu_ps(&m_NormalX[q]));
+            __m128 dy = _mm_sub_ps(normalY, _mm_loadu_ps(&m_NormalY[q]));
+            __m128 dz = _mm_sub_ps(normalZ, _mm_loadu_ps(&m_NormalZ[q]));
+            exponent = _mm_add_ps(exponent, _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)),
+                inverseNormalSigma));
+
+            difference = _mm_sub_ps(depth, _mm_loadu_ps(&m_Depth[q]));
+            exponent = _mm_add_ps(exponent, _mm_mul_ps(_mm_and_ps(difference, signMask), inverseDepthSigma));
+
+            dx = _mm_sub_ps(albedoR, _mm_loadu_ps(&m_AlbedoR[q]));
+            dy = _mm_sub_ps(albedoG, _mm_loadu_ps(&m_AlbedoG[q]));
+            dz = _mm_sub_ps(albedoB, _mm_loadu_ps(&m_AlbedoB[q]));
+            exponent = _mm_add_ps(exponent, _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)),
+                inverseAlbedoSigma));
+
+            __m128 weight = _mm_mul_ps(_mm_set1_ps(Kernel[kx] * Kernel[ky]), Utils::ExpNegative(exponent, MaxExponent));
+            sumR = _mm_add_ps(sumR, _mm_mul_ps(weight, _mm_loadu_ps(&input.R[q])));
+            sumG = _mm_add_ps(sumG, _mm_mul_ps(weight, _mm_loadu_ps(&input.G[q])));
+            sumB = _mm_add_ps(sumB, _mm_mul_ps(weight, _mm_loadu_ps(&input.B[q])));
+            weightSum = _mm_add_ps(weightSum, weight);
+        }
+    }
+
+    __m128 inverseWeightSum = _mm_div_ps(_mm_set1_ps(1.0f), weightSum);
+    sumR = _mm_mul_ps(sumR, inverseWeightSum);
+    sumG = _mm_mul_ps(sumG, inverseWeightSum);
+    sumB = _mm_mul_ps(sumB, inverseWeightSum);
+    _mm_storeu_ps(&output.R[p], sumR);
+    _mm_storeu_ps(&output.G[p], sumG);
+    _mm_storeu_ps(&output.B[p], sumB);
+    _mm_storeu_ps(&output.L[p], _mm_add_ps(_mm_add_ps(_mm_mul_ps(sumR, luminanceR), _mm_mul_ps(sumG, luminanceG)), _mm_mul_ps(sumB, luminanceB)));
+#else
+    for(uint32_t i = 0; i < 4; i++)
+        FilterPixel(x + i, y, step, input, output);
+#endif
+}
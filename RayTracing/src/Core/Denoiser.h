@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "SphereKernels.h"
+#include "TileScheduler.h"
+
+//Edge avoiding a-trous wavelet filter (Dammertz et al. 2010): a few passes of a 3x3 blur whose taps spread out
+//(1, 2, 4, 8, 16 pixels apart), so 5 passes cover a 63 pixel wide footprint for 45 taps per pixel
+//Every tap is weighted by how alike the 2 pixels are in first hit normal, depth and albedo (edges of objects and
+//materials stay sharp) and in luminance, relative to the pixel's noise estimated from its samples - noisy pixels get
+//blurred a lot, converged ones hardly at all
+//Rows are filtered in parallel, 4 (SSE) or 8 (AVX2) pixels at a time, scalar at the image borders
+class Denoiser
+{
+public:
+    struct Settings
+    {
+        uint32_t Iterations = 5;
+        //Luminance difference, in standard deviations of the pixel's noise, at which a tap's weight has dropped to 1/e
+        float LuminanceSigma = 1.0f;
+        //Normal difference (length of the difference vector), relative depth difference per pixel of tap distance
+        //and albedo difference with the same meaning
+        float NormalSigma = 0.2f;
+        float DepthSigma = 0.02f;
+        float AlbedoSigma = 0.1f;
+        SIMDLevel SIMD = SphereKernels::GetSupportedLevel();
+    };
+
+    //accumulation, sampleCounts, luminanceSquared: summed samples like Renderer::GetAccumulationData
+    //albedo: summed first hit albedo, w = samples it was recorded for, normalDepth: summed first hit normal and depth
+    //output: width * height denoised (averaged) colors
+    void Denoise(const Settings& settings, const glm::vec4* accumulation, const uint32_t* sampleCounts, const float* luminanceSquared,
+        const glm::vec4* albedo, const glm::vec4* normalDepth, uint32_t width, uint32_t height, TileScheduler& scheduler, glm::vec4* output);
+private:
+    //1 plane per component, so 4 neighbouring pixels are 1 load, luminance kept next to the color it belongs to
+    struct Planes
+    {
+        std::vector<float> R, G, B, L;
+        void Resize(size_t size)
+        {
+            R.resize(size);
+            G.resize(size);
+            B.resize(size);
+            L.resize(size);
+        }
+    };
+    void FilterRows(uint32_t begin, uint32_t end, uint32_t step, const Planes& input, Planes& output);
+    //Filter pixel x, y without SIMD - for the borders, where taps fall outside the image
+    void FilterPixel(uint32_t x, uint32_t y, uint32_t step, const Planes& input, Planes& output) const;
+    void FilterPixelsSSE(uint32_t x, uint32_t y, uint32_t step, const Planes& input, Planes& output) const;
+    //Lives in its own file, built with AVX2 code generation - only called when GetSupportedLevel() says so
+    void FilterPixelsAVX2(uint32_t x, uint32_t y, uint32_t step, const Planes& input, Planes& output) const;
+
+    //1D kernel of every pass, the 3x3 kernel is its outer product
+    static constexpr float Kernel[3] = { 1.0f / 4.0f, 1.0f / 2.0f, 1.0f / 4.0f };
+    //Taps whose weight would be below e^-this count as 0: weights near FLT_MIN turn into denormals once multiplied, and
+    //those are 100 times slower to compute with
+    static constexpr float MaxExponent = 60.0f;
+private:
+    Settings m_Settings;
+    uint32_t m_Width = 0, m_Height = 0;
+    Planes m_Color[2];
+    std::vector<float> m_NormalX, m_NormalY, m_NormalZ, m_Depth;
+    std::vector<float> m_AlbedoR, m_AlbedoG, m_AlbedoB;
+    //Per pixel: 1 / (LuminanceSigma * standard deviation of its mean luminance), variance before the 3x3 blur
+    std::vector<float> m_Variance, m_InverseLuminanceSigma;
+    //Per pixel: 1 / (DepthSigma * depth), divided by the tap distance in every pass
+    std::vector<float> m_InverseDepthSigma;
+};
@@ -0,0 +1,89 @@
+#include "Denoiser.h"
+
+//Built with AVX2 code generation (see premake5.lua), so nothing in here may run before checking GetSupportedLevel()
+#if RT_X86
+#include <immintrin.h>
+
+namespace Utils
+{
+    //Same approximation as the SSE one in Denoiser.cpp, 8 wide
+    static __m256 ExpNegative(__m256 x, float maxExponent)
+    {
+        __m256 inRange = _mm256_cmp_ps(x, _mm256_set1_ps(maxExponent), _CMP_LT_OQ);
+        __m256 t = _mm256_mul_ps(_mm256_min_ps(x, _mm256_set1_ps(maxExponent)), _mm256_set1_ps(-1.44269504f));
+        __m256 whole = _mm256_floor_ps(t);
+        __m256 fraction = _mm256_sub_ps(t, whole);
+
+        __m256 p = _mm256_set1_ps(0.0096181f);
+        p = _mm256_add_ps(_mm256_mul_ps(p, fraction), _mm256_set1_ps(0.0555041f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, fraction), _mm256_set1_ps(0.2402265f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, fraction), _mm256_set1_ps(0.6931472f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, fraction), _mm256_set1_ps(1.0f));
+
+        __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(whole), _mm256_set1_epi32(127)), 23);
+        return _mm256_and_ps(_mm256_mul_ps(p, _mm256_castsi256_ps(exponent)), inRange);
+    }
+}
+
+//Same math as FilterPixelsSSE, 8 pixels per call
+void Denoiser::FilterPixelsAVX2(uint32_t x, uint32_t y, uint32_t step, const Planes& input, Planes& output) const
+{
+    size_t p = x + (size_t)y * m_Width;
+    const __m256 luminanceR = _mm256_set1_ps(0.2126f), luminanceG = _mm256_set1_ps(0.7152f), luminanceB = _mm256_set1_ps(0.0722f);
+    const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 inverseNormalSigma = _mm256_set1_ps(1.0f / (m_Settings.NormalSigma * m_Settings.NormalSigma));
+    const __m256 inverseAlbedoSigma = _mm256_set1_ps(1.0f / (m_Settings.AlbedoSigma * m_Settings.AlbedoSigma));
+
+    __m256 luminance = _mm256_loadu_ps(&input.L[p]);
+    __m256 inverseLuminanceSigma = _mm256_loadu_ps(&m_InverseLuminanceSigma[p]);
+    __m256 inverseDepthSigma = _mm256_mul_ps(_mm256_loadu_ps(&m_InverseDepthSigma[p]), _mm256_set1_ps(1.0f / (float)step));
+    __m256 normalX = _mm256_loadu_ps(&m_NormalX[p]), normalY = _mm256_loadu_ps(&m_NormalY[p]), normalZ = _mm256_loadu_ps(&m_NormalZ[p]);
+    __m256 depth = _mm256_loadu_ps(&m_Depth[p]);
+    __m256 albedoR = _mm256_loadu_ps(&m_AlbedoR[p]), albedoG = _mm256_loadu_ps(&m_AlbedoG[p]), albedoB = _mm256_loadu_ps(&m_AlbedoB[p]);
+
+    __m256 sumR = _mm256_setzero_ps(), sumG = _mm256_setzero_ps(), sumB = _mm256_setzero_ps(), weightSum = _mm256_setzero_ps();
+    for(int ky = 0; ky < 3; ky++)
+    {
+        int qy = (int)y + (ky - 1) * (int)step;
+        if(qy < 0 || qy >= (int)m_Height)
+            continue;
+        for(int kx = 0; kx < 3; kx++)
+        {
+            size_t q = (size_t)((int)x + (kx - 1) * (int)step) + (size_t)qy * m_Width;
+            __m256 difference = _mm256_sub_ps(luminance, _mm256_loadu_ps(&input.L[q]));
+            __m256 exponent = _mm256_mul_ps(_mm256_and_ps(difference, signMask), inverseLuminanceSigma);
+
+            __m256 dx = _mm256_sub_ps(normalX, _mm256_loadu_ps(&m_NormalX[q]));
+            __m256 dy = _mm256_sub_ps(normalY, _mm256_loadu_ps(&m_NormalY[q]));
+            __m256 dz = _mm256_sub_ps(normalZ, _mm256_loadu_ps(&m_NormalZ[q]));
+            exponent = _mm256_add_ps(exponent, _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                _mm256_mul_ps(dz, dz)), inverseNormalSigma));
+
+            difference = _mm256_sub_ps(depth, _mm256_loadu_ps(&m_Depth[q]));
+            exponent = _mm256_add_ps(exponent, _mm256_mul_ps(_mm256_and_ps(difference, signMask), inverseDepthSigma));
+
+            dx = _mm256_sub_ps(albedoR, _mm256_loadu_ps(&m_AlbedoR[q]));
+            dy = _mm256_sub_ps(albedoG, _mm256_loadu_ps(&m_AlbedoG[q]));
+            dz = _mm256_sub_ps(albedoB, _mm256_loadu_ps(&m_AlbedoB[q]));
+            exponent = _mm256_add_ps(exponent, _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                _mm256_mul_ps(dz, dz)), inverseAlbedoSigma));
+
+            __m256 weight = _mm256_mul_ps(_mm256_set1_ps(Kernel[kx] * Kernel[ky]), Utils::ExpNegative(exponent, MaxExponent));
+            sumR = _mm256_add_ps(sumR, _mm256_mul_ps(weight, _mm256_loadu_ps(&input.R[q])));
+            sumG = _mm256_add_ps(sumG, _mm256_mul_ps(weight, _mm256_loadu_ps(&input.G[q])));
+            sumB = _mm256_add_ps(sumB, _mm256_mul_ps(weight, _mm256_loadu_ps(&input.B[q])));
+            weightSum = _mm256_add_ps(weightSum, weight);
+        }
+    }
+
+    __m256 inverseWeightSum = _mm256_div_ps(_mm256_set1_ps(1.0f), weightSum);
+    sumR = _mm256_mul_ps(sumR, inverseWeightSum);
+    sumG = _mm256_mul_ps(sumG, inverseWeightSum);
+    sumB = _mm256_mul_ps(sumB, inverseWeightSum);
+    _mm256_storeu_ps(&output.R[p], sumR);
+    _mm256_storeu_ps(&output.G[p], sumG);
+    _mm256_storeu_ps(&output.B[p], sumB);
+    _mm256_storeu_ps(&output.L[p], _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sumR, luminanceR), _mm256_mul_ps(sumG, luminanceG)),
+        _mm256_mul_ps(sumB, luminanceB)));
+}
+#endif
@@ -0,0 +1,339 @@
+#include "DistributedRenderer.h"
+#include "SceneFile.h"
+#include "TileScheduler.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+
+namespace Utils
+{
+    //Every message starts with a header, the payload layouts below are sent as they are in memory - coordinator and
+    //workers have to be the same build (checked by the hello message, scenes by their .rtbin header)
+    static constexpr uint32_t MessageMagic = 0x54445452; //"RTDT"
+    static constexpr uint32_t ProtocolVersion = 1;
+
+    enum class MessageType : uint32_t
+    {
+        Hello = 1,  //Worker -> coordinator after connecting: HelloMessage
+        Job,        //Coordinator -> worker: JobMessage followed by the scene as .rtbin bytes
+        Tile,       //Coordinator -> worker: TileMessage to render
+        Result,     //Worker -> coordinator: TileMessage followed by the tile's accumulation, sample counts and pixels
+        Finish      //Coordinator -> worker: exit, no payload
+    };
+
+    struct MessageHeader
+    {
+        uint32_t Magic;
+        MessageType Type;
+        uint64_t Size; //Payload bytes after the header
+    };
+
+    struct HelloMessage
+    {
+        uint32_t Version;
+        uint32_t SettingsSize;
+    };
+
+    struct JobMessage
+    {
+        uint32_t Width, Height;
+        uint32_t Samples;
+        float VerticalFOV, NearClip, FarClip;
+        glm::vec3 Position, Direction;
+        Renderer::Settings Settings;
+    };
+    static_assert(std::is_trivially_copyable<JobMessage>::value, "Jobs are sent as they are in memory");
+
+    struct TileMessage
+    {
+        uint32_t X, Y, Width, Height;
+    };
+
+    //Bytes of a tile's result after its TileMessage
+    static uint64_t GetResultSize(const TileMessage& tile)
+    {
+        return (uint64_t)tile.Width * tile.Height * (sizeof(glm::vec4) + sizeof(uint32_t) + sizeof(uint32_t));
+    }
+
+    struct MessagePart
+    {
+        const void* Data;
+        size_t Size;
+    };
+
+    static bool WriteMessage(Socket& socket, MessageType type, std::initializer_list<MessagePart> parts = {})
+    {
+        MessageHeader header = { MessageMagic, type, 0 };
+        for(const MessagePart& part : parts)
+            header.Size += part.Size;
+        if(!socket.Send(&header, sizeof(header)))
+            return false;
+        for(const MessagePart& part : parts)
+        {
+            if(part.Size > 0 && !socket.Send(part.Data, part.Size))
+                return false;
+        }
+        return true;
+    }
+
+    static bool ReadMessageHeader(Socket& socket, MessageHeader& header)
+    {
+        return socket.Receive(&header, sizeof(header)) && header.Magic == MessageMagic;
+    }
+}
+
+RenderCoordinator::~RenderCoordinator()
+{
+    for(const std::unique_ptr<Worker>& worker : m_Workers)
+    {
+        if(worker->Alive)
+            Utils::WriteMessage(worker->Connection, Utils::MessageType::Finish);
+    }
+}
+
+bool RenderCoordinator::Listen(const std::string& address)
+{
+    return m_Listener.Listen(address);
+}
+
+bool RenderCoordinator::AcceptWorkers(uint32_t count)
+{
+    while(m_Workers.size() < count)
+    {
+        auto worker = std::make_unique<Worker>();
+        if(!m_Listener.Accept(worker->Connection))
+            return false;
+
+        //A worker from another build would read the jobs wrong, better to not render at all
+        Utils::MessageHeader header;
+        Utils::HelloMessage hello;
+        if(!Utils::ReadMessageHeader(worker->Connection, header) || header.Type != Utils::MessageType::Hello ||
+            header.Size != sizeof(hello) || !worker->Connection.Receive(&hello, sizeof(hello)) ||
+            hello.Version != Utils::ProtocolVersion || hello.SettingsSize != sizeof(Renderer::Settings))
+            return false;
+        m_Workers.push_back(std::move(worker));
+    }
+    return true;
+}
+
+bool RenderCoordinator::Render(const Scene& scene, const Camera& camera, const Renderer::Settings& settings, uint32_t samples, uint32_t tileSize)
+{
+    m_Width = camera.GetViewportWidth();
+    m_Height = camera.GetViewportHeight();
+    m_ImageData.assign((size_t)m_Width * m_Height, 0);
+    m_AccumulationData.assign((size_t)m_Width * m_Height, glm::vec4(0.0f));
+    m_SampleCounts.assign((size_t)m_Width * m_Height, 0);
+    m_Stats.assign(m_Workers.size(), {});
+    if(m_Workers.empty())
+        return false;
+
+    Utils::JobMessage job = {};
+    job.Width = m_Width;
+    job.Height = m_Height;
+    job.Samples = samples;
+    job.VerticalFOV = camera.GetVerticalFOV();
+    job.NearClip = camera.GetNearClip();
+    job.FarClip = camera.GetFarClip();
+    job.Position = camera.GetPosition();
+    job.Direction = camera.GetDirection();
+    job.Settings = settings;
+
+    //Built once here instead of once per worker, they get it with the scene like from a .rtbin file
+    BVH bvh;
+    const BVH* acceleration = scene.Acceleration.get();
+    if(!acceleration && settings.UseBVH)
+    {
+        bvh.Build(scene.Spheres);
+        acceleration = &bvh;
+    }
+    std::vector<uint8_t> sceneData;
+    SceneFile::WriteBinary(scene, acceleration, sceneData);
+
+    //Tiles on multiples of 4, so the workers' packets never cross into another worker's tile
+    //Handed out from the back, reversed to keep the curve order
+    tileSize = glm::max(4u, (tileSize + 3) / 4 * 4);
+    std::vector<Tile> pending = TileScheduler::CreateTiles(m_Width, m_Height, tileSize, settings.TileOrdering);
+    std::reverse(pending.begin(), pending.end());
+    size_t remaining = pending.size();
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    //A thread per worker: while it waits on its worker's tile it holds no lock, the others keep theirs busy
+    auto serveWorker = [&](uint32_t workerIndex)
+    {
+        Worker& worker = *m_Workers[workerIndex];
+        if(!worker.Alive || !Utils::WriteMessage(worker.Connection, Utils::MessageType::Job,
+            { { &job, sizeof(job) }, { sceneData.data(), sceneData.size() } }))
+        {
+            worker.Alive = false;
+            return;
+        }
+
+        std::vector<uint8_t> result;
+        while(true)
+        {
+            Tile tile;
+            {
+                //Nothing pending can still mean tiles in flight on a worker that might disconnect and give them back
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&] { return !pending.empty() || remaining == 0; });
+                if(remaining == 0)
+                    return;
+                tile = pending.back();
+                pending.pop_back();
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            Utils::TileMessage request = { tile.X, tile.Y, tile.Width, tile.Height };
+            Utils::TileMessage answer;
+            Utils::MessageHeader header;
+            result.resize(Utils::GetResultSize(request));
+            bool received = Utils::WriteMessage(worker.Connection, Utils::MessageType::Tile, { { &request, sizeof(request) } }) &&
+                Utils::ReadMessageHeader(worker.Connection, header) && header.Type == Utils::MessageType::Result &&
+                header.Size == sizeof(answer) + result.size() && worker.Connection.Receive(&answer, sizeof(answer)) &&
+                memcmp(&answer, &request, sizeof(answer)) == 0 && worker.Connection.Receive(result.data(), result.size());
+            if(!received)
+            {
+                //Whatever is left of this worker's connection is unusable, its tile goes to the others
+                worker.Connection.Close();
+                worker.Alive = false;
+                std::lock_guard<std::mutex> lock(mutex);
+                pending.push_back(tile);
+                condition.notify_all();
+                return;
+            }
+
+            //Tiles dont overlap, so the copies need no lock
+            size_t pixels = (size_t)tile.Width * tile.Height;
+            const glm::vec4* accumulation = (const glm::vec4*)result.data();
+            const uint32_t* sampleCounts = (const uint32_t*)(accumulation + pixels);
+            const uint32_t* imageData = sampleCounts + pixels;
+            for(uint32_t y = 0; y < tile.Height; y++)
+            {
+                size_t source = (size_t)y * tile.Width;
+                size_t target = tile.X + (size_t)(tile.Y + y) * m_Width;
+                memcpy(&m_AccumulationData[target], accumulation + source, tile.Width * sizeof(glm::vec4));
+                memcpy(&m_SampleCounts[target], sampleCounts + source, tile.Width * sizeof(uint32_t));
+                memcpy(&m_ImageData[target], imageData + source, tile.Width * sizeof(uint32_t));
+            }
+
+            WorkerStats& stats = m_Stats[workerIndex];
+            stats.Tiles++;
+            stats.Seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if(--remaining == 0)
+                condition.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(uint32_t i = 0; i < (uint32_t)m_Workers.size(); i++)
+        threads.emplace_back(serveWorker, i);
+    for(std::thread& thread : threads)
+        thread.join();
+    return remaining == 0;
+}
+
+bool RenderWorker::Connect(const std::string& address, float timeoutSeconds)
+{
+    auto start = std::chrono::steady_clock::now();
+    while(!m_Connection.Connect(address))
+    {
+        if(std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count() >= timeoutSeconds)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    Utils::HelloMessage hello = { Utils::ProtocolVersion, (uint32_t)sizeof(Renderer::Settings) };
+    return Utils::WriteMessage(m_Connection, Utils::MessageType::Hello, { { &hello, sizeof(hello) } });
+}
+
+bool RenderWorker::Run(uint32_t threadCount)
+{
+    Renderer renderer;
+    Scene scene;
+    Camera camera(45.0f, 0.1f, 100.0f);
+    uint32_t samples = 0;
+    std::vector<uint8_t> result;
+
+    while(true)
+    {
+        Utils::MessageHeader header;
+        if(!Utils::ReadMessageHeader(m_Connection, header))
+            return false;
+
+        if(header.Type == Utils::MessageType::Finish)
+            return true;
+
+        if(header.Type == Utils::MessageType::Job && header.Size > sizeof(Utils::JobMessage))
+        {
+            Utils::JobMessage job;
+            if(!m_Connection.Receive(&job, sizeof(job)))
+                return false;
+            //Owned by the scene arrays pointing into it, same as a mapped .rtbin file
+            auto sceneData = std::make_shared<std::vector<uint8_t>>(header.Size - sizeof(job));
+            if(!m_Connection.Receive(sceneData->data(), sceneData->size()) ||
+                !SceneFile::ReadBinary(sceneData->data(), sceneData->size(), sceneData, scene))
+                return false;
+
+            camera = Camera(job.VerticalFOV, job.NearClip, job.FarClip);
+            camera.SetRayDirectionCaching(job.Settings.CachedRayDirections);
+            camera.OnResize(job.Width, job.Height);
+            camera.SetPosition(job.Position);
+            camera.SetDirection(job.Direction);
+
+            //Every tile is rendered from 0 samples, a preview would only cost time
+            Renderer::Settings& settings = renderer.GetSettings();
+            settings = job.Settings;
+            settings.Accumulate = true;
+            settings.ProgressivePreview = false;
+            //Only the raw samples go back, denoising a single tile would just waste time
+            settings.Denoise = false;
+            //Tiles get exactly the samples the coordinator asks for, with every bounce
+            settings.FrameTimeBudget = false;
+            settings.ThreadCount = threadCount;
+            renderer.OnResize(job.Width, job.Height);
+            samples = job.Samples;
+            continue;
+        }
+
+        Utils::TileMessage tile;
+        if(header.Type != Utils::MessageType::Tile || header.Size != sizeof(tile) || !m_Connection.Receive(&tile, sizeof(tile)))
+            return false;
+        if(tile.Width == 0 || tile.Height == 0 || tile.X + tile.Width > renderer.GetWidth() || tile.Y + tile.Height > renderer.GetHeight())
+            return false;
+
+        //Like the headless renderer: a frame adds a sample per pixel until adaptive sampling says the tile is done
+        renderer.SetRegion(tile.X, tile.Y, tile.Width, tile.Height);
+        renderer.ResetFrameIndex();
+        for(uint32_t frame = 0; frame < samples; frame++)
+        {
+            renderer.Render(scene, camera);
+            if(renderer.IsConverged())
+                break;
+        }
+
+        size_t pixels = (size_t)tile.Width * tile.Height;
+        result.resize(Utils::GetResultSize(tile));
+        glm::vec4* accumulation = (glm::vec4*)result.data();
+        uint32_t* sampleCounts = (uint32_t*)(accumulation + pixels);
+        uint32_t* imageData = sampleCounts + pixels;
+        for(uint32_t y = 0; y < tile.Height; y++)
+        {
+            size_t source = tile.X + (size_t)(tile.Y + y) * renderer.GetWidth();
+            size_t target = (size_t)y * tile.Width;
+            memcpy(accumulation + target, renderer.GetAccumulationData() + source, tile.Width * sizeof(glm::vec4));
+            memcpy(sampleCounts + target, renderer.GetSampleCounts() + source, tile.Width * sizeof(uint32_t));
+            memcpy(imageData + target, renderer.GetImageData() + source, tile.Width * sizeof(uint32_t));
+        }
+        if(!Utils::WriteMessage(m_Connection, Utils::MessageType::Result, { { &tile, sizeof(tile) }, { result.data(), result.size() } }))
+            return false;
+        m_TilesRendered++;
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Renderer.h"
+#include "Socket.h"
+
+//Distributed rendering: one image rendered by several worker processes (on this machine or others)
+//The coordinator cuts the image into tiles and sends every worker the scene (as .rtbin bytes, BVH included), camera and
+//settings, then hands out tiles to whichever worker is free - a worker renders all samples of its tile with a normal
+//Renderer restricted to the tile (Renderer::SetRegion) and sends back the summed radiance, sample counts and pixels,
+//which the coordinator copies into the full image
+//Samples are seeded per pixel, so the image is the same as rendering it in 1 process, however many workers there are
+//Tiles of a worker that disconnects go to the others
+
+//Tiles rendered by a worker and the time the coordinator waited on them (send, render and receive)
+struct WorkerStats
+{
+    uint32_t Tiles = 0;
+    double Seconds = 0.0;
+};
+
+class RenderCoordinator
+{
+public:
+    RenderCoordinator() = default;
+    ~RenderCoordinator();
+    RenderCoordinator(const RenderCoordinator&) = delete;
+    RenderCoordinator& operator=(const RenderCoordinator&) = delete;
+
+    //Address to listen on, see Socket
+    bool Listen(const std::string& address);
+    //Blocks until count workers connected (or a connection failed)
+    bool AcceptWorkers(uint32_t count);
+    uint32_t GetWorkerCount() const { return (uint32_t)m_Workers.size(); }
+
+    //Render samples frames of the image the camera sees (its viewport size) in tileSize x tileSize tiles (rounded up to a
+    //multiple of 4), blocks until every tile is back - false when every worker is gone before that
+    //Workers stay connected for the next Render, the destructor tells them to exit
+    bool Render(const Scene& scene, const Camera& camera, const Renderer::Settings& settings, uint32_t samples, uint32_t tileSize = 128);
+
+    //Same layout as the Renderer getters
+    const uint32_t* GetImageData() const { return m_ImageData.data(); }
+    const glm::vec4* GetAccumulationData() const { return m_AccumulationData.data(); }
+    const uint32_t* GetSampleCounts() const { return m_SampleCounts.data(); }
+    uint32_t GetWidth() const { return m_Width; }
+    uint32_t GetHeight() const { return m_Height; }
+    //Per worker, in the order they connected, for the last Render
+    const std::vector<WorkerStats>& GetWorkerStats() const { return m_Stats; }
+private:
+    struct Worker
+    {
+        Socket Connection;
+        bool Alive = true;
+    };
+    Socket m_Listener;
+    std::vector<std::unique_ptr<Worker>> m_Workers;
+    std::vector<WorkerStats> m_Stats;
+
+    uint32_t m_Width = 0, m_Height = 0;
+    std::vector<uint32_t> m_ImageData;
+    std::vector<glm::vec4> m_AccumulationData;
+    std::vector<uint32_t> m_SampleCounts;
+};
+
+//Worker process side: renders the coordinator's tiles until it says to stop
+class RenderWorker
+{
+public:
+    //Keeps trying for timeoutSeconds, so workers can be started before the coordinator
+    bool Connect(const std::string& address, float timeoutSeconds = 10.0f);
+    //threadCount: render threads of this worker, 0 = 1 per core
+    //Returns true when the coordinator finished, false when the connection broke
+    bool Run(uint32_t threadCount = 0);
+    //Tiles rendered by Run so far
+    uint32_t GetTilesRendered() const { return m_TilesRendered; }
+private:
+    Socket m_Connection;
+    uint32_t m_TilesRendered = 0;
+};
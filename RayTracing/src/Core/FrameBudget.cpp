@@ -0,0 +1,120 @@
+#include "FrameBudget.h"
+
+#include <algorithm>
+
+namespace Utils
+{
+    //Share of a new measurement in the smoothed costs
+    static constexpr double MeasurementWeight = 0.5;
+    //Better levels are only picked when they are predicted to take at most this much of the target: a level that
+    //just fits would otherwise take turns with the one below it every other frame
+    static constexpr double UpgradeMargin = 0.8;
+}
+
+void FrameBudget::Update(const Settings& settings, const Measurement& measurement)
+{
+    if(measurement.Rays > 0 && measurement.Samples > 0 && measurement.TraceSeconds > 0.0)
+    {
+        //Cores taken by other processes show up as fewer tiles done in parallel, slower cores as more time per ray
+        double secondsPerRay = measurement.TileSeconds / (double)measurement.Rays;
+        double parallelism = std::max(measurement.TileSeconds / measurement.TraceSeconds, 1.0);
+        double overheadSeconds = std::max(measurement.FrameSeconds - measurement.TraceSeconds, 0.0);
+        double raysPerSample = (double)measurement.Rays / (double)measurement.Samples;
+
+        double weight = m_SecondsPerRay > 0.0 ? Utils::MeasurementWeight : 1.0;
+        m_SecondsPerRay += (secondsPerRay - m_SecondsPerRay) * weight;
+        m_Parallelism += (parallelism - m_Parallelism) * weight;
+        m_OverheadSeconds += (overheadSeconds - m_OverheadSeconds) * weight;
+        //Path lengths only mix when they were measured with the same bounce limit
+        if(measurement.Bounces == m_MeasuredBounces)
+            m_RaysPerSample += (raysPerSample - m_RaysPerSample) * weight;
+        else
+            m_RaysPerSample = raysPerSample;
+        m_MeasuredBounces = std::max(measurement.Bounces, 1u);
+    }
+
+    //Nothing measured yet
+    if(m_SecondsPerRay == 0.0)
+        return;
+
+    uint32_t count = GetLevelCount(settings);
+    uint32_t current = GetLevelIndex(settings);
+
+    //Levels get cheaper from first to last, so the first one that fits is the best one that does
+    double targetSeconds = settings.TargetMilliseconds / 1000.0;
+    uint32_t index = count - 1;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if(PredictSeconds(GetLevelAt(settings, i), measurement.Pixels) <= targetSeconds)
+        {
+            index = i;
+            break;
+        }
+    }
+    if(index < current)
+    {
+        index = current;
+        for(uint32_t i = 0; i < current; i++)
+        {
+            if(PredictSeconds(GetLevelAt(settings, i), measurement.Pixels) <= targetSeconds * Utils::UpgradeMargin)
+            {
+                index = i;
+                break;
+            }
+        }
+    }
+
+    m_LevelIndex = index;
+}
+
+FrameBudget::Level FrameBudget::GetLevel(const Settings& settings) const
+{
+    return GetLevelAt(settings, GetLevelIndex(settings));
+}
+
+uint32_t FrameBudget::GetLevelIndex(const Settings& settings) const
+{
+    //Settings can change between frames, the index is kept within what they allow
+    uint32_t index = m_LevelIndex == ~0u ? std::max(settings.MaxSamples, 1u) - 1 : m_LevelIndex;
+    return std::min(index, GetLevelCount(settings) - 1);
+}
+
+uint32_t FrameBudget::GetLevelCount(const Settings& settings)
+{
+    uint32_t minBounces = std::clamp(settings.MinBounces, 1u, std::max(settings.MaxBounces, 1u));
+    uint32_t scales = std::max(settings.MaxScale, 1u) - 1;
+    return std::max(settings.MaxSamples, 1u) + (std::max(settings.MaxBounces, 1u) - minBounces) + scales;
+}
+
+FrameBudget::Level FrameBudget::GetLevelAt(const Settings& settings, uint32_t index)
+{
+    uint32_t maxSamples = std::max(settings.MaxSamples, 1u);
+    uint32_t maxBounces = std::max(settings.MaxBounces, 1u);
+    uint32_t minBounces = std::clamp(settings.MinBounces, 1u, maxBounces);
+
+    Level level;
+    level.Bounces = maxBounces;
+    if(index < maxSamples)
+    {
+        level.Samples = maxSamples - index;
+        return level;
+    }
+    index -= maxSamples - 1;
+    if(index <= maxBounces - minBounces)
+    {
+        level.Bounces = maxBounces - index;
+        return level;
+    }
+    index -= maxBounces - minBounces;
+    level.Bounces = minBounces;
+    level.Scale = 1 + index;
+    return level;
+}
+
+double FrameBudget::PredictSeconds(const Level& level, uint64_t pixels) const
+{
+    double paths = (double)pixels * level.Samples / ((double)level.Scale * level.Scale);
+    //Shorter limits cut paths short, longer ones let a share of them go on - neither more than the limit
+    double raysPerSample = std::min((double)level.Bounces, m_RaysPerSample * level.Bounces / m_MeasuredBounces);
+    return paths * raysPerSample * m_SecondsPerRay / m_Parallelism + m_OverheadSeconds;
+}
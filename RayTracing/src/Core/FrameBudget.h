@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+
+//Frame time budget: a feedback controller that decides how much work the next frame does so frames take about
+//TargetMilliseconds - predictable latency on machines where the number of free cores comes and goes
+//Quality is given up in a fixed order: samples per pixel first, then bounces, then resolution, and won back the
+//other way round once frames are comfortably below the target again
+//Predictions come from the per tile costs of the frames before: their sum over the rays traced is what a ray costs
+//(in thread time), their sum over the wall time of the tiles is how many cores actually did the work
+class FrameBudget
+{
+public:
+    struct Settings
+    {
+        float TargetMilliseconds = 16.0f;
+        uint32_t MaxSamples = 16;
+        uint32_t MinBounces = 2, MaxBounces = 5;
+        //Coarsest resolution: 1/MaxScale of the image in both directions
+        uint32_t MaxScale = 8;
+    };
+
+    //What a frame renders
+    struct Level
+    {
+        uint32_t Samples = 1; //Per pixel, only at full resolution
+        uint32_t Bounces = 5; //Longest path in rays
+        uint32_t Scale = 1; //Resolution divider, above 1 = 1 sample per Scale x Scale block without accumulating
+    };
+
+    //What the last frame cost
+    struct Measurement
+    {
+        double FrameSeconds = 0.0; //The whole frame
+        double TraceSeconds = 0.0; //Wall time from the first tile started to the last one finished
+        double TileSeconds = 0.0; //Time of every tile summed, whichever thread ran it
+        uint64_t Rays = 0;
+        uint64_t Samples = 0;
+        uint64_t Pixels = 0; //Full resolution pixels of the image
+        uint32_t Bounces = 5; //Longest path the frame allowed
+    };
+
+    //Learn from the last frame and pick the level of the next one, frames that traced nothing teach nothing
+    void Update(const Settings& settings, const Measurement& measurement);
+    //Level for the next frame - 1 sample per pixel at full resolution until the first Update
+    Level GetLevel(const Settings& settings) const;
+private:
+    //Levels from best (0) to worst: MaxSamples..1 samples, then MaxBounces - 1..MinBounces bounces, then scale 2, 3..MaxScale
+    static uint32_t GetLevelCount(const Settings& settings);
+    static Level GetLevelAt(const Settings& settings, uint32_t index);
+    uint32_t GetLevelIndex(const Settings& settings) const;
+    double PredictSeconds(const Level& level, uint64_t pixels) const;
+private:
+    //~0 = none picked yet
+    uint32_t m_LevelIndex = ~0u;
+    //Smoothed over frames, so 1 frame that got unlucky with the scheduler doesnt throw the level around
+    double m_SecondsPerRay = 0.0;
+    double m_Parallelism = 1.0;
+    double m_OverheadSeconds = 0.0;
+    //Measured with paths of at most m_MeasuredBounces rays
+    double m_RaysPerSample = 0.0;
+    uint32_t m_MeasuredBounces = 1;
+};
@@ -0,0 +1,126 @@
+#include "ImageResolve.h"
+
+#include <cmath>
+#include <vector>
+
+#if RT_X86
+    #include <emmintrin.h>
+#endif
+
+namespace ImageResolve
+{
+    /* Every level does the same float operations in the same order, so every level writes the same bytes:
+     * reciprocal = count ? 1 / count : 0 (1 when the sums are colors already)
+     * value = min(max(sum * reciprocal, 0), 1) - max first, so NaN becomes 0 like maxps does it
+     * Linear: value * 255 rounded down (cvttps)
+     * SRGB: table[value * 4095 rounded to nearest (cvtps)] for red, green and blue, alpha stays linear
+     * No multiply-add anywhere: a fused one rounds differently, and only some builds would fuse it
+     */
+    const uint32_t* GetSRGBTable()
+    {
+        static const std::vector<uint32_t> table = []()
+        {
+            std::vector<uint32_t> result(SRGBTableSize);
+            for(uint32_t i = 0; i < SRGBTableSize; i++)
+            {
+                double linear = (double)i / (double)(SRGBTableSize - 1);
+                double encoded = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+                result[i] = (uint32_t)(encoded * 255.0 + 0.5);
+            }
+            return result;
+        }();
+        return table.data();
+    }
+
+    void ResolveScalar(const glm::vec4* sums, const uint32_t* sampleCounts, uint32_t count, Encoding encoding, uint32_t* output)
+    {
+        const uint32_t* table = encoding == Encoding::SRGB ? GetSRGBTable() : nullptr;
+        for(uint32_t i = 0; i < count; i++)
+        {
+            float reciprocal = 1.0f;
+            if(sampleCounts)
+                reciprocal = sampleCounts[i] ? 1.0f / (float)sampleCounts[i] : 0.0f;
+
+            uint32_t pixel = 0;
+            for(int c = 0; c < 4; c++)
+            {
+                float value = sums[i][c] * reciprocal;
+                value = value > 0.0f ? value : 0.0f;
+                value = value < 1.0f ? value : 1.0f;
+                uint32_t byte = table && c < 3 ? table[(int)std::lrint(value * (float)(SRGBTableSize - 1))] : (uint32_t)(int)(value * 255.0f);
+                pixel |= byte << (c * 8);
+            }
+            output[i] = pixel;
+        }
+    }
+
+#if RT_X86
+    //4 pixels per iteration, 1 register per pixel
+    void ResolveSSE(const glm::vec4* sums, const uint32_t* sampleCounts, uint32_t count, Encoding encoding, uint32_t* output)
+    {
+        const uint32_t* table = encoding == Encoding::SRGB ? GetSRGBTable() : nullptr;
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 scale = _mm_set1_ps(255.0f);
+        const __m128 tableScale = _mm_set1_ps((float)(SRGBTableSize - 1));
+
+        uint32_t i = 0;
+        for(; i + 4 <= count; i += 4)
+        {
+            __m128 reciprocals = one;
+            if(sampleCounts)
+            {
+                __m128i counts = _mm_loadu_si128((const __m128i*)&sampleCounts[i]);
+                __m128 nonZero = _mm_castsi128_ps(_mm_xor_si128(_mm_cmpeq_epi32(counts, _mm_setzero_si128()), _mm_set1_epi32(-1)));
+                reciprocals = _mm_and_ps(_mm_div_ps(one, _mm_cvtepi32_ps(counts)), nonZero);
+            }
+            alignas(16) float pixelReciprocals[4];
+            _mm_store_ps(pixelReciprocals, reciprocals);
+
+            __m128i pixels[4];
+            for(int p = 0; p < 4; p++)
+            {
+                __m128 value = _mm_mul_ps(_mm_loadu_ps(&sums[i + p].x), _mm_set1_ps(pixelReciprocals[p]));
+                value = _mm_min_ps(_mm_max_ps(value, zero), one);
+                pixels[p] = _mm_cvttps_epi32(_mm_mul_ps(value, scale));
+                if(table)
+                {
+                    //No gather before AVX2: the indices go through memory
+                    alignas(16) int32_t indices[4];
+                    _mm_store_si128((__m128i*)indices, _mm_cvtps_epi32(_mm_mul_ps(value, tableScale)));
+                    pixels[p] = _mm_setr_epi32((int)table[indices[0]], (int)table[indices[1]], (int)table[indices[2]], _mm_cvtsi128_si32(_mm_shuffle_epi32(pixels[p], _MM_SHUFFLE(3, 3, 3, 3))));
+                }
+            }
+
+            //32 bit channels -> 16 -> 8, in pixel order
+            __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(pixels[0], pixels[1]), _mm_packs_epi32(pixels[2], pixels[3]));
+            _mm_storeu_si128((__m128i*)&output[i], bytes);
+        }
+
+        if(i < count)
+            ResolveScalar(sums + i, sampleCounts ? sampleCounts + i : nullptr, count - i, encoding, output + i);
+    }
+#endif
+
+    ResolveFunction Get(SIMDLevel level)
+    {
+        if((int)level > (int)SphereKernels::GetSupportedLevel())
+            level = SphereKernels::GetSupportedLevel();
+
+        switch(level)
+        {
+#if RT_X86
+        case SIMDLevel::AVX2: return ResolveAVX2;
+        case SIMDLevel::SSE: return ResolveSSE;
+#endif
+        default: return ResolveScalar;
+        }
+    }
+
+    uint32_t ResolvePixel(const glm::vec4& color, Encoding encoding)
+    {
+        uint32_t pixel;
+        ResolveScalar(&color, nullptr, 1, encoding, &pixel);
+        return pixel;
+    }
+}
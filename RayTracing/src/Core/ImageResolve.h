@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "SphereKernels.h"
+
+//Resolve: accumulated sample sums -> the RGBA8 pixels that get displayed and written to 8 bit files
+//Runs once per frame over the pixels that got new samples instead of once per sample, 4 (SSE) or 8 (AVX2) pixels at a
+//time: 1 reciprocal per pixel instead of 4 divisions, clamp, encode, pack to bytes
+namespace ImageResolve
+{
+    //How 0..1 values become bytes
+    enum class Encoding
+    {
+        Linear = 0, //value * 255, rounded down - what the renderer always wrote
+        SRGB //sRGB transfer curve, through a table of 4096 steps (gathered 8 at a time with AVX2)
+    };
+
+    //count pixels: sums[i] / sampleCounts[i] (sampleCounts null: sums are colors already), clamped to 0..1, encoded and
+    //packed to RGBA8 (abgr in memory) in output - pixels without samples come out 0
+    //Every level writes the same bytes
+    using ResolveFunction = void(*)(const glm::vec4* sums, const uint32_t* sampleCounts, uint32_t count, Encoding encoding, uint32_t* output);
+
+    //Kernel for the requested level - falls back to the best supported level below it
+    ResolveFunction Get(SIMDLevel level);
+    //1 color, same bytes as the kernels - for pixels written outside the resolve pass (previews)
+    uint32_t ResolvePixel(const glm::vec4& color, Encoding encoding);
+
+    void ResolveScalar(const glm::vec4* sums, const uint32_t* sampleCounts, uint32_t count, Encoding encoding, uint32_t* output);
+#if RT_X86
+    void ResolveSSE(const glm::vec4* sums, const uint32_t* sampleCounts, uint32_t count, Encoding encoding, uint32_t* output);
+    //Lives in its own file, built with AVX2 code generation - only call when GetSupportedLevel() says so
+    void ResolveAVX2(const glm::vec4* sums, const uint32_t* sampleCounts, uint32_t count, Encoding encoding, uint32_t* output);
+#endif
+
+    //sRGB table: entry i is the byte for linear value i / SRGBTableSize - 1, as uint32 so AVX2 can gather from it
+    static constexpr uint32_t SRGBTableSize = 4096;
+    const uint32_t* GetSRGBTable();
+}
@@ -0,0 +1,56 @@
+#include "ImageResolve.h"
+
+//Built with AVX2 code generation (see premake5.lua), so nothing in here may run before checking GetSupportedLevel()
+#if RT_X86
+#include <immintrin.h>
+
+namespace ImageResolve
+{
+    //Same math as ResolveSSE, 8 pixels per iteration: 2 pixels per register, the sRGB table gathered 8 channels at a time
+    void ResolveAVX2(const glm::vec4* sums, const uint32_t* sampleCounts, uint32_t count, Encoding encoding, uint32_t* output)
+    {
+        const uint32_t* table = encoding == Encoding::SRGB ? GetSRGBTable() : nullptr;
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 scale = _mm256_set1_ps(255.0f);
+        const __m256 tableScale = _mm256_set1_ps((float)(SRGBTableSize - 1));
+        //packs and packus work within 128 bit halves, which leaves the pixels in the order 0 2 4 6 1 3 5 7
+        const __m256i pixelOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+        uint32_t i = 0;
+        for(; i + 8 <= count; i += 8)
+        {
+            __m256 reciprocals = one;
+            if(sampleCounts)
+            {
+                __m256i counts = _mm256_loadu_si256((const __m256i*)&sampleCounts[i]);
+                __m256 isZero = _mm256_castsi256_ps(_mm256_cmpeq_epi32(counts, _mm256_setzero_si256()));
+                reciprocals = _mm256_andnot_ps(isZero, _mm256_div_ps(one, _mm256_cvtepi32_ps(counts)));
+            }
+
+            __m256i pixels[4];
+            for(int p = 0; p < 4; p++)
+            {
+                //Pixel 2p's reciprocal in the low half, 2p + 1's in the high half
+                __m256i spread = _mm256_setr_epi32(2 * p, 2 * p, 2 * p, 2 * p, 2 * p + 1, 2 * p + 1, 2 * p + 1, 2 * p + 1);
+                __m256 value = _mm256_mul_ps(_mm256_loadu_ps(&sums[i + 2 * p].x), _mm256_permutevar8x32_ps(reciprocals, spread));
+                value = _mm256_min_ps(_mm256_max_ps(value, zero), one);
+                pixels[p] = _mm256_cvttps_epi32(_mm256_mul_ps(value, scale));
+                if(table)
+                {
+                    __m256i indices = _mm256_cvtps_epi32(_mm256_mul_ps(value, tableScale));
+                    __m256i encoded = _mm256_i32gather_epi32((const int*)table, indices, 4);
+                    //Alpha (channels 3 and 7) stays linear
+                    pixels[p] = _mm256_blend_epi32(encoded, pixels[p], 0x88);
+                }
+            }
+
+            __m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(pixels[0], pixels[1]), _mm256_packs_epi32(pixels[2], pixels[3]));
+            _mm256_storeu_si256((__m256i*)&output[i], _mm256_permutevar8x32_epi32(bytes, pixelOrder));
+        }
+
+        if(i < count)
+            ResolveSSE(sums + i, sampleCounts ? sampleCounts + i : nullptr, count - i, encoding, output + i);
+    }
+}
+#endif
@@ -0,0 +1,242 @@
+#include "ImageWriter.h"
+
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace Utils
+{
+    static void AppendU32BE(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back((uint8_t)(value >> 24));
+        out.push_back((uint8_t)(value >> 16));
+        out.push_back((uint8_t)(value >> 8));
+        out.push_back((uint8_t)value);
+    }
+
+    template<typename T>
+    static void AppendLE(std::vector<uint8_t>& out, T value)
+    {
+        const uint8_t* bytes = (const uint8_t*)&value;
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    static void AppendString(std::vector<uint8_t>& out, const char* str)
+    {
+        while(*str)
+            out.push_back((uint8_t)*str++);
+        out.push_back(0);
+    }
+
+    static uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+    {
+        static uint32_t table[256] = {};
+        static bool tableReady = false;
+        if(!tableReady)
+        {
+            for(uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t c = i;
+                for(int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[i] = c;
+            }
+            tableReady = true;
+        }
+
+        crc = ~crc;
+        for(size_t i = 0; i < size; i++)
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    static void AppendPNGChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+    {
+        AppendU32BE(out, (uint32_t)data.size());
+        size_t typeOffset = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        //Crc covers type + data
+        AppendU32BE(out, Crc32(out.data() + typeOffset, out.size() - typeOffset));
+    }
+
+    static bool WriteFile(const std::string& path, const void* data, size_t size)
+    {
+        std::ofstream stream(path, std::ios::binary);
+        if(!stream)
+            return false;
+        stream.write((const char*)data, (std::streamsize)size);
+        return (bool)stream;
+    }
+}
+
+namespace ImageWriter
+{
+    bool WritePPM(const std::string& path, const uint32_t* pixels, uint32_t width, uint32_t height)
+    {
+        std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        std::vector<uint8_t> data(header.begin(), header.end());
+        data.reserve(data.size() + (size_t)width * height * 3);
+
+        for(uint32_t y = height; y-- > 0;)
+        {
+            for(uint32_t x = 0; x < width; x++)
+            {
+                uint32_t pixel = pixels[x + y * width];
+                data.push_back((uint8_t)pixel);
+                data.push_back((uint8_t)(pixel >> 8));
+                data.push_back((uint8_t)(pixel >> 16));
+            }
+        }
+        return Utils::WriteFile(path, data.data(), data.size());
+    }
+
+    bool WritePNG(const std::string& path, const uint32_t* pixels, uint32_t width, uint32_t height)
+    {
+        //Raw scanlines: filter byte (0 = none) followed by RGBA - abgr uint32 is already rgba in memory
+        const size_t rowSize = (size_t)width * 4 + 1;
+        std::vector<uint8_t> raw(rowSize * height);
+        for(uint32_t y = 0; y < height; y++)
+        {
+            uint8_t* row = raw.data() + y * rowSize;
+            row[0] = 0;
+            memcpy(row + 1, pixels + (size_t)(height - 1 - y) * width, (size_t)width * 4);
+        }
+
+        //zlib stream with uncompressed (stored) deflate blocks - keeps us free of a zlib dependency,
+        //files are bigger but writing is basically a memcpy
+        std::vector<uint8_t> zlib = { 0x78, 0x01 };
+        size_t offset = 0;
+        do
+        {
+            uint16_t blockSize = (uint16_t)std::min<size_t>(raw.size() - offset, 65535);
+            bool last = offset + blockSize == raw.size();
+            zlib.push_back(last ? 1 : 0);
+            Utils::AppendLE<uint16_t>(zlib, blockSize);
+            Utils::AppendLE<uint16_t>(zlib, (uint16_t)~blockSize);
+            zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+            offset += blockSize;
+        } while(offset < raw.size());
+
+        uint32_t a = 1, b = 0;
+        for(uint8_t byte : raw)
+        {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        Utils::AppendU32BE(zlib, (b << 16) | a);
+
+        std::vector<uint8_t> header;
+        Utils::AppendU32BE(header, width);
+        Utils::AppendU32BE(header, height);
+        header.push_back(8); //Bit depth
+        header.push_back(6); //Color type: RGBA
+        header.push_back(0); //Compression
+        header.push_back(0); //Filter
+        header.push_back(0); //Interlace
+
+        std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        Utils::AppendPNGChunk(png, "IHDR", header);
+        Utils::AppendPNGChunk(png, "IDAT", zlib);
+        Utils::AppendPNGChunk(png, "IEND", {});
+        return Utils::WriteFile(path, png.data(), png.size());
+    }
+
+    bool WriteEXR(const std::string& path, const glm::vec4* accumulation, const uint32_t* sampleCounts, uint32_t width, uint32_t height)
+    {
+        //Uncompressed scanline OpenEXR with 32 bit float RGB channels
+        std::vector<uint8_t> exr;
+        Utils::AppendLE<uint32_t>(exr, 20000630); //Magic number
+        Utils::AppendLE<uint32_t>(exr, 2); //Version 2, single part scanline
+
+        //Channels are stored in alphabetical order
+        const char* channels[] = { "B", "G", "R" };
+        Utils::AppendString(exr, "channels");
+        Utils::AppendString(exr, "chlist");
+        Utils::AppendLE<int32_t>(exr, 3 * (2 + 16) + 1);
+        for(const char* channel : channels)
+        {
+            Utils::AppendString(exr, channel);
+            Utils::AppendLE<int32_t>(exr, 2); //FLOAT
+            Utils::AppendLE<uint32_t>(exr, 0); //pLinear + reserved
+            Utils::AppendLE<int32_t>(exr, 1); //xSampling
+            Utils::AppendLE<int32_t>(exr, 1); //ySampling
+        }
+        exr.push_back(0);
+
+        Utils::AppendString(exr, "compression");
+        Utils::AppendString(exr, "compression");
+        Utils::AppendLE<int32_t>(exr, 1);
+        exr.push_back(0); //NO_COMPRESSION
+
+        for(const char* window : { "dataWindow", "displayWindow" })
+        {
+            Utils::AppendString(exr, window);
+            Utils::AppendString(exr, "box2i");
+            Utils::AppendLE<int32_t>(exr, 16);
+            Utils::AppendLE<int32_t>(exr, 0);
+            Utils::AppendLE<int32_t>(exr, 0);
+            Utils::AppendLE<int32_t>(exr, (int32_t)width - 1);
+            Utils::AppendLE<int32_t>(exr, (int32_t)height - 1);
+        }
+
+        Utils::AppendString(exr, "lineOrder");
+        Utils::AppendString(exr, "lineOrder");
+        Utils::AppendLE<int32_t>(exr, 1);
+        exr.push_back(0); //INCREASING_Y
+
+        Utils::AppendString(exr, "pixelAspectRatio");
+        Utils::AppendString(exr, "float");
+        Utils::AppendLE<int32_t>(exr, 4);
+        Utils::AppendLE<float>(exr, 1.0f);
+
+        Utils::AppendString(exr, "screenWindowCenter");
+        Utils::AppendString(exr, "v2f");
+        Utils::AppendLE<int32_t>(exr, 8);
+        Utils::AppendLE<float>(exr, 0.0f);
+        Utils::AppendLE<float>(exr, 0.0f);
+
+        Utils::AppendString(exr, "screenWindowWidth");
+        Utils::AppendString(exr, "float");
+        Utils::AppendLE<int32_t>(exr, 4);
+        Utils::AppendLE<float>(exr, 1.0f);
+        exr.push_back(0); //End of header
+
+        //Offset table: one scanline per block
+        const uint32_t lineDataSize = width * 3 * sizeof(float);
+        const uint64_t tableStart = exr.size();
+        const uint64_t firstLine = tableStart + (uint64_t)height * sizeof(uint64_t);
+        for(uint32_t y = 0; y < height; y++)
+            Utils::AppendLE<uint64_t>(exr, firstLine + (uint64_t)y * (8 + lineDataSize));
+
+        for(uint32_t y = 0; y < height; y++)
+        {
+            Utils::AppendLE<int32_t>(exr, (int32_t)y);
+            Utils::AppendLE<uint32_t>(exr, lineDataSize);
+
+            size_t rowStart = (size_t)(height - 1 - y) * width;
+            for(int channel = 2; channel >= 0; channel--)
+                for(uint32_t x = 0; x < width; x++)
+                    Utils::AppendLE<float>(exr, accumulation[rowStart + x][channel] / (float)std::max(sampleCounts[rowStart + x], 1u));
+        }
+
+        return Utils::WriteFile(path, exr.data(), exr.size());
+    }
+
+    bool Write(const std::string& path, const uint32_t* pixels, const glm::vec4* accumulation, const uint32_t* sampleCounts,
+        uint32_t width, uint32_t height)
+    {
+        std::string extension = path.substr(path.find_last_of('.') + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+
+        if(extension == "ppm")
+            return WritePPM(path, pixels, width, height);
+        if(extension == "png")
+            return WritePNG(path, pixels, width, height);
+        if(extension == "exr")
+            return WriteEXR(path, accumulation, sampleCounts, width, height);
+        return false;
+    }
+}
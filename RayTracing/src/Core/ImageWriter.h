@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+//Write renderer output to disk - used by the headless renderer, no GPU or window needed
+//Rows are flipped on write: the renderer stores the bottom row first (the app flips uv's when displaying)
+namespace ImageWriter
+{
+    //8 bit formats, pixels as produced by Renderer::GetImageData (RGBA8, abgr in memory)
+    bool WritePPM(const std::string& path, const uint32_t* pixels, uint32_t width, uint32_t height);
+    bool WritePNG(const std::string& path, const uint32_t* pixels, uint32_t width, uint32_t height);
+
+    //HDR output straight from the accumulation buffer - divided by the per pixel sample counts, not clamped
+    bool WriteEXR(const std::string& path, const glm::vec4* accumulation, const uint32_t* sampleCounts, uint32_t width, uint32_t height);
+
+    //Pick the format from the file extension (.ppm, .png or .exr)
+    bool Write(const std::string& path, const uint32_t* pixels, const glm::vec4* accumulation, const uint32_t* sampleCounts,
+        uint32_t width, uint32_t height);
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cfloat>
+#include <glm/glm.hpp>
+#include "Ray.h"
+
+namespace Intersect
+{
+    //Slab test, returns distance to where the ray enters the box or FLT_MAX on a miss
+    //inverseDirection = 1 / ray.Direction, precomputed once per ray
+    inline float RayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boxMin, const glm::vec3& boxMax, float maxDistance)
+    {
+        glm::vec3 t0 = (boxMin - origin) * inverseDirection;
+        glm::vec3 t1 = (boxMax - origin) * inverseDirection;
+        glm::vec3 tSmall = glm::min(t0, t1);
+        glm::vec3 tBig = glm::max(t0, t1);
+        float tNear = glm::max(glm::max(tSmall.x, tSmall.y), tSmall.z);
+        float tFar = glm::min(glm::min(tBig.x, tBig.y), tBig.z);
+        if (tFar < tNear || tFar <= 0.0f || tNear >= maxDistance)
+            return FLT_MAX;
+        return tNear;
+    }
+}
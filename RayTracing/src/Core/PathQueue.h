@@ -0,0 +1,66 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Ray.h"
+#include "Random.h"
+
+//Every path in flight of the wavefront renderer, in SoA layout: a stage only streams through the arrays it needs
+//(intersection reads rays and writes hits, shading reads hits and writes rays) instead of a whole path per pixel
+struct PathQueue
+{
+    //Ray of the current bounce
+    std::vector<float> OriginX, OriginY, OriginZ;
+    std::vector<float> DirectionX, DirectionY, DirectionZ;
+    //Closest hit of the current bounce, ObjectIndex -1 on a miss
+    std::vector<float> HitDistance;
+    std::vector<int> ObjectIndex;
+    //Throughput and random numbers of the path
+    std::vector<float> Multiplier;
+    std::vector<Utils::Random> Randoms;
+    //Where the path's color goes, paths move around when the queue gets compacted
+    std::vector<uint32_t> Slot;
+    //Path still going after the last shade
+    std::vector<uint8_t> Alive;
+
+    uint32_t Count = 0;
+
+    void Resize(uint32_t capacity)
+    {
+        if (capacity <= Slot.size())
+            return;
+        for (std::vector<float>* array : { &OriginX, &OriginY, &OriginZ, &DirectionX, &DirectionY, &DirectionZ, &HitDistance, &Multiplier })
+            array->resize(capacity);
+        ObjectIndex.resize(capacity);
+        Randoms.resize(capacity);
+        Slot.resize(capacity);
+        Alive.resize(capacity);
+    }
+
+    Ray GetRay(uint32_t i) const
+    {
+        Ray ray;
+        ray.Origin = glm::vec3(OriginX[i], OriginY[i], OriginZ[i]);
+        ray.Direction = glm::vec3(DirectionX[i], DirectionY[i], DirectionZ[i]);
+        return ray;
+    }
+
+    void SetRay(uint32_t i, const Ray& ray)
+    {
+        OriginX[i] = ray.Origin.x;
+        OriginY[i] = ray.Origin.y;
+        OriginZ[i] = ray.Origin.z;
+        DirectionX[i] = ray.Direction.x;
+        DirectionY[i] = ray.Direction.y;
+        DirectionZ[i] = ray.Direction.z;
+    }
+
+    //Copy the state a path needs for its next bounce (hits get overwritten anyway)
+    void CopyPath(uint32_t to, const PathQueue& from, uint32_t i)
+    {
+        SetRay(to, from.GetRay(i));
+        Multiplier[to] = from.Multiplier[i];
+        Randoms[to] = from.Randoms[i];
+        Slot[to] = from.Slot[i];
+    }
+};
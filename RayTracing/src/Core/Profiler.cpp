@@ -0,0 +1,254 @@
+#include "Profiler.h"
+
+#include <mutex>
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace Utils
+{
+    struct TraceEvent
+    {
+        const char* Name;
+        double Start, Duration; //Microseconds
+        uint32_t Thread;
+    };
+
+    //Everything 1 thread recorded since the last NextFrame, only written by that thread
+    struct ThreadData
+    {
+        ProfileCounters Counters;
+        //Zones and Events, only ever contended while NextFrame collects them
+        std::mutex ZoneMutex;
+        std::vector<ProfileZoneStats> Zones;
+        std::vector<TraceEvent> Events;
+        uint32_t Id = 0;
+        //Thread is gone, dropped once its last frame got collected
+        bool Exited = false;
+    };
+
+    struct ProfilerState
+    {
+        std::mutex Mutex;
+        std::vector<std::unique_ptr<ThreadData>> Threads;
+        uint32_t NextThreadId = 0;
+        ProfileFrame LastFrame;
+
+        std::atomic<bool> Tracing{ false };
+        std::vector<TraceEvent> TraceEvents;
+        //End of every frame and its counters
+        std::vector<std::pair<double, ProfileCounters>> TraceFrames;
+
+        std::chrono::steady_clock::time_point Epoch = std::chrono::steady_clock::now();
+    };
+
+    static ProfilerState& GetProfilerState()
+    {
+        static ProfilerState state;
+        return state;
+    }
+
+    //Marks the thread's data as exited when the thread ends, only created for threads that recorded something
+    struct ThreadExit
+    {
+        ThreadData* Data = nullptr;
+        ~ThreadExit()
+        {
+            if(!Data)
+                return;
+            ProfilerState& state = GetProfilerState();
+            std::lock_guard<std::mutex> lock(state.Mutex);
+            Data->Exited = true;
+            Profiler::Detail::t_Counters = nullptr;
+        }
+    };
+    static thread_local ThreadExit t_ThreadExit;
+    static thread_local ThreadData* t_ThreadData = nullptr;
+
+    static ThreadData& GetThreadData()
+    {
+        if(!t_ThreadData)
+            Profiler::Detail::RegisterThread();
+        return *t_ThreadData;
+    }
+
+    //Move the events of every thread into the trace, state.Mutex has to be locked
+    static void CollectEvents(ProfilerState& state)
+    {
+        for(const std::unique_ptr<ThreadData>& thread : state.Threads)
+        {
+            std::lock_guard<std::mutex> lock(thread->ZoneMutex);
+            state.TraceEvents.insert(state.TraceEvents.end(), thread->Events.begin(), thread->Events.end());
+            thread->Events.clear();
+        }
+    }
+}
+
+namespace Profiler
+{
+    namespace Detail
+    {
+        thread_local ProfileCounters* t_Counters = nullptr;
+
+        ProfileCounters* RegisterThread()
+        {
+            //Once per thread, the lock is fine here
+            Utils::ProfilerState& state = Utils::GetProfilerState();
+            std::lock_guard<std::mutex> lock(state.Mutex);
+            state.Threads.push_back(std::make_unique<Utils::ThreadData>());
+            Utils::ThreadData* data = state.Threads.back().get();
+            data->Id = state.NextThreadId++;
+
+            Utils::t_ThreadData = data;
+            Utils::t_ThreadExit.Data = data;
+            t_Counters = &data->Counters;
+            return t_Counters;
+        }
+
+        double Now()
+        {
+            auto elapsed = std::chrono::steady_clock::now() - Utils::GetProfilerState().Epoch;
+            return std::chrono::duration<double, std::micro>(elapsed).count();
+        }
+
+        void EndZone(const char* name, double start)
+        {
+            double end = Now();
+            Utils::ThreadData& data = Utils::GetThreadData();
+            std::lock_guard<std::mutex> lock(data.ZoneMutex);
+
+            //Only a handful of different zones, compared by pointer - the same literal can have another address in
+            //another file, NextFrame merges those by name
+            ProfileZoneStats* zone = nullptr;
+            for(ProfileZoneStats& stats : data.Zones)
+            {
+                if(stats.Name == name)
+                {
+                    zone = &stats;
+                    break;
+                }
+            }
+            if(!zone)
+            {
+                data.Zones.push_back({ name, 0.0, 0 });
+                zone = &data.Zones.back();
+            }
+            zone->Milliseconds += (end - start) / 1000.0;
+            zone->Calls++;
+
+            if(Utils::GetProfilerState().Tracing.load(std::memory_order_relaxed))
+                data.Events.push_back({ name, start, end - start, data.Id });
+        }
+    }
+
+    void NextFrame()
+    {
+        Utils::ProfilerState& state = Utils::GetProfilerState();
+        std::lock_guard<std::mutex> lock(state.Mutex);
+
+        ProfileFrame frame;
+        for(const std::unique_ptr<Utils::ThreadData>& thread : state.Threads)
+        {
+            frame.Counters.Add(thread->Counters);
+            thread->Counters = {};
+
+            std::lock_guard<std::mutex> zoneLock(thread->ZoneMutex);
+            for(ProfileZoneStats& stats : thread->Zones)
+            {
+                if(stats.Calls == 0)
+                    continue;
+                auto zone = std::find_if(frame.Zones.begin(), frame.Zones.end(),
+                    [&](const ProfileZoneStats& other) { return strcmp(other.Name, stats.Name) == 0; });
+                if(zone == frame.Zones.end())
+                    zone = frame.Zones.insert(frame.Zones.end(), { stats.Name, 0.0, 0 });
+                zone->Milliseconds += stats.Milliseconds;
+                zone->Calls += stats.Calls;
+                //Entries stay, so a thread doesnt allocate again next frame
+                stats.Milliseconds = 0.0;
+                stats.Calls = 0;
+            }
+        }
+
+        if(state.Tracing)
+        {
+            Utils::CollectEvents(state);
+            state.TraceFrames.push_back({ Detail::Now(), frame.Counters });
+        }
+        else
+        {
+            for(const std::unique_ptr<Utils::ThreadData>& thread : state.Threads)
+            {
+                std::lock_guard<std::mutex> zoneLock(thread->ZoneMutex);
+                thread->Events.clear();
+            }
+        }
+
+        state.Threads.erase(std::remove_if(state.Threads.begin(), state.Threads.end(),
+            [](const std::unique_ptr<Utils::ThreadData>& thread) { return thread->Exited; }), state.Threads.end());
+        state.LastFrame = std::move(frame);
+    }
+
+    ProfileFrame GetLastFrame()
+    {
+        Utils::ProfilerState& state = Utils::GetProfilerState();
+        std::lock_guard<std::mutex> lock(state.Mutex);
+        return state.LastFrame;
+    }
+
+    void BeginTrace()
+    {
+        Utils::ProfilerState& state = Utils::GetProfilerState();
+        std::lock_guard<std::mutex> lock(state.Mutex);
+        state.TraceEvents.clear();
+        state.TraceFrames.clear();
+        state.Tracing = true;
+    }
+
+    bool EndTrace(const std::string& path)
+    {
+        Utils::ProfilerState& state = Utils::GetProfilerState();
+        std::lock_guard<std::mutex> lock(state.Mutex);
+        if(!state.Tracing)
+            return false;
+        state.Tracing = false;
+        Utils::CollectEvents(state);
+
+        FILE* file = fopen(path.c_str(), "w");
+        if(!file)
+            return false;
+
+        //Complete events ("X") per zone, counter events ("C") per frame - zone names are literals without quotes
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        for(const Utils::TraceEvent& event : state.TraceEvents)
+        {
+            fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"render\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}",
+                first ? "" : ",\n", event.Name, event.Start, event.Duration, event.Thread);
+            first = false;
+        }
+        for(const auto& [time, counters] : state.TraceFrames)
+        {
+            fprintf(file, "%s{\"name\":\"Rays\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":0,\"args\":{\"primary\":%llu,\"bounce\":%llu,\"shadow\":%llu}}",
+                first ? "" : ",\n", time, (unsigned long long)counters.PrimaryRays, (unsigned long long)counters.BounceRays,
+                (unsigned long long)counters.ShadowRays);
+            fprintf(file, ",\n{\"name\":\"Sphere tests\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":0,\"args\":{\"tests\":%llu}}",
+                time, (unsigned long long)counters.SphereTests);
+            first = false;
+        }
+        fprintf(file, "\n]}\n");
+
+        state.TraceEvents.clear();
+        state.TraceFrames.clear();
+        bool written = !ferror(file);
+        fclose(file);
+        return written;
+    }
+
+    bool IsTracing()
+    {
+        return Utils::GetProfilerState().Tracing;
+    }
+}
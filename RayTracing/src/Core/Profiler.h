@@ -0,0 +1,110 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+//Compile time switch for all instrumentation: with RT_PROFILE 0 the RT_PROFILE_ macros below expand to nothing,
+//so the render loop has no counters or timers at all (Dist builds turn it off)
+#ifndef RT_PROFILE
+    #define RT_PROFILE 1
+#endif
+
+//What the render loop did in a frame, summed over all threads
+struct ProfileCounters
+{
+    uint64_t PrimaryRays = 0;
+    uint64_t BounceRays = 0;
+    //Ray-sphere tests, a SIMD kernel or packet over n spheres counts n per ray
+    uint64_t SphereTests = 0;
+    uint64_t Hits = 0;
+    uint64_t Misses = 0;
+    //Occlusion rays towards lights (next event estimation), not part of any path
+    uint64_t ShadowRays = 0;
+
+    uint64_t GetRays() const { return PrimaryRays + BounceRays; }
+    //Every path starts with 1 primary ray, so this is rays per path
+    double GetAveragePathLength() const { return PrimaryRays > 0 ? (double)GetRays() / PrimaryRays : 0.0; }
+    void Add(const ProfileCounters& other)
+    {
+        PrimaryRays += other.PrimaryRays;
+        BounceRays += other.BounceRays;
+        SphereTests += other.SphereTests;
+        Hits += other.Hits;
+        Misses += other.Misses;
+        ShadowRays += other.ShadowRays;
+    }
+};
+
+//Time spent in all zones with the same name
+struct ProfileZoneStats
+{
+    const char* Name = nullptr;
+    //Summed over every thread, so zones that run on all threads at once can add up to more than the frame
+    double Milliseconds = 0.0;
+    uint32_t Calls = 0;
+};
+
+struct ProfileFrame
+{
+    ProfileCounters Counters;
+    //In the order they were first entered
+    std::vector<ProfileZoneStats> Zones;
+};
+
+//Low overhead instrumentation of the render loop: counters and timing zones are recorded per thread into thread local
+//data and summed once per frame by NextFrame - counters are plain integers, zones take their thread's own (uncontended)
+//lock so threads outside the render loop (the UI) can record them while a frame is collected
+//The zones can also be written to a Chrome trace (chrome://tracing or ui.perfetto.dev) to see every thread's timeline
+namespace Profiler
+{
+    namespace Detail
+    {
+        //Counters of the calling thread, null until the thread first records something
+        extern thread_local ProfileCounters* t_Counters;
+        ProfileCounters* RegisterThread();
+        double Now(); //Microseconds since the start of the program
+        void EndZone(const char* name, double start);
+    }
+
+    //Only the calling thread writes its counters, so a plain += is enough
+    inline ProfileCounters& GetThreadCounters()
+    {
+        ProfileCounters* counters = Detail::t_Counters;
+        return counters ? *counters : *Detail::RegisterThread();
+    }
+
+    //Times its scope, name has to stay alive (string literal)
+    class Zone
+    {
+    public:
+        explicit Zone(const char* name) : m_Name(name), m_Start(Detail::Now()) {}
+        ~Zone() { Detail::EndZone(m_Name, m_Start); }
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+    private:
+        const char* m_Name;
+        double m_Start;
+    };
+
+    //Collect what every thread recorded since the last call as the last frame
+    //Call after a frame, while no thread is counting (the render threads are idle)
+    void NextFrame();
+    //Copy, so any thread can read it while the next frame gets collected
+    ProfileFrame GetLastFrame();
+
+    //Record every zone (and the counters of every frame) from BeginTrace until EndTrace writes them as Chrome trace JSON
+    void BeginTrace();
+    bool EndTrace(const std::string& path);
+    bool IsTracing();
+}
+
+#if RT_PROFILE
+    #define RT_PROFILE_CONCAT_(a, b) a##b
+    #define RT_PROFILE_CONCAT(a, b) RT_PROFILE_CONCAT_(a, b)
+    #define RT_PROFILE_ZONE(name) Profiler::Zone RT_PROFILE_CONCAT(profileZone, __LINE__)(name)
+    #define RT_PROFILE_COUNT(counter, value) (Profiler::GetThreadCounters().counter += (value))
+#else
+    #define RT_PROFILE_ZONE(name)
+    //sizeof keeps variables that only feed counters "used" without evaluating anything
+    #define RT_PROFILE_COUNT(counter, value) ((void)sizeof(value))
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace Utils
+{
+    //Hash a 32 bit value into a well mixed 32 bit value (PCG output permutation)
+    inline uint32_t Hash(uint32_t input)
+    {
+        uint32_t state = input * 747796405u + 2891336453u;
+        uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (word >> 22u) ^ word;
+    }
+
+    //Small and fast random number generator (PCG32): 16 bytes of state, a multiply and a few shifts per number
+    //Not shared between threads or pixels: every path creates its own, seeded from its pixel and frame, so images are
+    //bit identical no matter how many threads render them or in what order
+    class Random
+    {
+    public:
+        Random() = default;
+        Random(uint32_t pixelIndex, uint32_t frameIndex)
+        {
+            //Different stream per pixel, seed mixes in the frame so every frame gets new samples
+            m_Increment = ((uint64_t)pixelIndex << 1u) | 1u;
+            UInt();
+            m_State += Hash(pixelIndex ^ Hash(frameIndex));
+            UInt();
+        }
+
+        uint32_t UInt()
+        {
+            uint64_t oldState = m_State;
+            m_State = oldState * 6364136223846793005ull + m_Increment;
+            uint32_t xorShifted = (uint32_t)(((oldState >> 18u) ^ oldState) >> 27u);
+            uint32_t rotation = (uint32_t)(oldState >> 59u);
+            return (xorShifted >> rotation) | (xorShifted << ((32u - rotation) & 31u));
+        }
+
+        //[0, 1) - top 24 bits so every value is exactly representable as a float
+        float Float()
+        {
+            return (float)(UInt() >> 8) * (1.0f / 16777216.0f);
+        }
+
+        glm::vec3 Vec3(float min, float max)
+        {
+            float x = Float(), y = Float(), z = Float();
+            return glm::vec3(x * (max - min) + min, y * (max - min) + min, z * (max - min) + min);
+        }
+
+    private:
+        uint64_t m_State = 0;
+        uint64_t m_Increment = 1;
+    };
+}
@@ -0,0 +1,124 @@
+#include "RayPacket.h"
+
+#include <cfloat>
+#include <algorithm>
+
+#if RT_X86
+    #include <emmintrin.h>
+#endif
+
+void RayPacket::Prepare()
+{
+    for (uint32_t i = Count; i < Size; i++)
+    {
+        DirectionX[i] = DirectionX[0];
+        DirectionY[i] = DirectionY[0];
+        DirectionZ[i] = DirectionZ[0];
+    }
+
+    glm::vec3 directionMin(FLT_MAX), directionMax(-FLT_MAX);
+    for (uint32_t i = 0; i < Size; i++)
+    {
+        A[i] = DirectionX[i] * DirectionX[i] + DirectionY[i] * DirectionY[i] + DirectionZ[i] * DirectionZ[i];
+        InverseA[i] = 1.0f / A[i];
+        HitDistance[i] = FLT_MAX;
+        ObjectIndex[i] = -1;
+
+        glm::vec3 direction(DirectionX[i], DirectionY[i], DirectionZ[i]);
+        directionMin = glm::min(directionMin, direction);
+        directionMax = glm::max(directionMax, direction);
+    }
+
+    //Interval culling only works when 1 / direction is bounded: no ray may be parallel to or on the other side of an axis
+    Coherent = true;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (directionMin[axis] > 0.0f || directionMax[axis] < 0.0f)
+        {
+            //1 / x is decreasing on each side of 0, so the bounds swap
+            InverseDirectionMin[axis] = 1.0f / directionMax[axis];
+            InverseDirectionMax[axis] = 1.0f / directionMin[axis];
+        }
+        else
+            Coherent = false;
+    }
+}
+
+float RayPacket::GetMaxHitDistance() const
+{
+    float maxDistance = HitDistance[0];
+    for (uint32_t i = 1; i < Count; i++)
+        maxDistance = std::max(maxDistance, HitDistance[i]);
+    return maxDistance;
+}
+
+namespace PacketTracing
+{
+    float IntersectBox(const RayPacket& packet, const glm::vec3& boxMin, const glm::vec3& boxMax, float maxDistance)
+    {
+        //Per axis: t = (plane - origin) * inverseDirection, the origin is shared so (plane - origin) is 1 number per plane
+        //and t over all rays is the product with the inverse direction interval
+        float entry = 0.0f, exit = maxDistance;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            bool positive = packet.InverseDirectionMin[axis] > 0.0f;
+            float nearPlane = (positive ? boxMin[axis] : boxMax[axis]) - packet.Origin[axis];
+            float farPlane = (positive ? boxMax[axis] : boxMin[axis]) - packet.Origin[axis];
+
+            //Smallest entry and largest exit any ray of the packet can have on this axis
+            float nearMin = std::min(nearPlane * packet.InverseDirectionMin[axis], nearPlane * packet.InverseDirectionMax[axis]);
+            float farMax = std::max(farPlane * packet.InverseDirectionMin[axis], farPlane * packet.InverseDirectionMax[axis]);
+            entry = std::max(entry, nearMin);
+            exit = std::min(exit, farMax);
+        }
+        return entry <= exit ? entry : FLT_MAX;
+    }
+
+    void IntersectSpheres(RayPacket& packet, const SphereSoA& spheres, uint32_t first, uint32_t count)
+    {
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            //Shared by every ray of the packet
+            float ocX = packet.Origin.x - spheres.X[i];
+            float ocY = packet.Origin.y - spheres.Y[i];
+            float ocZ = packet.Origin.z - spheres.Z[i];
+            float c = (ocX * ocX + ocY * ocY + ocZ * ocZ) - spheres.RadiusSquared[i];
+            int sphereIndex = (int)spheres.Indices[i];
+
+#if RT_X86
+            const __m128 vocX = _mm_set1_ps(ocX), vocY = _mm_set1_ps(ocY), vocZ = _mm_set1_ps(ocZ);
+            const __m128 vc = _mm_set1_ps(c);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128i vSphereIndex = _mm_set1_epi32(sphereIndex);
+            for (uint32_t r = 0; r < RayPacket::Size; r += 4)
+            {
+                __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vocX, _mm_load_ps(&packet.DirectionX[r])), _mm_mul_ps(vocY, _mm_load_ps(&packet.DirectionY[r]))),
+                    _mm_mul_ps(vocZ, _mm_load_ps(&packet.DirectionZ[r])));
+                __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(_mm_load_ps(&packet.A[r]), vc));
+                __m128 t = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(zero, b), _mm_sqrt_ps(discriminant)), _mm_load_ps(&packet.InverseA[r]));
+
+                __m128 hitDistance = _mm_load_ps(&packet.HitDistance[r]);
+                __m128 mask = _mm_and_ps(_mm_cmpge_ps(discriminant, zero), _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, hitDistance)));
+                _mm_store_ps(&packet.HitDistance[r], _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, hitDistance)));
+                __m128i objectIndex = _mm_load_si128((const __m128i*)&packet.ObjectIndex[r]);
+                __m128i indexMask = _mm_castps_si128(mask);
+                _mm_store_si128((__m128i*)&packet.ObjectIndex[r], _mm_or_si128(_mm_and_si128(indexMask, vSphereIndex), _mm_andnot_si128(indexMask, objectIndex)));
+            }
+#else
+            for (uint32_t r = 0; r < RayPacket::Size; r++)
+            {
+                float b = ocX * packet.DirectionX[r] + ocY * packet.DirectionY[r] + ocZ * packet.DirectionZ[r];
+                float discriminant = b * b - packet.A[r] * c;
+                if (discriminant < 0.0f)
+                    continue;
+                float t = (-b - glm::sqrt(discriminant)) * packet.InverseA[r];
+                if (t > 0.0f && t < packet.HitDistance[r])
+                {
+                    packet.HitDistance[r] = t;
+                    packet.ObjectIndex[r] = sphereIndex;
+                }
+            }
+#endif
+        }
+    }
+}
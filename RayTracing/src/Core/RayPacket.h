@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "SphereKernels.h"
+
+//Bundle of rays sharing 1 origin, e.g. the primary rays of a 4x4 block of pixels
+//Everything that only depends on the origin (origin - center, |origin - center|^2 - r^2) is computed once per sphere for
+//the whole packet instead of once per ray
+struct RayPacket
+{
+    static constexpr uint32_t Size = 16;
+
+    glm::vec3 Origin{ 0.0f };
+    //Directions in SoA layout so 4 rays fit in a SSE register
+    alignas(16) float DirectionX[Size];
+    alignas(16) float DirectionY[Size];
+    alignas(16) float DirectionZ[Size];
+    //dot(direction, direction) and its inverse per ray
+    alignas(16) float A[Size];
+    alignas(16) float InverseA[Size];
+
+    //Closest hit per ray, HitDistance stays FLT_MAX and ObjectIndex -1 on a miss
+    alignas(16) float HitDistance[Size];
+    alignas(16) int ObjectIndex[Size];
+
+    //Unused slots (packets at the image border) get a copy of ray 0
+    uint32_t Count = 0;
+
+    //Interval of 1 / direction over all rays per axis, only valid when Coherent
+    glm::vec3 InverseDirectionMin{ 0.0f }, InverseDirectionMax{ 0.0f };
+    //All rays point to the same side on every axis - needed for interval culling, otherwise trace rays 1 by 1
+    bool Coherent = false;
+
+    //Fill in A, InverseA, reset hits and compute the direction interval
+    void Prepare();
+    float GetMaxHitDistance() const;
+};
+
+namespace PacketTracing
+{
+    //Interval arithmetic slab test: can any ray of the packet hit the box closer than maxDistance?
+    //Returns a lower bound of the entry distance over all rays, FLT_MAX when the whole packet misses
+    float IntersectBox(const RayPacket& packet, const glm::vec3& boxMin, const glm::vec3& boxMax, float maxDistance);
+
+    //Closest hits of every ray against spheres [first, first + count) of the SoA
+    //Same math (and results) as SphereKernels, with the origin dependent terms shared by the whole packet
+    void IntersectSpheres(RayPacket& packet, const SphereSoA& spheres, uint32_t first, uint32_t count);
+}
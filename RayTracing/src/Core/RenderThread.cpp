@@ -0,0 +1,169 @@
+#include "RenderThread.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <cstring>
+#include <type_traits>
+
+RenderThread::RenderThread()
+{
+    //Nothing to render until the first SetCamera gives the image a size
+    m_Idle = true;
+    m_Thread = std::thread(&RenderThread::ThreadLoop, this);
+}
+
+RenderThread::~RenderThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+        m_Cancel = true;
+    }
+    m_WakeCondition.notify_one();
+    m_Thread.join();
+}
+
+void RenderThread::SetScene(const Scene& scene)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    //Usually nothing changed and this is 2 compares, dragging a sphere copies just that sphere
+    bool changed = m_PendingScene.Spheres.SyncFrom(scene.Spheres, m_PendingSphereGeneration);
+    changed |= m_PendingScene.Materials.SyncFrom(scene.Materials, m_PendingMaterialGeneration);
+    changed |= m_PendingScene.Lights.SyncFrom(scene.Lights, m_PendingLightGeneration);
+    if(m_PendingScene.Acceleration != scene.Acceleration)
+    {
+        m_PendingScene.Acceleration = scene.Acceleration;
+        changed = true;
+    }
+    if(changed)
+    {
+        m_SceneEdited = true;
+        Restart();
+    }
+}
+
+void RenderThread::SetCamera(const Camera& camera)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_PendingCamera = camera;
+    m_CameraMoved = true;
+    Restart();
+}
+
+void RenderThread::SetSettings(const Renderer::Settings& settings)
+{
+    //Only plain values, so comparing bytes is enough to see a change (at worst padding makes it wake up once too often)
+    static_assert(std::is_trivially_copyable<Renderer::Settings>::value, "Settings are compared with memcmp");
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if(memcmp(&m_PendingSettings, &settings, sizeof(settings)) == 0)
+        return;
+    m_PendingSettings = settings;
+    m_SettingsChanged = true;
+    m_Idle = false;
+    m_WakeCondition.notify_one();
+}
+
+void RenderThread::ResetFrameIndex()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_ResetRequested = true;
+    Restart();
+}
+
+void RenderThread::Restart()
+{
+    //The frame in flight is for the old state, stop it instead of waiting for it
+    m_Changed = true;
+    m_Idle = false;
+    m_Cancel = true;
+    m_WakeCondition.notify_one();
+}
+
+bool RenderThread::AcquireFrame()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if(!m_NewFrame)
+        return false;
+    std::swap(m_PresentIndex, m_ReadyIndex);
+    m_NewFrame = false;
+    return true;
+}
+
+void RenderThread::ThreadLoop()
+{
+    while(true)
+    {
+        //Take over whatever the UI changed since the last frame
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_WakeCondition.wait(lock, [this] { return m_Stop || !m_Idle; });
+            if(m_Stop)
+                return;
+
+            m_Renderer.GetSettings() = m_PendingSettings;
+            m_SettingsChanged = false;
+            if(m_Changed)
+            {
+                //Copied the same way the pending scene was, so the renderer still only refits edited spheres
+                m_Scene.Spheres.SyncFrom(m_PendingScene.Spheres, m_SphereGeneration);
+                m_Scene.Materials.SyncFrom(m_PendingScene.Materials, m_MaterialGeneration);
+                m_Scene.Lights.SyncFrom(m_PendingScene.Lights, m_LightGeneration);
+                m_Scene.Acceleration = m_PendingScene.Acceleration;
+                m_Camera = m_PendingCamera;
+                //Only the camera moved: pixels that still see the same surface keep their samples
+                //Only the scene changed: pixels that never touched the edited spheres keep their samples
+                if(m_ResetRequested || (m_CameraMoved && m_SceneEdited))
+                    m_Renderer.ResetFrameIndex();
+                else if(m_CameraMoved)
+                    m_Renderer.OnCameraMoved();
+                else
+                    m_Renderer.OnSceneEdited();
+                m_Changed = false;
+                m_CameraMoved = m_SceneEdited = m_ResetRequested = false;
+            }
+            m_Cancel = false;
+
+            if(m_Camera.GetViewportWidth() == 0 || m_Camera.GetViewportHeight() == 0)
+            {
+                m_Idle = true;
+                continue;
+            }
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        m_Renderer.OnResize(m_Camera.GetViewportWidth(), m_Camera.GetViewportHeight());
+        m_Renderer.Render(m_Scene, m_Camera, &m_Cancel);
+        auto end = std::chrono::high_resolution_clock::now();
+        Profiler::NextFrame();
+        m_Dirty = TileScheduler::Unite(m_Dirty, m_Renderer.GetDirtyRegion());
+
+        //Half done frame of a state that is already gone, the next one restarts
+        if(m_Renderer.WasCancelled())
+            continue;
+
+        Frame& frame = m_Frames[m_RenderIndex];
+        frame.Width = m_Renderer.GetWidth();
+        frame.Height = m_Renderer.GetHeight();
+        frame.ImageData.assign(m_Renderer.GetImageData(), m_Renderer.GetImageData() + (size_t)frame.Width * frame.Height);
+        frame.Dirty = m_Dirty;
+        m_Dirty = Tile();
+        frame.RenderTime = std::chrono::duration<float, std::milli>(end - start).count();
+        frame.PreviewScale = m_Renderer.GetPreviewScale();
+        frame.Samples = m_Renderer.GetSamplesLastFrame();
+        frame.Rays = m_Renderer.GetRaysLastFrame();
+        frame.Converged = m_Renderer.IsConverged();
+        frame.Budget = m_Renderer.GetBudgetLevel();
+        frame.ReprojectedShare = m_Renderer.GetReprojectedShare();
+        frame.ResetShare = m_Renderer.GetResetShare();
+        frame.Number = m_FrameNumber++;
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        //The ready frame nobody acquired gets replaced, what changed in it has to be uploaded with this one
+        if(m_NewFrame)
+            frame.Dirty = TileScheduler::Unite(frame.Dirty, m_Frames[m_ReadyIndex].Dirty);
+        std::swap(m_RenderIndex, m_ReadyIndex);
+        m_NewFrame = true;
+        //Converged adaptive renders stop here until something changes
+        m_Idle = frame.Converged && m_Renderer.GetSettings().Accumulate && !m_Changed && !m_SettingsChanged;
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include "Renderer.h"
+
+//Runs a Renderer on its own thread, so a slow frame never holds up the UI
+//The UI hands in its scene, camera and settings whenever it likes - the thread renders from its own copies of them and
+//keeps accumulating frames, every finished frame is published through a triple buffer: the thread always has a
+//buffer to render into and the UI a buffer to present, neither ever waits for the other
+//Camera moves and scene edits cancel the frame in flight, camera moves reproject accumulation (Renderer::OnCameraMoved)
+//and scene edits reset the pixels they touch (Renderer::OnSceneEdited)
+class RenderThread
+{
+public:
+    //A finished frame and what the renderer reported about it
+    struct Frame
+    {
+        std::vector<uint32_t> ImageData; //RGBA8 like Renderer::GetImageData
+        uint32_t Width = 0, Height = 0;
+        //Pixels that changed since the frame acquired before this one (see Renderer::GetDirtyRegion), Width 0 when none
+        //did - presenting only has to upload these
+        Tile Dirty;
+        float RenderTime = 0.0f; //ms
+        uint32_t PreviewScale = 1;
+        uint64_t Samples = 0;
+        uint64_t Rays = 0;
+        bool Converged = false;
+        FrameBudget::Level Budget;
+        float ReprojectedShare = 0.0f; //Of the last camera move
+        float ResetShare = 0.0f; //Of the last scene edit
+        //Frames finished before this one
+        uint64_t Number = 0;
+    };
+
+    RenderThread();
+    ~RenderThread();
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    //Copy the spheres/materials/lights that changed since the last call (see SceneArray::SyncFrom), resets the pixels
+    //they touch when anything did
+    void SetScene(const Scene& scene);
+    //Render from this camera from now on, its viewport size is the image size - reprojects accumulation
+    void SetCamera(const Camera& camera);
+    //Picked up at the start of the next frame, does not restart accumulation (same as changing them on a Renderer)
+    void SetSettings(const Renderer::Settings& settings);
+    void ResetFrameIndex();
+
+    //Swap in the newest finished frame, false when none finished since the last call
+    bool AcquireFrame();
+    //Frame to present, stays the same until the next AcquireFrame
+    const Frame& GetFrame() const { return m_Frames[m_PresentIndex]; }
+private:
+    void ThreadLoop();
+    void Restart(); //m_Mutex has to be locked
+private:
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    std::condition_variable m_WakeCondition;
+    bool m_Stop = false;
+
+    //Latest state from the UI, guarded by m_Mutex
+    Scene m_PendingScene;
+    uint64_t m_PendingSphereGeneration = 0, m_PendingMaterialGeneration = 0, m_PendingLightGeneration = 0;
+    Camera m_PendingCamera{ 45.0f, 0.1f, 100.0f };
+    Renderer::Settings m_PendingSettings;
+    //Something changed that needs a restart, next frame has to pick up scene/camera
+    bool m_Changed = false;
+    //What the change was: both at once or an explicit reset restart accumulation
+    bool m_CameraMoved = false;
+    bool m_SceneEdited = false;
+    bool m_ResetRequested = false;
+    bool m_SettingsChanged = false;
+    //Converged frames are not rendered again until something changes
+    bool m_Idle = false;
+    //Set by the UI to stop the frame in flight
+    std::atomic<bool> m_Cancel{ false };
+
+    //Owned by the render thread
+    Renderer m_Renderer;
+    Scene m_Scene;
+    uint64_t m_SphereGeneration = 0, m_MaterialGeneration = 0, m_LightGeneration = 0;
+    Camera m_Camera{ 45.0f, 0.1f, 100.0f };
+    uint64_t m_FrameNumber = 0;
+    //Pixels the renderer changed since the last published frame, cancelled frames change pixels too
+    Tile m_Dirty;
+
+    //Triple buffer: the thread renders into m_RenderIndex, m_ReadyIndex is the newest finished frame (guarded by
+    //m_Mutex), the UI presents m_PresentIndex
+    Frame m_Frames[3];
+    uint32_t m_RenderIndex = 0, m_ReadyIndex = 1, m_PresentIndex = 2;
+    bool m_NewFrame = false;
+};
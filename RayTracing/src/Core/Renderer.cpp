@@ -0,0 +1,1061 @@
+﻿#include "Renderer.h"
+#include "Profiler.h"
+#include <cstring>
+#include <cfloat>
+#include <algorithm>
+#include <glm/gtc/constants.hpp>
+
+#include "Random.h"
+namespace Utils
+{
+    static float Luminance(const glm::vec4& color)
+    {
+        return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+    }
+
+    //Scenes without any lights or emissive spheres still get the light every scene had before lights existed:
+    //coming from right, top and front, bright enough that a white surface facing it is white
+    static const Light DefaultLight = { LightType::Directional, glm::vec3(0.0f), glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(1.0f),
+        glm::pi<float>() };
+}
+void Renderer::OnResize(uint32_t width, uint32_t height)
+{
+    //Exit function when no resize is needed so delete doesnt get called
+    if(m_ImageData && m_Width == width && m_Height == height)
+        return;
+
+    //The renderer only owns the cpu side buffers, whoever presents the result (Walnut::Image in the app, a file
+    //in headless mode) resizes its own image
+    m_Width = width;
+    m_Height = height;
+
+    //Delete current image data if exists - its ok to call delete on nullptr(first render) - delete will check for u
+    delete[] m_ImageData;
+    //Reallocate for new data
+    //uint32 is 32 bits -> RGBA 1 byte for each color = 32bits
+    m_ImageData = new uint32_t[width * height];
+
+    delete[] m_AccumulationData;
+    m_AccumulationData = new glm::vec4[width * height];
+
+    //Per pixel statistics for adaptive sampling
+    m_SampleCounts.assign(width * height, 0);
+    m_LuminanceSquaredData.assign(width * height, 0.0f);
+    //Allocated by the next frame that denoises
+    m_AlbedoData.clear();
+    m_NormalDepthData.clear();
+    m_PixelObjects.clear();
+    //Pixels of the old size dont map to the new ones
+    m_HasHistoryCamera = false;
+
+    //Tiles depend on the image size
+    m_Tiles.clear();
+}
+
+void Renderer::Render(const Scene& scene, const Camera& camera, const std::atomic<bool>* cancel)
+{
+    RT_PROFILE_ZONE("Render");
+    auto frameStart = std::chrono::steady_clock::now();
+    m_ActiveScene = &scene;
+    m_ActiveCamera = &camera;
+    m_Cancel = cancel;
+    m_Cancelled = false;
+    m_DirtyRegion = Tile();
+    m_Resolve = ImageResolve::Get(m_Settings.SIMD);
+    m_KernelOptions = GetKernelOptions();
+
+    UpdateAccelerationStructure(scene);
+    //Whether edited spheres were emitters before the edit
+    if(m_EditPending)
+        m_PreviousEmissiveSpheres = m_EmissiveSpheres;
+    UpdateEmitters(scene);
+
+    //Camera moved since the last frame: keep what still fits the new view, start over when too little does
+    if(m_ReprojectPending)
+    {
+        m_ReprojectPending = false;
+        if(!ReprojectAccumulation())
+            ResetFrameIndex();
+    }
+
+    //Scene edited since the last frame: reset what the edits touched, everything when that cant be told
+    if(m_EditPending)
+    {
+        m_EditPending = false;
+        if(!ResetEditedPixels(scene))
+            ResetFrameIndex();
+    }
+    m_EditScene = &scene;
+    m_EditMaterialGeneration = scene.Materials.GetGeneration();
+    m_EditLightGeneration = scene.Lights.GetGeneration();
+
+    m_FrameCounter++;
+
+    //Frame time budget: samples, bounces and resolution as picked after the last frame
+    if(m_Settings.FrameTimeBudget)
+        m_BudgetLevel = m_FrameBudget.GetLevel(GetBudgetSettings());
+    else
+        m_BudgetLevel = { 1, m_Settings.MaxBounces, 1 };
+    //Tiles get the kernel compiled for this frame's options and bounces
+    m_TileKernel = GetTileKernel(m_KernelOptions, m_BudgetLevel.Bounces);
+
+    //Camera just moved: coarse preview frames first, each one twice the resolution of the last
+    //The accumulation buffer is left alone, frame index stays at 1 until full resolution rendering starts
+    //Over budget even at 1 sample per pixel: preview frames at the budget's resolution until it allows more again
+    uint32_t previewScale = glm::max(m_PreviewScale, m_BudgetLevel.Scale);
+    m_LastPreviewScale = previewScale;
+    if(previewScale > 1)
+    {
+        RenderPreview(previewScale);
+        m_DirtyRegion = { 0, 0, m_Width, m_Height, 0 };
+        m_ImageEncoding = m_Settings.OutputEncoding;
+        m_PreviewScale = glm::max(m_PreviewScale / 2, 1u);
+        UpdateFrameBudget(frameStart);
+        return;
+    }
+
+    //First hit features for the denoiser and reprojection, their own sample count in w lets them be turned on in the
+    //middle of accumulating
+    m_RecordFeatures = m_Settings.Denoise || m_Settings.TemporalReprojection;
+    if(m_RecordFeatures && m_AlbedoData.empty())
+    {
+        m_AlbedoData.assign((size_t)m_Width * m_Height, glm::vec4(0.0f));
+        m_NormalDepthData.assign((size_t)m_Width * m_Height, glm::vec4(0.0f));
+    }
+
+    //The samples of this frame are taken from this camera, the next camera move reprojects them from here
+    m_HistoryViewProjection = camera.GetProjection() * camera.GetView();
+    m_HistoryCameraPosition = camera.GetPosition();
+    m_HasHistoryCamera = true;
+
+    //Objects touched per pixel for selective reset, samples taken before it was turned on could have touched anything
+    m_RecordObjects = m_Settings.SelectiveReset && m_Settings.Accumulate;
+    if(!m_RecordObjects)
+        m_PixelObjects.clear();
+    else if(m_PixelObjects.empty())
+        m_PixelObjects.assign((size_t)m_Width * m_Height, ~0ull);
+
+    //Reset accumulation buffer with all 0s if on first frame 
+    //Row by row, only the rows of the region get rendered (the whole image unless SetRegion was called)
+    Tile region = GetRenderRegion();
+    if(m_FrameIndex == 1)
+    {
+        for(uint32_t y = region.Y; y < region.Y + region.Height; y++)
+        {
+            size_t first = region.X + (size_t)y * m_Width;
+            memset(m_AccumulationData + first, 0, region.Width * sizeof(glm::vec4));
+            std::fill_n(m_SampleCounts.begin() + first, region.Width, 0);
+            std::fill_n(m_LuminanceSquaredData.begin() + first, region.Width, 0.0f);
+            if(!m_AlbedoData.empty())
+            {
+                std::fill_n(m_AlbedoData.begin() + first, region.Width, glm::vec4(0.0f));
+                std::fill_n(m_NormalDepthData.begin() + first, region.Width, glm::vec4(0.0f));
+            }
+            if(!m_PixelObjects.empty())
+                std::fill_n(m_PixelObjects.begin() + first, region.Width, 0);
+        }
+    }
+    
+    //const glm::vec3& rayOrigin = camera.GetPosition();
+
+    //Multi thread since pixels are not dependant on other pixels, so no reason to do 1 after the other
+    //The image is split in tiles: a thread renders a block of pixels at a time, so its reads and writes of the accumulation
+    //and image buffers stay close together, and threads that run out of tiles steal from the busy ones
+    m_Scheduler.SetThreadCount(m_Settings.ThreadCount);
+
+    //Multiple of 4 so packets never cross a tile border
+    uint32_t tileSize = glm::max(4u, (m_Settings.TileSize + 3) / 4 * 4);
+    if(m_Tiles.empty() || tileSize != m_TileSize || m_Settings.TileOrdering != m_TileOrder)
+    {
+        m_TileSize = tileSize;
+        m_TileOrder = m_Settings.TileOrdering;
+        m_Tiles = TileScheduler::CreateTiles(m_Width, m_Height, m_TileSize, m_TileOrder);
+        //Tiles cut to the region, still on the same grid so their samples dont depend on the region
+        if(region.Width != m_Width || region.Height != m_Height)
+        {
+            std::vector<Tile> tiles;
+            for(const Tile& tile : m_Tiles)
+            {
+                uint32_t x0 = glm::max(tile.X, region.X), x1 = glm::min(tile.X + tile.Width, region.X + region.Width);
+                uint32_t y0 = glm::max(tile.Y, region.Y), y1 = glm::min(tile.Y + tile.Height, region.Y + region.Height);
+                if(x0 >= x1 || y0 >= y1)
+                    continue;
+                tiles.push_back({ x0, y0, x1 - x0, y1 - y0, (uint32_t)tiles.size() });
+            }
+            m_Tiles = std::move(tiles);
+        }
+        m_TileErrors.assign(m_Tiles.size(), FLT_MAX);
+    }
+    //Tile errors are only estimated while adaptive sampling is on, switching it on starts from unknown errors
+    if(!m_Settings.Adaptive)
+        std::fill(m_TileErrors.begin(), m_TileErrors.end(), FLT_MAX);
+
+    PlanAdaptiveSamples();
+
+    //Rays get counted per tile into a slot per thread, summed once the frame is done
+    m_ThreadRayCounts.assign(m_Scheduler.GetThreadCount(), 0);
+    m_ThreadTileSeconds.assign(m_Scheduler.GetThreadCount(), 0.0);
+    auto traceStart = std::chrono::steady_clock::now();
+    if(m_Settings.Wavefront)
+    {
+        RenderWavefront();
+        //No tiles to time: every stage keeps all threads busy
+        m_ThreadTileSeconds.assign(m_Scheduler.GetThreadCount(), std::chrono::duration<double>(std::chrono::steady_clock::now() - traceStart).count());
+    }
+    else
+    {
+        //Ray generation and tracing happen per pixel here, only the wavefront engine has them as separate stages
+        //Each tile is resolved into the image right after its samples, while its accumulation is still in cache
+        RT_PROFILE_ZONE("Trace");
+        m_Scheduler.Run(m_Tiles, [this](const Tile& tile, uint32_t threadIndex)
+        {
+            //Tiles not started yet are skipped, their pixels just dont get this frame's sample
+            if(IsCancelled())
+                return;
+            RT_PROFILE_ZONE("Tile");
+            auto tileStart = std::chrono::steady_clock::now();
+            //Adaptive sampling: converged tiles get no samples, noisy ones several
+            uint64_t rays = 0;
+            for(uint32_t sample = 0; sample < m_TileSamples[tile.Index]; sample++)
+                rays += (this->*m_TileKernel)(tile);
+            if(m_TileSamples[tile.Index] > 0)
+            {
+                if(m_Settings.Adaptive)
+                    m_TileErrors[tile.Index] = EstimateTileError(tile);
+                //The denoiser rewrites the whole image anyway
+                if(!m_Settings.Denoise)
+                    ResolveTile(tile);
+            }
+            m_ThreadRayCounts[threadIndex] += rays;
+            m_ThreadTileSeconds[threadIndex] += std::chrono::duration<double>(std::chrono::steady_clock::now() - tileStart).count();
+        });
+    }
+    m_TraceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - traceStart).count();
+    m_RaysThisFrame = 0;
+    for(uint64_t rays : m_ThreadRayCounts)
+        m_RaysThisFrame += rays;
+
+    //Only tiles that got samples changed, converged ones keep their pixels and dont need uploading again - unless
+    //they are still in another encoding
+    if(!m_Settings.Denoise)
+    {
+        if(m_ImageEncoding != m_Settings.OutputEncoding)
+        {
+            m_Scheduler.Run(m_Tiles, [this](const Tile& tile, uint32_t threadIndex)
+            {
+                if(m_TileSamples[tile.Index] == 0)
+                    ResolveTile(tile);
+            });
+            m_DirtyRegion = GetRenderRegion();
+        }
+        for(const Tile& tile : m_Tiles)
+            if(m_TileSamples[tile.Index] > 0)
+                m_DirtyRegion = TileScheduler::Unite(m_DirtyRegion, tile);
+    }
+    m_ImageEncoding = m_Settings.OutputEncoding;
+
+    //Half a frame is still a valid accumulation, but cancelled frames are thrown away anyway
+    if(m_Settings.Denoise && !WasCancelled())
+    {
+        DenoiseImage();
+        m_DirtyRegion = { 0, 0, m_Width, m_Height, 0 };
+    }
+    UpdateFrameBudget(frameStart);
+    
+    if(m_Settings.Accumulate)
+        m_FrameIndex++;
+    else
+        m_FrameIndex = 1;
+}
+
+void Renderer::RestoreAccumulation(uint32_t frameIndex, uint32_t frameCounter, const glm::vec4* accumulation, const uint32_t* sampleCounts,
+    const float* luminanceSquared)
+{
+    size_t pixels = (size_t)m_Width * m_Height;
+    memcpy(m_AccumulationData, accumulation, pixels * sizeof(glm::vec4));
+    std::copy(sampleCounts, sampleCounts + pixels, m_SampleCounts.begin());
+    std::copy(luminanceSquared, luminanceSquared + pixels, m_LuminanceSquaredData.begin());
+    m_FrameIndex = frameIndex;
+    m_FrameCounter = frameCounter;
+    //Features arent part of the restored state, the denoiser averages whatever gets recorded from here on
+    if(!m_AlbedoData.empty())
+    {
+        std::fill(m_AlbedoData.begin(), m_AlbedoData.end(), glm::vec4(0.0f));
+        std::fill(m_NormalDepthData.begin(), m_NormalDepthData.end(), glm::vec4(0.0f));
+    }
+    //Camera of the restored samples is unknown, and so are the objects they touched
+    m_HasHistoryCamera = false;
+    std::fill(m_PixelObjects.begin(), m_PixelObjects.end(), ~0ull);
+
+    //Straight back to full resolution accumulation, new tiles start without error estimates
+    m_PreviewScale = 1;
+    m_Tiles.clear();
+
+    //Same as ResolveTile leaves it
+    ImageResolve::Get(m_Settings.SIMD)(m_AccumulationData, m_SampleCounts.data(), (uint32_t)pixels, m_Settings.OutputEncoding, m_ImageData);
+    m_DirtyRegion = { 0, 0, m_Width, m_Height, 0 };
+    m_ImageEncoding = m_Settings.OutputEncoding;
+}
+
+void Renderer::SetRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    if(m_Region.X == x && m_Region.Y == y && m_Region.Width == width && m_Region.Height == height)
+        return;
+    m_Region = { x, y, width, height, 0 };
+    //Tiles depend on the region
+    m_Tiles.clear();
+}
+
+Tile Renderer::GetRenderRegion() const
+{
+    Tile region = { 0, 0, m_Width, m_Height, 0 };
+    if(m_Region.Width == 0 || m_Region.Height == 0)
+        return region;
+    //Packets trace 4x4 pixels from a multiple of 4 up to the image border, so the region cant cut through one
+    region.X = glm::min(m_Region.X / 4 * 4, m_Width);
+    region.Y = glm::min(m_Region.Y / 4 * 4, m_Height);
+    region.Width = glm::min((m_Region.X + m_Region.Width + 3) / 4 * 4, m_Width) - region.X;
+    region.Height = glm::min((m_Region.Y + m_Region.Height + 3) / 4 * 4, m_Height) - region.Y;
+    return region;
+}
+
+bool Renderer::IsCancelled()
+{
+    if(m_Cancel && m_Cancel->load(std::memory_order_relaxed))
+        m_Cancelled.store(true, std::memory_order_relaxed);
+    return m_Cancelled.load(std::memory_order_relaxed);
+}
+
+void Renderer::UpdateAccelerationStructure(const Scene& scene)
+{
+    RT_PROFILE_ZONE("Acceleration structure");
+    //Spheres can be edited from the UI at any time, the scene logs which ones so only those get updated
+    //Anything the log cant tell (other scene, spheres added or removed) rebuilds from scratch
+    bool incremental = m_MirroredSpheres == &scene.Spheres && m_Spheres.Count == scene.Spheres.size() &&
+        scene.Spheres.GetChangesSince(m_SphereGeneration, m_SphereChanges);
+    m_MirroredSpheres = &scene.Spheres;
+    m_SphereGeneration = scene.Spheres.GetGeneration();
+    m_SphereEdits.clear();
+    m_SphereEditsKnown = incremental;
+    if (!incremental)
+    {
+        m_Spheres.Build(scene.Spheres);
+        m_BVH.Clear();
+    }
+    else if (!m_SphereChanges.empty())
+    {
+        for (const SceneRange& range : m_SphereChanges)
+            for (size_t i = range.First; i < range.First + range.Count; i++)
+            {
+                //Where it was, for selective reset
+                m_SphereEdits.push_back({ (uint32_t)i, glm::vec3(m_Spheres.X[i], m_Spheres.Y[i], m_Spheres.Z[i]), glm::sqrt(m_Spheres.RadiusSquared[i]) });
+                m_Spheres.Set((uint32_t)i, scene.Spheres[i], (uint32_t)i);
+            }
+
+        //Moving a sphere only grows/shrinks the boxes above it, until the tree got too loose
+        if (!m_BVH.IsEmpty() && !m_BVH.Refit(scene.Spheres, m_SphereChanges, m_Settings.BVHRebuildThreshold))
+            m_BVH.Clear();
+    }
+
+    //Built lazily so rendering without the BVH doesnt pay for builds
+    //Scene files can bring their own BVH, good for as long as the spheres are the ones from the file
+    if (m_Settings.UseBVH && m_BVH.IsEmpty() && !scene.Spheres.empty())
+    {
+        if (scene.Acceleration && scene.Spheres.IsView())
+            m_BVH = *scene.Acceleration;
+        else
+            m_BVH.Build(scene.Spheres);
+    }
+
+    m_SphereKernel = SphereKernels::Get(m_Settings.SIMD);
+    m_OccludedKernel = SphereKernels::GetOccluded(m_Settings.SIMD);
+}
+
+void Renderer::UpdateEmitters(const Scene& scene)
+{
+    //Emission is a material property, so both arrays decide which spheres are lights
+    if (m_EmitterScene == &scene && m_EmitterSphereGeneration == scene.Spheres.GetGeneration() &&
+        m_EmitterMaterialGeneration == scene.Materials.GetGeneration())
+        return;
+    m_EmitterScene = &scene;
+    m_EmitterSphereGeneration = scene.Spheres.GetGeneration();
+    m_EmitterMaterialGeneration = scene.Materials.GetGeneration();
+
+    m_EmissiveSpheres.clear();
+    for (size_t i = 0; i < scene.Spheres.size(); i++)
+    {
+        int materialIndex = scene.Spheres[i].MaterialIndex;
+        if (materialIndex >= 0 && (size_t)materialIndex < scene.Materials.size() && scene.Materials[materialIndex].IsEmissive())
+            m_EmissiveSpheres.push_back((uint32_t)i);
+    }
+}
+
+template<uint32_t Options>
+uint32_t Renderer::GetSampleSeed(uint32_t pixelIndex) const
+{
+    //Accumulating: samples are numbered per pixel, so rendering n samples from a reset gives the same image every time
+    //Not accumulating: keep counting frames so the noise changes from frame to frame
+    return HasOption<Options>(KernelAccumulate) ? m_SampleCounts[pixelIndex] + 1 : m_FrameCounter;
+}
+
+void Renderer::RenderPreview(uint32_t scale)
+{
+    //1 ray through the center of every scale x scale block of pixels, the block gets filled with its color (nearest upscale)
+    //Tiles are made in low resolution pixels so 2 threads never write the same block
+    uint32_t width = (m_Width + scale - 1) / scale;
+    uint32_t height = (m_Height + scale - 1) / scale;
+    std::vector<Tile> tiles = TileScheduler::CreateTiles(width, height, glm::max(4u, m_Settings.TileSize), m_Settings.TileOrdering);
+
+    RT_PROFILE_ZONE("Preview");
+    m_Scheduler.SetThreadCount(m_Settings.ThreadCount);
+    m_ThreadRayCounts.assign(m_Scheduler.GetThreadCount(), 0);
+    m_ThreadTileSeconds.assign(m_Scheduler.GetThreadCount(), 0.0);
+    auto traceStart = std::chrono::steady_clock::now();
+    m_Scheduler.Run(tiles, [this, scale, width](const Tile& tile, uint32_t threadIndex)
+    {
+        if(IsCancelled())
+            return;
+        auto tileStart = std::chrono::steady_clock::now();
+        uint32_t rays = 0;
+        for(uint32_t y = tile.Y; y < tile.Y + tile.Height; y++)
+        {
+            for(uint32_t x = tile.X; x < tile.X + tile.Width; x++)
+            {
+                uint32_t pixelX = x * scale, pixelY = y * scale;
+                uint32_t blockWidth = glm::min(scale, m_Width - pixelX), blockHeight = glm::min(scale, m_Height - pixelY);
+
+                Ray ray;
+                ray.Origin = m_ActiveCamera->GetPosition();
+                ray.Direction = m_ActiveCamera->GetRayDirection(pixelX + blockWidth * 0.5f, pixelY + blockHeight * 0.5f);
+                Utils::Random random(x + y * width, m_FrameCounter);
+                glm::vec4 color = PerPixel(ray, random, rays);
+
+                uint32_t rgba = ImageResolve::ResolvePixel(color, m_Settings.OutputEncoding);
+                for(uint32_t by = pixelY; by < pixelY + blockHeight; by++)
+                    std::fill_n(m_ImageData + pixelX + by * m_Width, blockWidth, rgba);
+            }
+        }
+        m_ThreadRayCounts[threadIndex] += rays;
+        m_ThreadTileSeconds[threadIndex] += std::chrono::duration<double>(std::chrono::steady_clock::now() - tileStart).count();
+    });
+    m_TraceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - traceStart).count();
+
+    //Not part of the accumulated image, but still work done
+    m_SamplesThisFrame = (uint64_t)width * height;
+    m_RaysThisFrame = 0;
+    for(uint64_t threadRays : m_ThreadRayCounts)
+        m_RaysThisFrame += threadRays;
+}
+
+template<uint32_t Options, uint32_t Bounces>
+uint64_t Renderer::RenderTile(const Tile& tile)
+{
+    uint64_t rays = 0;
+    if(m_Settings.PacketTracing)
+    {
+        //Neighbouring pixels have nearly the same primary ray, trace them 4x4 at a time
+        for(uint32_t y = tile.Y; y < tile.Y + tile.Height; y += 4)
+            for(uint32_t x = tile.X; x < tile.X + tile.Width; x += 4)
+                rays += RenderPacket<Options, Bounces>(x, y);
+        return rays;
+    }
+
+    //Iterate through y first = better performance - next uint32 is horizontal
+    for(uint32_t y = tile.Y; y < tile.Y + tile.Height; y++)
+    {
+        for(uint32_t x = tile.X; x < tile.X + tile.Width; x++)
+        {
+            //Random numbers only depend on the pixel and sample, not on which thread renders it
+            Utils::Random random(x + y * m_Width, GetSampleSeed<Options>(x + y * m_Width));
+            uint32_t pathRays = 0;
+            PixelFeatures features;
+            PixelFeatures* recordFeatures = m_RecordFeatures ? &features : nullptr;
+            uint64_t objects = 0;
+            glm::vec4 color = PerPixel<Options, Bounces>(GeneratePrimaryRay(x, y, random), random, pathRays, nullptr, recordFeatures, m_RecordObjects ? &objects : nullptr);
+            AccumulatePixel(x, y, color, recordFeatures, objects);
+            rays += pathRays;
+        }
+    }
+    return rays;
+}
+
+Ray Renderer::GeneratePrimaryRay(uint32_t x, uint32_t y, Utils::Random& random) const
+{
+    Ray ray;
+    ray.Origin = m_ActiveCamera->GetPosition();
+
+    if(m_Settings.CachedRayDirections && !m_ActiveCamera->GetRayDirections().empty())
+    {
+        ray.Direction = m_ActiveCamera->GetRayDirections()[x + y * m_Width];
+        return ray;
+    }
+
+    //Jitter: pick a random point inside the pixel every frame, accumulating frames then averages the whole pixel = anti aliasing
+    //Without it we shoot through the corner of the pixel, same as the cached directions
+    glm::vec2 offset(0.0f);
+    if(m_Settings.Jitter)
+    {
+        offset.x = random.Float();
+        offset.y = random.Float();
+    }
+    ray.Direction = m_ActiveCamera->GetRayDirection((float)x + offset.x, (float)y + offset.y);
+    return ray;
+}
+
+FrameBudget::Settings Renderer::GetBudgetSettings() const
+{
+    FrameBudget::Settings settings;
+    settings.TargetMilliseconds = m_Settings.TargetFrameTime;
+    settings.MaxSamples = m_Settings.BudgetMaxSamples;
+    settings.MinBounces = m_Settings.BudgetMinBounces;
+    settings.MaxBounces = m_Settings.MaxBounces;
+    settings.MaxScale = m_Settings.PreviewScale;
+    return settings;
+}
+
+void Renderer::UpdateFrameBudget(std::chrono::steady_clock::time_point frameStart)
+{
+    //Half a frame says nothing about what a whole one costs
+    if(!m_Settings.FrameTimeBudget || WasCancelled())
+        return;
+
+    Tile region = GetRenderRegion();
+    FrameBudget::Measurement measurement;
+    measurement.FrameSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+    measurement.TraceSeconds = m_TraceSeconds;
+    for(double seconds : m_ThreadTileSeconds)
+        measurement.TileSeconds += seconds;
+    measurement.Rays = m_RaysThisFrame;
+    measurement.Samples = m_SamplesThisFrame;
+    measurement.Pixels = (uint64_t)region.Width * region.Height;
+    measurement.Bounces = m_BudgetLevel.Bounces;
+    m_FrameBudget.Update(GetBudgetSettings(), measurement);
+}
+
+void Renderer::PlanAdaptiveSamples()
+{
+    //Default: 1 new sample for every pixel, as many as fit when there is a frame time budget
+    uint32_t samples = m_BudgetLevel.Samples;
+    m_TileSamples.assign(m_Tiles.size(), samples);
+    Tile region = GetRenderRegion();
+    m_SamplesThisFrame = (uint64_t)region.Width * region.Height * samples;
+
+    //Need a few samples everywhere before the variance estimates mean anything
+    if(!m_Settings.Adaptive || !m_Settings.Accumulate || m_FrameIndex <= m_Settings.AdaptiveMinSamples)
+        return;
+
+    //Tiles below the error threshold are done, the rest share the samples in proportion to their error
+    double weightSum = 0.0;
+    for(size_t i = 0; i < m_Tiles.size(); i++)
+    {
+        if(m_TileErrors[i] < m_Settings.AdaptiveThreshold)
+            m_TileSamples[i] = 0;
+        else
+            weightSum += (double)m_TileErrors[i] * m_Tiles[i].Width * m_Tiles[i].Height;
+    }
+
+    m_SamplesThisFrame = 0;
+    double budget = (double)region.Width * region.Height * samples;
+    for(size_t i = 0; i < m_Tiles.size(); i++)
+    {
+        if(m_TileSamples[i] == 0)
+            continue;
+        double samplesPerPixel = budget * m_TileErrors[i] / weightSum;
+        m_TileSamples[i] = std::clamp((uint32_t)(samplesPerPixel + 0.5), 1u, glm::max(m_Settings.AdaptiveMaxSamples, samples));
+        m_SamplesThisFrame += (uint64_t)m_TileSamples[i] * m_Tiles[i].Width * m_Tiles[i].Height;
+    }
+}
+
+float Renderer::EstimateTileError(const Tile& tile) const
+{
+    //Relative standard error of the mean luminance per pixel, root mean square over the tile
+    //Dark pixels are compared against a minimum brightness so a bit of noise in black areas doesnt count as huge
+    double errorSum = 0.0;
+    for(uint32_t y = tile.Y; y < tile.Y + tile.Height; y++)
+    {
+        for(uint32_t x = tile.X; x < tile.X + tile.Width; x++)
+        {
+            uint32_t i = x + y * m_Width;
+            uint32_t n = m_SampleCounts[i];
+            if(n < 2)
+                return FLT_MAX;
+
+            float mean = Utils::Luminance(m_AccumulationData[i]) / (float)n;
+            float variance = glm::max(0.0f, (m_LuminanceSquaredData[i] - (float)n * mean * mean) / (float)(n - 1));
+            float relativeError = glm::sqrt(variance / (float)n) / glm::max(mean, 0.05f);
+            errorSum += relativeError * relativeError;
+        }
+    }
+    return (float)glm::sqrt(errorSum / (double)(tile.Width * tile.Height));
+}
+
+void Renderer::AccumulatePixel(uint32_t x, uint32_t y, const glm::vec4& color, const PixelFeatures* features, uint64_t objects)
+{
+    uint32_t i = x + y * m_Width;
+    m_AccumulationData[i] += color;
+    float luminance = Utils::Luminance(color);
+    m_LuminanceSquaredData[i] += luminance * luminance;
+    m_SampleCounts[i]++;
+    if(features)
+    {
+        m_AlbedoData[i] += glm::vec4(features->Albedo, 1.0f);
+        m_NormalDepthData[i] += glm::vec4(features->Normal, features->Depth);
+    }
+    if(!m_PixelObjects.empty())
+        m_PixelObjects[i] |= objects;
+}
+
+void Renderer::ResolveTile(const Tile& tile)
+{
+    //Every pixel has its own sample count, adaptive sampling gives some pixels more samples than others
+    for(uint32_t y = tile.Y; y < tile.Y + tile.Height; y++)
+    {
+        size_t first = tile.X + (size_t)y * m_Width;
+        m_Resolve(m_AccumulationData + first, m_SampleCounts.data() + first, tile.Width, m_Settings.OutputEncoding, m_ImageData + first);
+    }
+}
+
+template<uint32_t Options, uint32_t Bounces>
+uint32_t Renderer::RenderPacket(uint32_t x, uint32_t y)
+{
+    //All primary rays start at the camera, only the directions differ
+    RayPacket packet;
+    packet.Origin = m_ActiveCamera->GetPosition();
+    uint32_t pixelX[RayPacket::Size], pixelY[RayPacket::Size];
+    Utils::Random randoms[RayPacket::Size];
+    for(uint32_t py = y; py < glm::min(y + 4, m_Height); py++)
+    {
+        for(uint32_t px = x; px < glm::min(x + 4, m_Width); px++)
+        {
+            //Same random numbers as when the pixel is traced by itself, so packets dont change the image
+            Utils::Random& random = randoms[packet.Count];
+            random = Utils::Random(px + py * m_Width, GetSampleSeed<Options>(px + py * m_Width));
+            glm::vec3 direction = GeneratePrimaryRay(px, py, random).Direction;
+            packet.DirectionX[packet.Count] = direction.x;
+            packet.DirectionY[packet.Count] = direction.y;
+            packet.DirectionZ[packet.Count] = direction.z;
+            pixelX[packet.Count] = px;
+            pixelY[packet.Count] = py;
+            packet.Count++;
+        }
+    }
+    packet.Prepare();
+    uint32_t rays = 0;
+
+    //Packets crossing an axis cant be culled as a whole, those fall back to single rays
+    if(packet.Coherent)
+    {
+        if(HasOption<Options>(KernelBVH))
+            m_BVH.IntersectPacket(packet);
+        else
+        {
+            PacketTracing::IntersectSpheres(packet, m_Spheres, 0, m_Spheres.Count);
+            RT_PROFILE_COUNT(SphereTests, (uint64_t)m_Spheres.Count * packet.Count);
+        }
+    }
+
+    for(uint32_t i = 0; i < packet.Count; i++)
+    {
+        Ray ray;
+        ray.Origin = packet.Origin;
+        ray.Direction = glm::vec3(packet.DirectionX[i], packet.DirectionY[i], packet.DirectionZ[i]);
+
+        HitPayload primaryHit;
+        if(!packet.Coherent)
+            primaryHit = TraceRay<Options>(ray);
+        else if(packet.ObjectIndex[i] < 0)
+            primaryHit = Miss(ray);
+        else
+            primaryHit = ClosestHit(ray, packet.HitDistance[i], packet.ObjectIndex[i]);
+
+        PixelFeatures features;
+        PixelFeatures* recordFeatures = m_RecordFeatures ? &features : nullptr;
+        uint64_t objects = 0;
+        glm::vec4 color = PerPixel<Options, Bounces>(ray, randoms[i], rays, &primaryHit, recordFeatures, m_RecordObjects ? &objects : nullptr);
+        AccumulatePixel(pixelX[i], pixelY[i], color, recordFeatures, objects);
+    }
+    return rays;
+}
+
+template<uint32_t Options, uint32_t Bounces>
+glm::vec4 Renderer::PerPixel(Ray ray, Utils::Random& random, uint32_t& rayCount, const HitPayload* primaryHit, PixelFeatures* features,
+    uint64_t* objects)
+{
+    glm::vec3 color(0.0f);
+    float multiplier = 1.0f;
+    uint32_t pathRays = 0;
+    bool missed = false;
+    
+    for(uint32_t i = 0; i < GetMaxBounces<Bounces>(); i++)
+    {
+        //Primary hit might already be traced as part of a packet
+        HitPayload payload = (i == 0 && primaryHit) ? *primaryHit : TraceRay<Options>(ray);
+        pathRays++;
+        if(i == 0 && features)
+            *features = GetPixelFeatures(payload);
+
+        if(!Shade<Options, Bounces>(ray, payload, i, random, color, multiplier, objects))
+        {
+            missed = payload.HitDistance < 0.0f;
+            break;
+        }
+    }
+    rayCount += pathRays;
+
+    //Counted once per path instead of per ray, only the last ray of a path can miss
+#if RT_PROFILE
+    ProfileCounters& counters = Profiler::GetThreadCounters();
+    counters.PrimaryRays++;
+    counters.BounceRays += pathRays - 1;
+    counters.Hits += pathRays - missed;
+    counters.Misses += missed;
+#endif
+
+    return {color, 1.0f};
+    //glm::vec4(sphereColor, 1.0f);
+}
+
+Renderer::PixelFeatures Renderer::GetPixelFeatures(const HitPayload& payload) const
+{
+    //Sky: its color (same as Shade) as albedo, no normal and depth 0 - nothing like any surface, so its edges stay sharp
+    if(payload.HitDistance < 0.0f)
+        return { glm::vec3(0.6f, 0.7f, 0.9f), glm::vec3(0.0f), 0.0f };
+
+    const Sphere& sphere = m_ActiveScene->Spheres[payload.ObjectIndex];
+    return { m_ActiveScene->Materials[sphere.MaterialIndex].Albedo, payload.WorldNormal, payload.HitDistance };
+}
+
+void Renderer::DenoiseImage()
+{
+    RT_PROFILE_ZONE("Denoise");
+    Denoiser::Settings settings;
+    settings.Iterations = m_Settings.DenoiseIterations;
+    settings.LuminanceSigma = m_Settings.DenoiseStrength;
+    settings.SIMD = m_Settings.SIMD;
+    m_DenoisedData.resize((size_t)m_Width * m_Height);
+    m_Denoiser.Denoise(settings, m_AccumulationData, m_SampleCounts.data(), m_LuminanceSquaredData.data(), m_AlbedoData.data(),
+        m_NormalDepthData.data(), m_Width, m_Height, m_Scheduler, m_DenoisedData.data());
+
+    //Denoised colors are averages already, no sample counts to divide by
+    m_Scheduler.ParallelFor(m_Height, 16, [this](uint32_t begin, uint32_t end, uint32_t threadIndex)
+    {
+        size_t first = (size_t)begin * m_Width;
+        m_Resolve(m_DenoisedData.data() + first, nullptr, (end - begin) * m_Width, m_Settings.OutputEncoding, m_ImageData + first);
+    });
+}
+
+template<uint32_t Options, uint32_t Bounces>
+bool Renderer::Shade(Ray& ray, const HitPayload& payload, uint32_t bounce, Utils::Random& random, glm::vec3& color, float& multiplier,
+    uint64_t* objects) const
+{
+    if (payload.HitDistance < 0.0f)
+    {
+        glm::vec3 skyColor = glm::vec3(0.6f,0.7f, 0.9f);
+        color += skyColor * multiplier;
+        return false;
+    }
+
+    //Selective reset: what the path sees directly or in its first bounce (and what shadows its first hit) changes
+    //when those spheres are edited - what later bounces add is too little to reset a pixel for
+    if (objects && bounce <= 1)
+        *objects |= GetObjectBit(payload.ObjectIndex);
+
+    const Sphere& sphere = m_ActiveScene->Spheres[payload.ObjectIndex];
+    const Material& material = m_ActiveScene->Materials[sphere.MaterialIndex];
+
+    //Light the surface gives off itself - with next event estimation only when the camera sees it: every bounce
+    //before already sampled the emitters directly, counting a hit on them as well would add their light twice
+    if (bounce == 0 || !HasOption<Options>(KernelNextEventEstimation))
+        color += material.GetEmission() * multiplier;
+
+    //Diffuse surface: it reflects albedo / pi of the irradiance arriving at it in every direction
+    if (HasOption<Options>(KernelNextEventEstimation))
+        color += material.Albedo * glm::one_over_pi<float>() * SampleDirectLight<Options>(payload, random, bounce == 0 ? objects : nullptr) * multiplier;
+    multiplier *= 0.5f;
+
+    //Russian roulette: the next bounce adds at most multiplier * albedo, so a path whose throughput dropped that low
+    //only goes on with that chance - and then counts for 1 / chance, which keeps the average where it was
+    //Not before RouletteStartBounce (the first bounces carry most of the light), and pointless on the last one
+    if(HasOption<Options>(KernelRussianRoulette) && bounce + 1 >= m_Settings.RouletteStartBounce && bounce + 1 < GetMaxBounces<Bounces>())
+    {
+        float survival = glm::clamp(multiplier * glm::max(material.Albedo.r, glm::max(material.Albedo.g, material.Albedo.b)), 0.05f, 1.0f);
+        if(random.Float() >= survival)
+            return false;
+        multiplier /= survival;
+    }
+
+    ray.Origin = payload.WorldPosition + payload.WorldNormal * 0.0001f; //move little bit forward so next ray doesnt collide with previous sphere
+    //reflect new ray perfectly around world normal of sphere - this is not how it works in real world:
+    //every material has different microfacet (roughness) that scatters light in different ways
+    //So we randomly reflect the light in a defined cone (degree of this cone is defined by the roughness)
+    //This will create noise in the image - every frame will have different random ray directions with different results
+    //Path tracing will help clear up this noise:
+    //Every frame a random direction gets picked, thus creating the random noise from frame to frame
+    //Currently we send 1 ray, hit something, send 1 ray, ... for 5 bounces. We only send 1 ray. == 1 path of a ray
+    //We need to send out lots of these paths so we can evaluate and accumulate them all and average out the result
+    //This way we slowly converge to a result similar to millions of rays hitting you
+    //When camera is still it will accumulate paths, when moving it will not
+    ray.Direction =  glm::reflect(ray.Direction, payload.WorldNormal + material.Roughness * random.Vec3(-0.5f, 0.5f));
+    return true;
+}
+
+template<uint32_t Options>
+glm::vec3 Renderer::SampleDirectLight(const HitPayload& payload, Utils::Random& random, uint64_t* occluders) const
+{
+    //Shadow rays start a little bit above the surface, like the next bounce, so they dont hit the sphere they start on
+    glm::vec3 origin = payload.WorldPosition + payload.WorldNormal * 0.0001f;
+    glm::vec3 irradiance(0.0f);
+    uint32_t shadowRays = 0;
+
+    size_t lightCount;
+    const Light* lights = GetLights(lightCount);
+    for (size_t i = 0; i < lightCount; i++)
+    {
+        const Light& light = lights[i];
+        glm::vec3 direction;
+        float distance = FLT_MAX;
+        float falloff = 1.0f;
+        if (light.Type == LightType::Directional)
+            direction = -glm::normalize(light.Direction); //Towards the light, against the way it travels
+        else
+        {
+            glm::vec3 toLight = light.Position - origin;
+            float distanceSquared = glm::dot(toLight, toLight);
+            distance = glm::sqrt(distanceSquared);
+            direction = toLight / distance;
+            falloff = 1.0f / distanceSquared;
+        }
+
+        //The dot product of 2 directions tells how much they look like each other: 1 the same, -1 opposite
+        //How much the surface faces the light = how much of its light it catches, facing away (negative) catches none
+        float cosine = glm::dot(payload.WorldNormal, direction);
+        if (cosine <= 0.0f)
+            continue;
+        shadowRays++;
+        int occluder = FindOccluder<Options>({ origin, direction }, distance);
+        if (occluder >= 0)
+        {
+            if (occluders)
+                *occluders |= GetObjectBit(occluder);
+            continue;
+        }
+        irradiance += light.Color * (light.Intensity * falloff * cosine);
+    }
+
+    //Emissive spheres: 1 picked at random, which counts for all of them (divided by the chance of the pick)
+    //A direction towards it is picked uniformly in the cone it covers as seen from here, which is 1 / solid angle likely
+    if (!m_EmissiveSpheres.empty())
+    {
+        uint32_t pick = random.UInt() % (uint32_t)m_EmissiveSpheres.size();
+        uint32_t sphereIndex = m_EmissiveSpheres[pick];
+        const Sphere& sphere = m_ActiveScene->Spheres[sphereIndex];
+        glm::vec3 toCenter = sphere.Position - origin;
+        float distanceSquared = glm::dot(toCenter, toCenter);
+        float radiusSquared = sphere.Radius * sphere.Radius;
+        //Not on the emitter itself (its light leaves it, it doesnt light itself)
+        if ((int)sphereIndex != payload.ObjectIndex && distanceSquared > radiusSquared)
+        {
+            //1 - cos of the cone's half angle, written so it doesnt cancel out for small or far away spheres
+            float sinSquared = radiusSquared / distanceSquared;
+            float cosMax = glm::sqrt(1.0f - sinSquared);
+            float oneMinusCosMax = sinSquared / (1.0f + cosMax);
+            float cosTheta = 1.0f - random.Float() * oneMinusCosMax;
+            float sinTheta = glm::sqrt(glm::max(1.0f - cosTheta * cosTheta, 0.0f));
+            float phi = 2.0f * glm::pi<float>() * random.Float();
+
+            //Basis around the direction to the center (Duff et al. 2017, no branches and no normalizing)
+            glm::vec3 w = toCenter / glm::sqrt(distanceSquared);
+            float sign = w.z >= 0.0f ? 1.0f : -1.0f;
+            float a = -1.0f / (sign + w.z);
+            float b = w.x * w.y * a;
+            glm::vec3 u(1.0f + sign * w.x * w.x * a, sign * b, -sign * w.x);
+            glm::vec3 v(b, sign + w.y * w.y * a, -w.y);
+            glm::vec3 direction = u * (glm::cos(phi) * sinTheta) + v * (glm::sin(phi) * sinTheta) + w * cosTheta;
+
+            float cosine = glm::dot(payload.WorldNormal, direction);
+            if (cosine > 0.0f)
+            {
+                //Distance to the emitter's near side along the direction, the shadow ray stops just before it
+                float halfB = glm::dot(direction, toCenter);
+                float distance = halfB - glm::sqrt(glm::max(halfB * halfB - distanceSquared + radiusSquared, 0.0f));
+                shadowRays++;
+                int occluder = FindOccluder<Options>({ origin, direction }, distance * 0.999f);
+                if (occluder < 0)
+                {
+                    const Material& material = m_ActiveScene->Materials[sphere.MaterialIndex];
+                    float solidAngle = 2.0f * glm::pi<float>() * oneMinusCosMax;
+                    irradiance += material.GetEmission() * (cosine * solidAngle * (float)m_EmissiveSpheres.size());
+                }
+                else if (occluders)
+                    *occluders |= GetObjectBit(occluder);
+            }
+        }
+    }
+
+    RT_PROFILE_COUNT(ShadowRays, shadowRays);
+    return irradiance;
+}
+
+const Light* Renderer::GetLights(size_t& count) const
+{
+    if (m_ActiveScene->Lights.empty() && m_EmissiveSpheres.empty())
+    {
+        count = 1;
+        return &Utils::DefaultLight;
+    }
+    count = m_ActiveScene->Lights.size();
+    return m_ActiveScene->Lights.data();
+}
+
+Renderer::HitPayload Renderer::ClosestHit(const Ray& ray, float hitDistance, int objectIndex)
+{
+    HitPayload payload;
+    payload.HitDistance = hitDistance;
+    payload.ObjectIndex = objectIndex;
+    
+    const Sphere& closestSphere = m_ActiveScene->Spheres[objectIndex];
+    //Recalculate origin for closest sphere
+    glm::vec3 origin = ray.Origin - closestSphere.Position;
+    
+    //t = hit distance -> plug in original ray equation to find point -> a + bt 
+    //No need to do every coord by itself -> glm takes care of it
+    //glm::vec3 h0 = rayOrigin + rayDirection * t0;
+    payload.WorldPosition = origin + ray.Direction * hitDistance;
+    //Can use hitpoint as color -> is a vec3. Basically take every coordinate of the hit points and use that as color
+    // x = r, y = g and z = b
+    //Negative on x and y will get clamped to 0 so we get blue in middle and bottom left
+    //More red going right x++
+    //More green going up y++
+
+    //We need to get direction sphere is facing in to correctly light it/shade it
+    //Need to know for every pixel where it is facing --> Get the normal for every pixel
+    //To get normal for every pixel in a sphere is easy -> subtract origin from the hit points
+    //Our current origin for our sphere = 0 -> hit point = normal
+    //Need to normalize to only get a direction vector not the whole radius (if radius is big, we dont want that)
+    //Just need the direction, length doesnt matter for the normal
+    payload.WorldNormal = glm::normalize(payload.WorldPosition);
+
+    //Add back the sphere position to get correct world position
+    payload.WorldPosition += closestSphere.Position;
+    
+    return payload;   
+}
+
+Renderer::HitPayload Renderer::Miss(const Ray& ray)
+{
+    HitPayload payload;
+    payload.HitDistance = -1.0f;
+    return payload;
+}
+
+//glm::vec4 Renderer::PerPixel(glm::vec2 coord)
+template<uint32_t Options>
+Renderer::HitPayload Renderer::TraceRay(const Ray& ray)
+{
+    
+    //Convert coord in to color channel: x = red, y = green
+    //8bits per color channel: rgba
+    //uint8_t r = (uint8_t) (coord.x * 255.0f);
+    //uint8_t g = (uint8_t) (coord.y * 255.0f);
+
+    //Fn of circle and the quadratic formula -> see SphereKernels
+
+    //Dont need these anymore(rayOrigin and direction) because we have everything in ray object
+    //Set forward axis of our camera shooting rays to -1
+    //so it has a z dimension else rays would get casted in 2d space and wont hit anything -> -1 or 1 depends on
+    //right or left handed rule
+    //glm::vec3 rayDirection = {coord.x, coord.y, -1.0f};
+    //rayDirection = glm::normalize(rayDirection);
+
+    //Origin of rays - move camera back along z so it is not inside our circle
+    //glm::vec3 rayOrigin(0.0f, 0.0f, 1.0f);
+
+    //Radius of our sphere - we get radius from sphere itself now
+    //float radius = 0.5f;
+    
+    int closestSphere = -1;
+    float hitDistance = FLT_MAX; //Keep closest so far
+    IntersectScene<Options>(ray, hitDistance, closestSphere);
+
+      //if sphere is still nullptr after going through scene, then we didnt hit a single sphere so return with default color  
+     if(closestSphere < 0)
+         return Miss(ray);
+
+    return ClosestHit(ray, hitDistance, closestSphere);
+}
+
+template<uint32_t Options>
+void Renderer::IntersectScene(const Ray& ray, float& hitDistance, int& objectIndex) const
+{
+    //Acceleration structure: only test the spheres whose bounding boxes the ray passes through
+    //Either way the spheres get tested 4/8 at a time by the SIMD kernel
+    if (HasOption<Options>(KernelBVH))
+        m_BVH.Intersect(ray, m_SphereKernel, hitDistance, objectIndex);
+    else
+    {
+        m_SphereKernel(m_Spheres, 0, m_Spheres.Count, ray, hitDistance, objectIndex);
+        RT_PROFILE_COUNT(SphereTests, m_Spheres.Count);
+    }
+}
+
+template<uint32_t Options>
+int Renderer::FindOccluder(const Ray& ray, float maxDistance) const
+{
+    if (HasOption<Options>(KernelBVH))
+        return m_BVH.Occluded(ray, m_OccludedKernel, maxDistance);
+    RT_PROFILE_COUNT(SphereTests, m_Spheres.Count);
+    return m_OccludedKernel(m_Spheres, 0, m_Spheres.Count, ray, maxDistance);
+}
+
+uint32_t Renderer::GetKernelOptions() const
+{
+    uint32_t options = 0;
+    if(m_Settings.UseBVH)
+        options |= KernelBVH;
+    if(m_Settings.NextEventEstimation)
+        options |= KernelNextEventEstimation;
+    if(m_Settings.RussianRoulette)
+        options |= KernelRussianRoulette;
+    if(m_Settings.Accumulate)
+        options |= KernelAccumulate;
+    return options;
+}
+
+Renderer::TileKernel Renderer::GetTileKernel(uint32_t options, uint32_t bounces)
+{
+#if RT_RENDER_KERNELS >= 2
+    return GetTileKernel<MaxKernelBounces>(options, bounces);
+#elif RT_RENDER_KERNELS == 1
+    return GetTileKernel<0>(options, bounces);
+#else
+    return &Renderer::RenderTile<KernelDynamic, 0>;
+#endif
+}
+
+template<uint32_t Bounces>
+Renderer::TileKernel Renderer::GetTileKernel(uint32_t options, uint32_t bounces)
+{
+    //Counts down from MaxKernelBounces to the limit asked for, limits without kernels of their own end up at 0 (read
+    //every frame)
+    if constexpr(Bounces > 0)
+    {
+        if(bounces != Bounces)
+            return GetTileKernel<Bounces - 1>(options, bounces);
+    }
+    return GetTileKernel<Bounces>(options, std::make_integer_sequence<uint32_t, 1u << KernelOptionCount>());
+}
+
+template<uint32_t Bounces, uint32_t... Options>
+Renderer::TileKernel Renderer::GetTileKernel(uint32_t options, std::integer_sequence<uint32_t, Options...>)
+{
+    //Every combination of options, indexed by the options themselves
+    static constexpr TileKernel kernels[] = { &Renderer::RenderTile<Options, Bounces>... };
+    return kernels[options & ((1u << KernelOptionCount) - 1)];
+}
+
+//What the rest of the renderer (previews, wavefront, reprojection) calls, with the options of the frame
+template uint32_t Renderer::GetSampleSeed<Renderer::KernelDynamic>(uint32_t pixelIndex) const;
+template bool Renderer::Shade<Renderer::KernelDynamic, 0>(Ray& ray, const HitPayload& payload, uint32_t bounce, Utils::Random& random,
+    glm::vec3& color, float& multiplier, uint64_t* objects) const;
+template Renderer::HitPayload Renderer::TraceRay<Renderer::KernelDynamic>(const Ray& ray);
+template void Renderer::IntersectScene<Renderer::KernelDynamic>(const Ray& ray, float& hitDistance, int& objectIndex) const;
@@ -0,0 +1,379 @@
+﻿#pragma once 
+#include <vector>
+#include <atomic>
+#include <glm/glm.hpp>
+#include "Ray.h"
+#include "Camera.h"
+#include "Scene.h"
+#include "BVH.h"
+#include "TileScheduler.h"
+#include "Random.h"
+#include "PathQueue.h"
+#include "Denoiser.h"
+#include "FrameBudget.h"
+#include "ImageResolve.h"
+#include <chrono>
+#include <utility>
+
+//Compile time switch for the specialised render kernels (see Renderer::GetTileKernel), set by premake's --render-kernels:
+//0 (dynamic) = only the kernel that reads every option from the settings, 1 (options) = 1 kernel per combination of
+//options, 2 (full) = those again for every fixed bounce limit up to Renderer::MaxKernelBounces - the most code
+#ifndef RT_RENDER_KERNELS
+    #define RT_RENDER_KERNELS 2
+#endif
+
+class Renderer
+{
+public:
+    struct Settings
+    {
+        bool Accumulate = true;
+        //Trace rays through a bounding volume hierarchy instead of testing every sphere
+        bool UseBVH = true;
+        //Widest sphere intersection kernel to use, clamped to what the cpu supports
+        SIMDLevel SIMD = SphereKernels::GetSupportedLevel();
+        //Trace primary rays in 4x4 packets, bounces are traced 1 by 1
+        bool PacketTracing = false;
+        //Pixels are rendered in square tiles of TileSize (rounded up to a multiple of 4) handed out to the threads in TileOrdering
+        uint32_t TileSize = 32;
+        TileOrder TileOrdering = TileOrder::Hilbert;
+        //Render threads, 0 = 1 per core
+        uint32_t ThreadCount = 0;
+        //Use the camera's width * height ray direction buffer instead of computing primary rays on the fly
+        //Only works when the camera caches them (Camera::SetRayDirectionCaching)
+        bool CachedRayDirections = false;
+        //Random sub-pixel position for primary rays: anti aliasing when accumulating, only for on the fly ray generation
+        bool Jitter = true;
+        //Adaptive sampling: once every pixel has AdaptiveMinSamples, tiles whose relative error drops below
+        //AdaptiveThreshold stop getting samples and the others get up to AdaptiveMaxSamples per frame
+        bool Adaptive = false;
+        float AdaptiveThreshold = 0.02f;
+        uint32_t AdaptiveMinSamples = 16;
+        uint32_t AdaptiveMaxSamples = 8;
+        //Progressive preview: after ResetFrameIndex (the camera moved) render at 1/PreviewScale resolution and halve
+        //the scale every frame until full resolution accumulation starts again, keeps moving the camera responsive
+        bool ProgressivePreview = true;
+        uint32_t PreviewScale = 8;
+        //Wavefront engine: instead of 1 pixel's whole path at a time, run every stage (generate, intersect, shade, compact)
+        //for WavefrontSize paths at once - same image as the per pixel path tracer
+        bool Wavefront = false;
+        uint32_t WavefrontSize = 1 << 18;
+        //Edited spheres refit the BVH, it gets rebuilt once its SAH cost grew past this factor
+        float BVHRebuildThreshold = 1.5f;
+        //Denoiser: record first hit albedo, normal and depth of every sample and filter the accumulated image with them
+        //(see Denoiser) before it is converted to RGBA8 - the accumulation buffer keeps the raw samples
+        //DenoiseStrength: how different in luminance (in standard deviations of a pixel's noise) pixels can be and still
+        //get blurred together
+        bool Denoise = false;
+        uint32_t DenoiseIterations = 5;
+        float DenoiseStrength = 1.0f;
+        //Longest path, in rays (primary ray included)
+        uint32_t MaxBounces = 5;
+        //Russian roulette: from bounce RouletteStartBounce on, paths carrying little light get ended at random - the ones
+        //that go on get their throughput divided by the chance they had, so on average the image is the same
+        bool RussianRoulette = true;
+        uint32_t RouletteStartBounce = 2;
+        //Next event estimation: at every bounce, sample the scene's lights directly with a shadow ray each instead of
+        //waiting for a path to run into them - off, only emissive spheres and the sky light the scene
+        bool NextEventEstimation = true;
+        //Frame time budget: pick samples per pixel (up to BudgetMaxSamples), bounces (down to BudgetMinBounces) and
+        //resolution (down to 1/PreviewScale) every frame so frames take about TargetFrameTime ms, see FrameBudget
+        bool FrameTimeBudget = false;
+        float TargetFrameTime = 16.0f;
+        uint32_t BudgetMaxSamples = 16;
+        uint32_t BudgetMinBounces = 2;
+        //Temporal reprojection: when the camera moves (OnCameraMoved), pixels that still see the same surface keep the
+        //samples accumulated from the old view instead of starting over - needs the first hit depth and normal of every
+        //sample, recorded like the denoiser's features. Kept history is cut down to ReprojectionMaxSamples, so what
+        //looks different from the new view (reflections) catches up
+        //Off by default: renders that never move the camera (headless, benchmark, workers) dont pay for the features
+        bool TemporalReprojection = false;
+        uint32_t ReprojectionMaxSamples = 64;
+        //Selective reset: scene edits (OnSceneEdited) only reset the pixels whose samples touched an edited sphere (or
+        //a sphere whose material was edited) with their first 2 hits or the shadow rays of the first, plus the pixels
+        //the edited spheres cover on screen before and after - the rest of the image keeps converging
+        //Lights and emitters light everything, editing those still resets the whole image
+        //Off by default: it records a sphere mask per sample, which only pays off where the scene gets edited (the app)
+        bool SelectiveReset = false;
+        //How GetImageData's RGBA8 pixels are encoded: Linear (value * 255, what the renderer always did) or the
+        //sRGB curve displays and PNG files expect - the accumulation buffer and EXR files stay linear either way
+        ImageResolve::Encoding OutputEncoding = ImageResolve::Encoding::Linear;
+    };
+    
+    Renderer() = default;
+    void OnResize(uint32_t width, uint32_t height);
+    //cancel: checked between tiles/waves, once it is set the rest of the frame is skipped (see WasCancelled)
+    void Render(const Scene& scene, const Camera& camera, const std::atomic<bool>* cancel = nullptr);
+    //Last Render call stopped early, its image is only partly updated
+    bool WasCancelled() const { return m_Cancelled; }
+    //Presenter agnostic output: RGBA8 pixels (abgr in memory) - the app uploads these to a Walnut::Image,
+    //the headless renderer writes them to a file
+    const uint32_t* GetImageData() const { return m_ImageData; }
+    //Pixels of GetImageData the last Render call changed: the tiles that got samples, the whole image after previews,
+    //denoising and RestoreAccumulation - Width 0 when nothing changed (every tile converged)
+    const Tile& GetDirtyRegion() const { return m_DirtyRegion; }
+    //Summed (not averaged) radiance of all samples so far - divide by GetSampleCounts() per pixel for the HDR result
+    const glm::vec4* GetAccumulationData() const { return m_AccumulationData; }
+    const uint32_t* GetSampleCounts() const { return m_SampleCounts.data(); }
+    uint32_t GetWidth() const { return m_Width; }
+    uint32_t GetHeight() const { return m_Height; }
+    //Samples traced by the last Render call, less than 1 per pixel once adaptive sampling skips converged tiles
+    uint64_t GetSamplesLastFrame() const { return m_SamplesThisFrame; }
+    //Adaptive sampling decided every tile is below the error threshold
+    bool IsConverged() const { return m_SamplesThisFrame == 0; }
+    //Rays traced by the last Render call (primary and bounce rays), for rays/s
+    uint64_t GetRaysLastFrame() const { return m_RaysThisFrame; }
+    //Rays per sample of the last Render call, what Russian roulette and MaxBounces save
+    double GetAveragePathLength() const { return m_SamplesThisFrame > 0 ? (double)m_RaysThisFrame / m_SamplesThisFrame : 0.0; }
+    void ResetFrameIndex()
+    {
+        m_FrameIndex = 1;
+        m_ReprojectPending = false;
+        m_EditPending = false;
+        m_PreviewScale = m_Settings.ProgressivePreview ? glm::max(m_Settings.PreviewScale, 1u) : 1;
+    }
+    //Camera moved: with TemporalReprojection the next frame keeps every pixel's samples that still fit its new view
+    //(falls back to ResetFrameIndex when too few do), the same as ResetFrameIndex otherwise
+    void OnCameraMoved();
+    //Share of the pixels that kept their samples in the last reprojection
+    float GetReprojectedShare() const { return m_ReprojectedShare; }
+    //Scene edited (not the camera): with SelectiveReset the next frame resets only the pixels the edits touch,
+    //the same as ResetFrameIndex otherwise
+    void OnSceneEdited();
+    //Share of the pixels reset by the last selective reset
+    float GetResetShare() const { return m_ResetShare; }
+    //Accumulation state for checkpoints: the random numbers of a sample are seeded from its pixel's sample count (and the
+    //frame counter when not accumulating), so these buffers and counters are all it takes to continue a render later
+    uint32_t GetFrameIndex() const { return m_FrameIndex; }
+    uint32_t GetFrameCounter() const { return m_FrameCounter; }
+    const float* GetLuminanceSquaredData() const { return m_LuminanceSquaredData.data(); }
+    //Buffers of GetWidth() * GetHeight() pixels (OnResize first), the image is recomputed from them
+    //Adaptive sampling estimates every tile's error again from the next frame on
+    void RestoreAccumulation(uint32_t frameIndex, uint32_t frameCounter, const glm::vec4* accumulation, const uint32_t* sampleCounts,
+        const float* luminanceSquared);
+    //1 = full resolution, otherwise the last frame was a preview with 1 ray per PreviewScale x PreviewScale block
+    uint32_t GetPreviewScale() const { return m_LastPreviewScale; }
+    //What the frame time budget gave the last frame, MaxBounces at 1 sample per pixel when it is off
+    const FrameBudget::Level& GetBudgetLevel() const { return m_BudgetLevel; }
+    //Only render the pixels in this rectangle of the image, the rest of the image buffers is left as it is - lets several
+    //renderers (processes) each render part of an image, the samples are the same as when rendering the whole image
+    //The rectangle is grown to multiples of 4 pixels (packets), a width or height of 0 renders the whole image again
+    //Preview frames still cover the whole image
+    void SetRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+    Settings& GetSettings(){ return m_Settings; }
+    
+private:
+    struct HitPayload
+    {
+        float HitDistance;
+        glm::vec3 WorldPosition;
+        glm::vec3 WorldNormal;
+        
+        int ObjectIndex;
+    };
+    //What the first hit of a sample saw, averaged per pixel for the denoiser
+    struct PixelFeatures
+    {
+        glm::vec3 Albedo;
+        glm::vec3 Normal;
+        float Depth;
+    };
+    const Scene* m_ActiveScene = nullptr;
+    const Camera* m_ActiveCamera = nullptr;
+    uint32_t m_Width = 0, m_Height = 0;
+    uint32_t* m_ImageData = nullptr;
+    //Accumulation -> image, 1 pass per tile after its samples instead of 1 conversion per sample
+    ImageResolve::ResolveFunction m_Resolve = ImageResolve::ResolveScalar;
+    Tile m_DirtyRegion;
+    //Encoding the image was last written in, converged tiles are only resolved again when it changes
+    ImageResolve::Encoding m_ImageEncoding = ImageResolve::Encoding::Linear;
+    glm::vec4* m_AccumulationData = nullptr;
+    Settings m_Settings;
+    uint32_t m_FrameIndex = 1;
+    //Frames rendered since creation
+    uint32_t m_FrameCounter = 0;
+    //Resolution divider of the next frame, see Settings::ProgressivePreview
+    uint32_t m_PreviewScale = 1;
+    uint32_t m_LastPreviewScale = 1;
+    //Cancel flag of the frame being rendered, and whether it was set before the frame was done
+    const std::atomic<bool>* m_Cancel = nullptr;
+    std::atomic<bool> m_Cancelled{ false };
+    //Per pixel: samples accumulated and sum of luminance^2, for the variance estimate of adaptive sampling
+    std::vector<uint32_t> m_SampleCounts;
+    std::vector<float> m_LuminanceSquaredData;
+    //Per pixel, only while denoising: summed first hit albedo (w = samples recorded) and normal (w = summed depth)
+    std::vector<glm::vec4> m_AlbedoData, m_NormalDepthData;
+    bool m_RecordFeatures = false;
+    std::vector<glm::vec4> m_DenoisedData;
+    Denoiser m_Denoiser;
+    //Temporal reprojection: camera the accumulated samples were taken from, and the buffers they are reprojected from
+    bool m_ReprojectPending = false;
+    bool m_HasHistoryCamera = false;
+    glm::mat4 m_HistoryViewProjection{ 1.0f };
+    glm::vec3 m_HistoryCameraPosition{ 0.0f };
+    std::vector<glm::vec4> m_HistoryAccumulation, m_HistoryAlbedo, m_HistoryNormalDepth;
+    std::vector<uint32_t> m_HistorySampleCounts;
+    std::vector<float> m_HistoryLuminanceSquared;
+    float m_ReprojectedShare = 0.0f;
+    //Selective reset: per pixel the objects its samples touched, object i is bit i % 64 - in scenes of more than
+    //64 spheres several share a bit, an edit of one then also resets the pixels of the others
+    std::vector<uint64_t> m_PixelObjects, m_HistoryObjects;
+    bool m_RecordObjects = false;
+    bool m_EditPending = false;
+    //Spheres the last UpdateAccelerationStructure took over from the scene, where they were before
+    struct SphereEdit
+    {
+        uint32_t Index;
+        glm::vec3 OldPosition;
+        float OldRadius;
+    };
+    std::vector<SphereEdit> m_SphereEdits;
+    //False when the mirror was rebuilt instead, which spheres changed is unknown then
+    bool m_SphereEditsKnown = false;
+    //Materials and lights of the scene as of the last frame, emitters before the last UpdateEmitters
+    const Scene* m_EditScene = nullptr;
+    uint64_t m_EditMaterialGeneration = 0, m_EditLightGeneration = 0;
+    std::vector<uint32_t> m_PreviousEmissiveSpheres;
+    float m_ResetShare = 0.0f;
+    //Per tile: error estimate after its last samples and samples per pixel to take this frame
+    std::vector<float> m_TileErrors;
+    std::vector<uint32_t> m_TileSamples;
+    uint64_t m_SamplesThisFrame = 0;
+    uint64_t m_RaysThisFrame = 0;
+    std::vector<uint64_t> m_ThreadRayCounts;
+    //Frame time budget: level of the frame being rendered (its Bounces limit every path), time spent in tiles
+    //per thread and wall time of all tiles
+    FrameBudget m_FrameBudget;
+    FrameBudget::Level m_BudgetLevel;
+    std::vector<double> m_ThreadTileSeconds;
+    double m_TraceSeconds = 0.0;
+    //Wavefront engine: pixels sampled this pass, paths in flight (double buffered for compaction) and their colors
+    std::vector<uint32_t> m_WavePixels;
+    PathQueue m_Paths, m_CompactedPaths;
+    std::vector<glm::vec3> m_WaveColors;
+    std::vector<PixelFeatures> m_WaveFeatures;
+    std::vector<uint64_t> m_WaveObjects;
+    std::vector<uint32_t> m_RangeOffsets;
+    BVH m_BVH;
+    //SoA mirror of the scene spheres for the SIMD kernels when not using the BVH
+    SphereSoA m_Spheres;
+    SphereKernels::IntersectFunction m_SphereKernel = SphereKernels::IntersectScalar;
+    SphereKernels::OccludedFunction m_OccludedKernel = SphereKernels::OccludedScalar;
+    //Spheres the SoA/BVH mirror and how far into their change log they are, to pick up scene edits
+    const SceneArray<Sphere>* m_MirroredSpheres = nullptr;
+    uint64_t m_SphereGeneration = 0;
+    std::vector<SceneRange> m_SphereChanges;
+    //Spheres with an emissive material, sampled as lights - rebuilt when the spheres or materials of the scene change
+    std::vector<uint32_t> m_EmissiveSpheres;
+    const Scene* m_EmitterScene = nullptr;
+    uint64_t m_EmitterSphereGeneration = 0, m_EmitterMaterialGeneration = 0;
+    //Multithreading: tiles of the image and the threads working through them
+    TileScheduler m_Scheduler;
+    std::vector<Tile> m_Tiles;
+    uint32_t m_TileSize = 0;
+    TileOrder m_TileOrder = TileOrder::Hilbert;
+    //See SetRegion, as set - Width 0 = whole image
+    Tile m_Region;
+
+    //Render kernels: the tile path (RenderTile down to TraceRay) is compiled once per combination of these options and
+    //per bounce limit, so the compiler drops the branches of options that are off and knows how often the bounce loop
+    //runs - KernelDynamic reads the options from m_KernelOptions and the limit from the frame budget instead, it serves
+    //every configuration and everything outside the tile path (previews, wavefront, reprojection)
+    enum KernelOption : uint32_t
+    {
+        KernelBVH = 1 << 0,
+        KernelNextEventEstimation = 1 << 1,
+        KernelRussianRoulette = 1 << 2,
+        KernelAccumulate = 1 << 3,
+        KernelDynamic = 1u << 31
+    };
+    static constexpr uint32_t KernelOptionCount = 4;
+    //Longest path with kernels of its own, longer ones get the ones that read the limit
+    static constexpr uint32_t MaxKernelBounces = 8;
+    using TileKernel = uint64_t(Renderer::*)(const Tile& tile);
+    //Options of this frame, and the kernel its tiles are rendered with
+    uint32_t m_KernelOptions = 0;
+    TileKernel m_TileKernel = nullptr;
+
+    template<uint32_t Options>
+    bool HasOption(uint32_t option) const
+    {
+        if constexpr((Options & KernelDynamic) != 0)
+            return (m_KernelOptions & option) != 0;
+        else
+            return (Options & option) != 0;
+    }
+    template<uint32_t Bounces>
+    uint32_t GetMaxBounces() const { return Bounces > 0 ? Bounces : m_BudgetLevel.Bounces; }
+    uint32_t GetKernelOptions() const; //Options as set in m_Settings
+    //Kernel compiled for options and a bounce limit of bounces (0 = read every frame), the closest one that is compiled
+    static TileKernel GetTileKernel(uint32_t options, uint32_t bounces);
+    template<uint32_t Bounces>
+    static TileKernel GetTileKernel(uint32_t options, uint32_t bounces);
+    template<uint32_t Bounces, uint32_t... Options>
+    static TileKernel GetTileKernel(uint32_t options, std::integer_sequence<uint32_t, Options...>);
+    
+    //Basicly like a shader: Return a color per pixel from viewport based on coord in viewport
+    //glm::vec4 PerPixel(glm::vec2 coord);
+    
+    bool IsCancelled(); //Checks the cancel flag, remembers when it was set
+    Tile GetRenderRegion() const; //Region clamped to the image and grown to multiples of 4, the whole image if none is set
+    void UpdateAccelerationStructure(const Scene& scene); //(Re)build the SoA mirror and BVH when the spheres changed
+    void UpdateEmitters(const Scene& scene); //Find the emissive spheres again when spheres or materials changed
+    void PlanAdaptiveSamples(); //Decide how many samples every tile gets this frame
+    FrameBudget::Settings GetBudgetSettings() const;
+    void UpdateFrameBudget(std::chrono::steady_clock::time_point frameStart); //Learn from the frame that just finished
+    float EstimateTileError(const Tile& tile) const;
+    template<uint32_t Options = KernelDynamic>
+    uint32_t GetSampleSeed(uint32_t pixelIndex) const; //Frame/sample number the random numbers of a pixel are seeded with
+    template<uint32_t Options = KernelDynamic, uint32_t Bounces = 0>
+    uint64_t RenderTile(const Tile& tile); //Returns the number of rays traced
+    void RenderWavefront(); //Same samples as rendering every tile, traced stage by stage
+    void TraceWave(uint32_t firstPixel, uint32_t count);
+    void GeneratePaths(uint32_t firstPixel, uint32_t count);
+    void IntersectPaths();
+    void ShadePaths(uint32_t bounce); //The first bounce also records the denoiser features
+    void CompactPaths();
+    void RenderPreview(uint32_t scale); //Low resolution frame straight into the image, upscaled, without accumulating
+    template<uint32_t Options = KernelDynamic, uint32_t Bounces = 0>
+    uint32_t RenderPacket(uint32_t x, uint32_t y); //Trace the 4x4 block of pixels starting at x, y with a packet of primary rays
+    //Add a sample to the accumulation buffer, features only while recording them - the image is updated by ResolveTile
+    //objects: what the sample touched (GetObjectBit), for selective reset
+    void AccumulatePixel(uint32_t x, uint32_t y, const glm::vec4& color, const PixelFeatures* features = nullptr, uint64_t objects = 0);
+    void ResolveTile(const Tile& tile); //Averaged accumulation of the tile's pixels -> image
+    PixelFeatures GetPixelFeatures(const HitPayload& payload) const;
+    void DenoiseImage(); //Replace the image with the denoised accumulation buffer
+    bool ReprojectAccumulation(); //Reproject the history into the active camera's view, false when too little of it fits
+    //History pixel that saw the same surface as the ray (sky included), -1 when none did
+    int64_t FindHistoryPixel(const Ray& ray, const HitPayload& hit) const;
+    bool ResetEditedPixels(const Scene& scene); //Reset the pixels the scene edits touch, false when that cant be told
+    static uint64_t GetObjectBit(int objectIndex) { return 1ull << ((uint32_t)objectIndex % 64); }
+    Ray GeneratePrimaryRay(uint32_t x, uint32_t y, Utils::Random& random) const; //Camera ray through pixel x, y
+    //primaryHit: first hit of the pixel when it was already traced as part of a packet
+    //random: the path's own random numbers, seeded from its pixel and sample
+    //rayCount: incremented for every ray of the path
+    //features: set to what the first hit saw, when not null
+    //objects: gets the bits of the objects the path touched (see Shade), when not null
+    template<uint32_t Options = KernelDynamic, uint32_t Bounces = 0>
+    glm::vec4 PerPixel(Ray ray, Utils::Random& random, uint32_t& rayCount, const HitPayload* primaryHit = nullptr, PixelFeatures* features = nullptr,
+        uint64_t* objects = nullptr); //RayGen shader - runs for every pixel we want to render, so we can choose when to call TraceRay and when not, will return the color
+    //Adds the light of a bounce to color and turns ray into the next bounce, false when the path ends
+    //bounce: index of the ray that hit (0 = primary), for Russian roulette
+    //objects: when not null, gets the bits of the spheres hit by the first 2 rays and in the way of the first shadow rays
+    template<uint32_t Options = KernelDynamic, uint32_t Bounces = 0>
+    bool Shade(Ray& ray, const HitPayload& payload, uint32_t bounce, Utils::Random& random, glm::vec3& color, float& multiplier,
+        uint64_t* objects = nullptr) const;
+    //Irradiance at a hit from all lights and 1 randomly picked emissive sphere, 1 shadow ray each
+    //occluders: when not null, gets the bits of the spheres that blocked a shadow ray
+    template<uint32_t Options = KernelDynamic>
+    glm::vec3 SampleDirectLight(const HitPayload& payload, Utils::Random& random, uint64_t* occluders = nullptr) const;
+    template<uint32_t Options = KernelDynamic>
+    HitPayload  TraceRay(const Ray& ray); //Shoots rays returns payload with info about what happened to the ray
+    template<uint32_t Options = KernelDynamic>
+    void IntersectScene(const Ray& ray, float& hitDistance, int& objectIndex) const; //Closest sphere only, no payload
+    template<uint32_t Options = KernelDynamic>
+    int FindOccluder(const Ray& ray, float maxDistance) const; //Any sphere closer than maxDistance, -1 when none, for shadow rays
+    const Light* GetLights(size_t& count) const; //Lights of the active scene, the default light when it has no lights or emitters
+    HitPayload ClosestHit(const Ray& ray, float hitDistance, int objectIndex); //Shader to run when we hit something
+    HitPayload Miss(const Ray& ray); //Shader that runs when we dont hit anything
+};
@@ -0,0 +1,150 @@
+#include "Renderer.h"
+#include "Profiler.h"
+#include <cfloat>
+#include <algorithm>
+
+//Temporal reprojection: a camera move used to throw away every accumulated sample, even though most pixels of a small
+//move still see the same surface as some pixel did before - just from a slightly different place
+//Every pixel's center ray finds the point it sees now, that point is projected with the old camera's view and
+//projection into the history, and the history pixel it lands on hands over its samples when it saw the same surface:
+//same distance from the old camera (nothing in front of it, no disocclusion) and the same normal (no silhouette)
+//Nearest pixel only, no filtering between history pixels - a blend of neighbours would mix samples of different
+//surfaces at edges, and the kept samples are only a head start that new samples take over from
+
+namespace Utils
+{
+    //Mean first hit distance of the history pixel may be off by this share of the expected distance
+    static constexpr float ReprojectionDepthTolerance = 0.05f;
+    //Mean first hit normal of the history pixel against the normal seen now (cosine)
+    static constexpr float ReprojectionNormalTolerance = 0.9f;
+    //Below this share of pixels keeping their samples the preview frames of a restart look better than the holes
+    static constexpr float ReprojectionMinShare = 0.25f;
+}
+
+void Renderer::OnCameraMoved()
+{
+    //Nothing accumulated that could be kept
+    if(!m_Settings.TemporalReprojection || !m_Settings.Accumulate || !m_HasHistoryCamera || m_FrameIndex == 1)
+    {
+        ResetFrameIndex();
+        return;
+    }
+    //Done by the next Render, it has the scene and camera to trace with
+    m_ReprojectPending = true;
+}
+
+bool Renderer::ReprojectAccumulation()
+{
+    RT_PROFILE_ZONE("Reproject");
+    m_ReprojectedShare = 0.0f;
+    //Without features there is no telling whether a history pixel saw the same surface, and pixels outside the render
+    //region have no samples to hand over
+    Tile region = GetRenderRegion();
+    if(!m_HasHistoryCamera || m_AlbedoData.empty() || region.Width != m_Width || region.Height != m_Height)
+        return false;
+
+    //The buffers get rewritten pixel by pixel from copies of themselves
+    size_t pixels = (size_t)m_Width * m_Height;
+    m_HistoryAccumulation.assign(m_AccumulationData, m_AccumulationData + pixels);
+    m_HistorySampleCounts = m_SampleCounts;
+    m_HistoryLuminanceSquared = m_LuminanceSquaredData;
+    m_HistoryAlbedo = m_AlbedoData;
+    m_HistoryNormalDepth = m_NormalDepthData;
+    m_HistoryObjects = m_PixelObjects;
+
+    m_Scheduler.SetThreadCount(m_Settings.ThreadCount);
+    std::vector<uint64_t> keptPixels(m_Scheduler.GetThreadCount(), 0);
+    uint32_t maxSamples = glm::max(m_Settings.ReprojectionMaxSamples, 1u);
+    m_Scheduler.ParallelFor(m_Height, 16, [&](uint32_t begin, uint32_t end, uint32_t threadIndex)
+    {
+        for(uint32_t y = begin; y < end; y++)
+        {
+            for(uint32_t x = 0; x < m_Width; x++)
+            {
+                size_t i = x + (size_t)y * m_Width;
+                Ray ray;
+                ray.Origin = m_ActiveCamera->GetPosition();
+                ray.Direction = m_ActiveCamera->GetRayDirection((float)x + 0.5f, (float)y + 0.5f);
+                HitPayload hit = TraceRay(ray);
+
+                int64_t q = FindHistoryPixel(ray, hit);
+                if(q < 0)
+                {
+                    //Disoccluded or new on screen: starts over, the next frame's sample is its first
+                    m_AccumulationData[i] = glm::vec4(0.0f);
+                    m_SampleCounts[i] = 0;
+                    m_LuminanceSquaredData[i] = 0.0f;
+                    m_AlbedoData[i] = glm::vec4(0.0f);
+                    m_NormalDepthData[i] = glm::vec4(0.0f);
+                    if(!m_PixelObjects.empty())
+                        m_PixelObjects[i] = 0;
+                    continue;
+                }
+
+                //At most maxSamples of the history are kept (the sums scaled down, the mean stays the same), so
+                //whatever looks different from here - reflections, highlights - is mostly new samples soon
+                uint32_t samples = m_HistorySampleCounts[q];
+                uint32_t kept = glm::min(samples, maxSamples);
+                float scale = (float)kept / (float)samples;
+                m_AccumulationData[i] = m_HistoryAccumulation[q] * scale;
+                m_LuminanceSquaredData[i] = m_HistoryLuminanceSquared[q] * scale;
+                m_SampleCounts[i] = kept;
+                if(!m_PixelObjects.empty())
+                    m_PixelObjects[i] = m_HistoryObjects[q];
+
+                //Features as seen from the new camera: the same albedo, the depth and normal of the center ray, so
+                //the next reprojection (and the denoiser) compare against this view
+                float features = glm::min(m_HistoryAlbedo[q].w, (float)maxSamples);
+                glm::vec3 albedo = glm::vec3(m_HistoryAlbedo[q]) / m_HistoryAlbedo[q].w;
+                m_AlbedoData[i] = glm::vec4(albedo * features, features);
+                m_NormalDepthData[i] = hit.HitDistance < 0.0f ? glm::vec4(0.0f) : glm::vec4(hit.WorldNormal, hit.HitDistance) * features;
+                keptPixels[threadIndex]++;
+            }
+        }
+    });
+    //No need to write the image: every pixel gets a sample next, the error estimates are from another view
+    std::fill(m_TileErrors.begin(), m_TileErrors.end(), FLT_MAX);
+
+    uint64_t kept = 0;
+    for(uint64_t count : keptPixels)
+        kept += count;
+    m_ReprojectedShare = (float)((double)kept / (double)pixels);
+    return m_ReprojectedShare >= Utils::ReprojectionMinShare;
+}
+
+int64_t Renderer::FindHistoryPixel(const Ray& ray, const HitPayload& hit) const
+{
+    //The sky is infinitely far away, only its direction projects (w = 0)
+    bool sky = hit.HitDistance < 0.0f;
+    glm::vec4 clip = m_HistoryViewProjection * (sky ? glm::vec4(ray.Direction, 0.0f) : glm::vec4(hit.WorldPosition, 1.0f));
+    //Behind the old camera
+    if(clip.w <= 0.0f)
+        return -1;
+
+    //Same mapping as Camera::GetRayDirection: -1..1 is the whole image in both directions, -1 the first pixel
+    float px = (clip.x / clip.w * 0.5f + 0.5f) * (float)m_Width;
+    float py = (clip.y / clip.w * 0.5f + 0.5f) * (float)m_Height;
+    if(!(px >= 0.0f && px < (float)m_Width && py >= 0.0f && py < (float)m_Height))
+        return -1;
+    size_t q = (size_t)px + (size_t)py * m_Width;
+
+    const glm::vec4& albedo = m_HistoryAlbedo[q];
+    const glm::vec4& normalDepth = m_HistoryNormalDepth[q];
+    //Features start with the samples, but can be turned on later - only pixels whose every sample recorded them count
+    if(m_HistorySampleCounts[q] == 0 || albedo.w < (float)m_HistorySampleCounts[q])
+        return -1;
+
+    //Sky only takes over sky, depth is 0 for sky samples so any surface in the history pixel shows up in its sum
+    if(sky)
+        return normalDepth.w == 0.0f ? (int64_t)q : -1;
+
+    //Something in front of the point when the history was taken (or the point itself in front of what was there)
+    float expectedDepth = glm::length(hit.WorldPosition - m_HistoryCameraPosition);
+    float depth = normalDepth.w / albedo.w;
+    if(glm::abs(depth - expectedDepth) > Utils::ReprojectionDepthTolerance * expectedDepth)
+        return -1;
+    //Samples of the history pixel that hit another surface pull its mean normal away
+    if(glm::dot(glm::vec3(normalDepth), hit.WorldNormal) < Utils::ReprojectionNormalTolerance * albedo.w)
+        return -1;
+    return (int64_t)q;
+}
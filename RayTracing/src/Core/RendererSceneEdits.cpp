@@ -0,0 +1,224 @@
+#include "Renderer.h"
+#include "Profiler.h"
+#include <cfloat>
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+
+//Selective reset: editing 1 sphere used to throw away the samples of every pixel, even the ones that never saw it
+//Every sample records which spheres its path touched (AccumulatePixel), an edit resets only the pixels that touched an
+//edited sphere - plus the pixels the sphere covers on screen at its new place, which havent touched it yet, and the
+//pixels whose first hit now sees it on the way to a light or in its first bounce (new shadows and reflections)
+//Everything else keeps its samples and keeps converging, adaptive sampling sends the new samples to the reset pixels
+
+namespace Utils
+{
+    //Pixels a sphere can cover in the image: its bounding box projected, the whole image when part of it is behind
+    //the camera
+    static Tile GetScreenBounds(const glm::mat4& viewProjection, const glm::vec3& center, float radius, uint32_t width, uint32_t height)
+    {
+        glm::vec2 min(FLT_MAX), max(-FLT_MAX);
+        for(int corner = 0; corner < 8; corner++)
+        {
+            glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+            glm::vec4 clip = viewProjection * glm::vec4(center + offset, 1.0f);
+            if(clip.w <= 0.0f)
+                return { 0, 0, width, height, 0 };
+            //Same mapping as Camera::GetRayDirection: -1..1 is the whole image in both directions
+            glm::vec2 pixel = (glm::vec2(clip) / clip.w * 0.5f + 0.5f) * glm::vec2((float)width, (float)height);
+            min = glm::min(min, pixel);
+            max = glm::max(max, pixel);
+        }
+
+        //1 pixel more on every side for jittered samples
+        float x0 = glm::clamp(glm::floor(min.x) - 1.0f, 0.0f, (float)width);
+        float y0 = glm::clamp(glm::floor(min.y) - 1.0f, 0.0f, (float)height);
+        float x1 = glm::clamp(glm::ceil(max.x) + 1.0f, 0.0f, (float)width);
+        float y1 = glm::clamp(glm::ceil(max.y) + 1.0f, 0.0f, (float)height);
+        return { (uint32_t)x0, (uint32_t)y0, (uint32_t)(x1 - x0), (uint32_t)(y1 - y0), 0 };
+    }
+
+    //Whether a sphere reaches into the cone from apex around axis (normalized) with the given half angle, cut off at
+    //length - half angle 0 is a segment. Conservative: the cone's end is treated as round
+    static bool ConeReachesSphere(const glm::vec3& apex, const glm::vec3& axis, float halfAngle, float length, const glm::vec3& center, float radius)
+    {
+        glm::vec3 toCenter = center - apex;
+        float distance = glm::length(toCenter);
+        if(distance <= radius)
+            return true;
+        if(distance - radius > length)
+            return false;
+        float angle = std::acos(glm::clamp(glm::dot(toCenter / distance, axis), -1.0f, 1.0f));
+        return angle <= halfAngle + std::asin(radius / distance);
+    }
+}
+
+void Renderer::OnSceneEdited()
+{
+    //Nothing accumulated that could be kept
+    if(!m_Settings.SelectiveReset || !m_Settings.Accumulate || m_FrameIndex == 1)
+    {
+        ResetFrameIndex();
+        return;
+    }
+    //Done by the next Render, once the acceleration structure took over the edits and knows where spheres were
+    m_EditPending = true;
+}
+
+bool Renderer::ResetEditedPixels(const Scene& scene)
+{
+    RT_PROFILE_ZONE("Selective reset");
+    m_ResetShare = 1.0f;
+    //Which spheres changed is only known when the mirror followed the scene's change log instead of rebuilding, pixels
+    //outside the render region wouldnt get new samples, and lights light everything
+    Tile region = GetRenderRegion();
+    if(m_PixelObjects.empty() || !m_SphereEditsKnown || m_EditScene != &scene || region.Width != m_Width || region.Height != m_Height ||
+        scene.Lights.GetGeneration() != m_EditLightGeneration)
+        return false;
+
+    std::vector<SceneRange> materialChanges;
+    if(!scene.Materials.GetChangesSince(m_EditMaterialGeneration, materialChanges))
+        return false;
+
+    //Edited spheres and the spheres of edited materials
+    std::vector<uint32_t> edited;
+    for(const SphereEdit& edit : m_SphereEdits)
+        edited.push_back(edit.Index);
+    if(!materialChanges.empty())
+    {
+        std::vector<bool> editedMaterials(scene.Materials.size(), false);
+        for(const SceneRange& range : materialChanges)
+            for(size_t i = range.First; i < range.First + range.Count; i++)
+                editedMaterials[i] = true;
+        for(size_t i = 0; i < scene.Spheres.size(); i++)
+        {
+            int materialIndex = scene.Spheres[i].MaterialIndex;
+            if(materialIndex >= 0 && (size_t)materialIndex < editedMaterials.size() && editedMaterials[materialIndex])
+                edited.push_back((uint32_t)i);
+        }
+    }
+
+    //Emitters are sampled from every pixel, before the edit or after it
+    uint64_t objects = 0;
+    for(uint32_t index : edited)
+    {
+        if(std::find(m_EmissiveSpheres.begin(), m_EmissiveSpheres.end(), index) != m_EmissiveSpheres.end() ||
+            std::find(m_PreviousEmissiveSpheres.begin(), m_PreviousEmissiveSpheres.end(), index) != m_PreviousEmissiveSpheres.end())
+            return false;
+        objects |= GetObjectBit((int)index);
+    }
+
+    //Where edited spheres were and are on screen
+    glm::mat4 viewProjection = m_ActiveCamera->GetProjection() * m_ActiveCamera->GetView();
+    std::vector<Tile> areas;
+    for(const SphereEdit& edit : m_SphereEdits)
+    {
+        const Sphere& sphere = scene.Spheres[edit.Index];
+        areas.push_back(Utils::GetScreenBounds(viewProjection, edit.OldPosition, edit.OldRadius, m_Width, m_Height));
+        areas.push_back(Utils::GetScreenBounds(viewProjection, sphere.Position, sphere.Radius, m_Width, m_Height));
+    }
+
+    //Where edited spheres are now, a bit bigger: the ray through the pixel center stands for all its jittered samples
+    std::sort(edited.begin(), edited.end());
+    edited.erase(std::unique(edited.begin(), edited.end()), edited.end());
+    std::vector<glm::vec4> bounds;
+    for(uint32_t index : edited)
+        bounds.emplace_back(scene.Spheres[index].Position, scene.Spheres[index].Radius * 1.02f);
+    size_t lightCount;
+    const Light* lights = GetLights(lightCount);
+
+    //Whether the first hit through the pixel center sees an edited sphere where it is now: between it and a light or
+    //an emitter (shadow rays), or in the cone its first bounce goes into
+    //Spheres it saw before the edit are in the pixel's objects already, later bounces dont count (see Shade)
+    auto seesEdits = [&](uint32_t x, uint32_t y)
+    {
+        Ray ray;
+        ray.Origin = m_ActiveCamera->GetPosition();
+        ray.Direction = m_ActiveCamera->GetRayDirection((float)x + 0.5f, (float)y + 0.5f);
+        HitPayload hit = TraceRay(ray);
+        if(hit.HitDistance < 0.0f)
+            return false;
+
+        glm::vec3 origin = hit.WorldPosition + hit.WorldNormal * 0.0001f;
+        //Reflect bends the normal by up to roughness * |(0.5, 0.5, 0.5)|, the reflection turns twice as far
+        float roughness = m_ActiveScene->Materials[m_ActiveScene->Spheres[hit.ObjectIndex].MaterialIndex].Roughness;
+        float bend = roughness * 0.866f;
+        float reflectionAngle = bend < 1.0f ? 2.0f * std::asin(bend) : glm::pi<float>();
+        glm::vec3 reflection = glm::reflect(ray.Direction, hit.WorldNormal);
+        for(const glm::vec4& sphere : bounds)
+        {
+            glm::vec3 center(sphere);
+            if(Utils::ConeReachesSphere(origin, reflection, reflectionAngle, FLT_MAX, center, sphere.w))
+                return true;
+            if(!m_Settings.NextEventEstimation)
+                continue;
+
+            for(size_t l = 0; l < lightCount; l++)
+            {
+                const Light& light = lights[l];
+                if(light.Type == LightType::Directional ?
+                    Utils::ConeReachesSphere(origin, -glm::normalize(light.Direction), 0.0f, FLT_MAX, center, sphere.w) :
+                    Utils::ConeReachesSphere(origin, glm::normalize(light.Position - origin), 0.0f, glm::length(light.Position - origin), center, sphere.w))
+                    return true;
+            }
+            for(uint32_t emitterIndex : m_EmissiveSpheres)
+            {
+                const Sphere& emitter = m_ActiveScene->Spheres[emitterIndex];
+                glm::vec3 toEmitter = emitter.Position - origin;
+                float distance = glm::length(toEmitter);
+                if(distance <= emitter.Radius || (int)emitterIndex == hit.ObjectIndex)
+                    continue;
+                if(Utils::ConeReachesSphere(origin, toEmitter / distance, std::asin(emitter.Radius / distance), distance, center, sphere.w))
+                    return true;
+            }
+        }
+        return false;
+    };
+
+    m_Scheduler.SetThreadCount(m_Settings.ThreadCount);
+    std::vector<uint64_t> resetPixels(m_Scheduler.GetThreadCount(), 0);
+    m_Scheduler.ParallelFor(m_Height, 16, [&](uint32_t begin, uint32_t end, uint32_t threadIndex)
+    {
+        for(uint32_t y = begin; y < end; y++)
+        {
+            for(uint32_t x = 0; x < m_Width; x++)
+            {
+                size_t i = x + (size_t)y * m_Width;
+                bool reset = (m_PixelObjects[i] & objects) != 0;
+                for(size_t a = 0; a < areas.size() && !reset; a++)
+                    reset = x >= areas[a].X && x < areas[a].X + areas[a].Width && y >= areas[a].Y && y < areas[a].Y + areas[a].Height;
+                if(!reset)
+                    reset = seesEdits(x, y);
+                if(!reset)
+                    continue;
+
+                //Same as a pixel after ResetFrameIndex: its next sample is its first, with the same random numbers
+                m_AccumulationData[i] = glm::vec4(0.0f);
+                m_SampleCounts[i] = 0;
+                m_LuminanceSquaredData[i] = 0.0f;
+                if(!m_AlbedoData.empty())
+                {
+                    m_AlbedoData[i] = glm::vec4(0.0f);
+                    m_NormalDepthData[i] = glm::vec4(0.0f);
+                }
+                m_PixelObjects[i] = 0;
+                resetPixels[threadIndex]++;
+            }
+        }
+    });
+
+    //Tiles with reset pixels get an infinite error estimate (fewer than 2 samples), the rest keep theirs
+    if(m_Settings.Adaptive && m_TileErrors.size() == m_Tiles.size())
+    {
+        m_Scheduler.Run(m_Tiles, [this](const Tile& tile, uint32_t threadIndex)
+        {
+            m_TileErrors[tile.Index] = EstimateTileError(tile);
+        });
+    }
+
+    uint64_t reset = 0;
+    for(uint64_t count : resetPixels)
+        reset += count;
+    m_ResetShare = (float)((double)reset / ((double)m_Width * m_Height));
+    return true;
+}
@@ -0,0 +1,182 @@
+#include "Renderer.h"
+#include "Profiler.h"
+#include <cfloat>
+#include <algorithm>
+
+//Wavefront path tracing: PerPixel runs the whole bounce loop for 1 pixel, so intersection and shading code take turns
+//and threads wait on whichever of their pixels bounces the longest
+//Here every stage runs over a big queue of paths before the next stage starts, each one a tight loop over the SoA
+//buffers of PathQueue: generate primary rays -> intersect -> shade -> throw out finished paths -> intersect -> ...
+
+namespace Utils
+{
+    //Paths per job of a stage, ranges are also the blocks the compaction counts survivors in
+    static constexpr uint32_t WavefrontRangeSize = 4096;
+}
+
+void Renderer::RenderWavefront()
+{
+    RT_PROFILE_ZONE("Trace");
+    //Pass n traces 1 sample for every pixel of the tiles that get more than n samples this frame
+    //Pixels are listed tile by tile in curve order, so paths next to each other in the queue are close in the image
+    uint32_t passes = 0;
+    for(uint32_t samples : m_TileSamples)
+        passes = glm::max(passes, samples);
+
+    for(uint32_t pass = 0; pass < passes; pass++)
+    {
+        m_WavePixels.clear();
+        for(const Tile& tile : m_Tiles)
+        {
+            if(m_TileSamples[tile.Index] <= pass)
+                continue;
+            for(uint32_t y = tile.Y; y < tile.Y + tile.Height; y++)
+                for(uint32_t x = tile.X; x < tile.X + tile.Width; x++)
+                    m_WavePixels.push_back(x + y * m_Width);
+        }
+
+        //A wave is all or nothing, its pixels get their sample in the resolve at the end
+        uint32_t waveSize = glm::max(m_Settings.WavefrontSize, Utils::WavefrontRangeSize);
+        for(uint32_t first = 0; first < (uint32_t)m_WavePixels.size() && !IsCancelled(); first += waveSize)
+            TraceWave(first, glm::min(waveSize, (uint32_t)m_WavePixels.size() - first));
+    }
+
+    //Resolve stage, tile by tile like the tile engine does it
+    m_Scheduler.Run(m_Tiles, [this](const Tile& tile, uint32_t threadIndex)
+    {
+        if(m_TileSamples[tile.Index] == 0)
+            return;
+        if(m_Settings.Adaptive)
+            m_TileErrors[tile.Index] = EstimateTileError(tile);
+        if(!m_Settings.Denoise)
+            ResolveTile(tile);
+    });
+}
+
+void Renderer::TraceWave(uint32_t firstPixel, uint32_t count)
+{
+    m_Paths.Resize(count);
+    m_CompactedPaths.Resize(count);
+    m_WaveColors.resize(count);
+    if(m_RecordFeatures)
+        m_WaveFeatures.resize(count);
+    if(m_RecordObjects)
+        m_WaveObjects.resize(count);
+
+    GeneratePaths(firstPixel, count);
+
+    for(uint32_t i = 0; i < m_BudgetLevel.Bounces && m_Paths.Count > 0; i++)
+    {
+        m_ThreadRayCounts[0] += m_Paths.Count; //Stages run one after the other, no need for a slot per thread
+        if(i == 0)
+            RT_PROFILE_COUNT(PrimaryRays, m_Paths.Count);
+        else
+            RT_PROFILE_COUNT(BounceRays, m_Paths.Count);
+        IntersectPaths();
+        ShadePaths(i);
+        CompactPaths();
+    }
+
+    //Every pixel is in a wave once per pass, so no 2 threads write the same pixel
+    RT_PROFILE_ZONE("Resolve");
+    m_Scheduler.ParallelFor(count, Utils::WavefrontRangeSize, [this, firstPixel](uint32_t begin, uint32_t end, uint32_t threadIndex)
+    {
+        for(uint32_t i = begin; i < end; i++)
+        {
+            uint32_t pixel = m_WavePixels[firstPixel + i];
+            AccumulatePixel(pixel % m_Width, pixel / m_Width, glm::vec4(m_WaveColors[i], 1.0f), m_RecordFeatures ? &m_WaveFeatures[i] : nullptr,
+                m_RecordObjects ? m_WaveObjects[i] : 0);
+        }
+    });
+}
+
+void Renderer::GeneratePaths(uint32_t firstPixel, uint32_t count)
+{
+    RT_PROFILE_ZONE("Ray generation");
+    m_Scheduler.ParallelFor(count, Utils::WavefrontRangeSize, [this, firstPixel](uint32_t begin, uint32_t end, uint32_t threadIndex)
+    {
+        for(uint32_t i = begin; i < end; i++)
+        {
+            //Same random numbers as the per pixel path tracer, so both engines make the same image
+            uint32_t pixel = m_WavePixels[firstPixel + i];
+            m_Paths.Randoms[i] = Utils::Random(pixel, GetSampleSeed(pixel));
+            m_Paths.SetRay(i, GeneratePrimaryRay(pixel % m_Width, pixel / m_Width, m_Paths.Randoms[i]));
+            m_Paths.Multiplier[i] = 1.0f;
+            m_Paths.Slot[i] = i;
+            m_WaveColors[i] = glm::vec3(0.0f);
+            if(m_RecordObjects)
+                m_WaveObjects[i] = 0;
+        }
+    });
+    m_Paths.Count = count;
+}
+
+void Renderer::IntersectPaths()
+{
+    //Only the BVH/sphere data is touched here, no materials or shading
+    RT_PROFILE_ZONE("Intersect");
+    m_Scheduler.ParallelFor(m_Paths.Count, Utils::WavefrontRangeSize, [this](uint32_t begin, uint32_t end, uint32_t threadIndex)
+    {
+        uint32_t misses = 0;
+        for(uint32_t i = begin; i < end; i++)
+        {
+            float hitDistance = FLT_MAX;
+            int objectIndex = -1;
+            IntersectScene(m_Paths.GetRay(i), hitDistance, objectIndex);
+            m_Paths.HitDistance[i] = hitDistance;
+            m_Paths.ObjectIndex[i] = objectIndex;
+            misses += objectIndex < 0;
+        }
+        RT_PROFILE_COUNT(Hits, end - begin - misses);
+        RT_PROFILE_COUNT(Misses, misses);
+    });
+}
+
+void Renderer::ShadePaths(uint32_t bounce)
+{
+    RT_PROFILE_ZONE("Shade");
+    bool recordFeatures = bounce == 0 && m_RecordFeatures;
+    m_Scheduler.ParallelFor(m_Paths.Count, Utils::WavefrontRangeSize, [this, bounce, recordFeatures](uint32_t begin, uint32_t end, uint32_t threadIndex)
+    {
+        for(uint32_t i = begin; i < end; i++)
+        {
+            Ray ray = m_Paths.GetRay(i);
+            HitPayload payload = m_Paths.ObjectIndex[i] < 0 ? Miss(ray) : ClosestHit(ray, m_Paths.HitDistance[i], m_Paths.ObjectIndex[i]);
+            if(recordFeatures)
+                m_WaveFeatures[m_Paths.Slot[i]] = GetPixelFeatures(payload);
+
+            m_Paths.Alive[i] = Shade(ray, payload, bounce, m_Paths.Randoms[i], m_WaveColors[m_Paths.Slot[i]], m_Paths.Multiplier[i],
+                m_RecordObjects ? &m_WaveObjects[m_Paths.Slot[i]] : nullptr);
+            m_Paths.SetRay(i, ray);
+        }
+    });
+}
+
+void Renderer::CompactPaths()
+{
+    //Finished paths leave the queue so the next intersect doesnt loop over dead rays
+    //Count survivors per range, prefix sum gives every range its offset, then every range copies its survivors in parallel
+    RT_PROFILE_ZONE("Compact");
+    uint32_t rangeCount = (m_Paths.Count + Utils::WavefrontRangeSize - 1) / Utils::WavefrontRangeSize;
+    m_RangeOffsets.assign(rangeCount + 1, 0);
+    m_Scheduler.ParallelFor(m_Paths.Count, Utils::WavefrontRangeSize, [this](uint32_t begin, uint32_t end, uint32_t threadIndex)
+    {
+        uint32_t alive = 0;
+        for(uint32_t i = begin; i < end; i++)
+            alive += m_Paths.Alive[i];
+        m_RangeOffsets[begin / Utils::WavefrontRangeSize + 1] = alive;
+    });
+    for(uint32_t range = 0; range < rangeCount; range++)
+        m_RangeOffsets[range + 1] += m_RangeOffsets[range];
+
+    m_Scheduler.ParallelFor(m_Paths.Count, Utils::WavefrontRangeSize, [this](uint32_t begin, uint32_t end, uint32_t threadIndex)
+    {
+        uint32_t to = m_RangeOffsets[begin / Utils::WavefrontRangeSize];
+        for(uint32_t i = begin; i < end; i++)
+            if(m_Paths.Alive[i])
+                m_CompactedPaths.CopyPath(to++, m_Paths, i);
+    });
+
+    m_CompactedPaths.Count = m_RangeOffsets[rangeCount];
+    std::swap(m_Paths, m_CompactedPaths);
+}
@@ -0,0 +1,49 @@
+﻿#pragma once
+#include <memory>
+#include <glm/vec3.hpp>
+#include "SceneArray.h"
+
+struct Material
+{
+    //Color = Albedo = Non lit diffuse component of a material
+    glm::vec3 Albedo {1.0f};
+    float Roughness = 1.0f;
+    float Metallic = 0.0f;
+    //Light the surface gives off itself (radiance), spheres with an emissive material are sampled as lights
+    glm::vec3 EmissionColor {0.0f};
+    float EmissionPower = 0.0f;
+
+    glm::vec3 GetEmission() const { return EmissionColor * EmissionPower; }
+    bool IsEmissive() const { return EmissionPower > 0.0f && (EmissionColor.r > 0.0f || EmissionColor.g > 0.0f || EmissionColor.b > 0.0f); }
+};
+struct Sphere
+{
+    glm::vec3 Position {0.0f};
+    float Radius = 0.5f;
+    int MaterialIndex = 0;
+};
+enum class LightType : uint32_t
+{
+    Directional = 0, Point
+};
+//Light without a surface, it can only be reached by sampling it directly (a ray never hits it)
+//Intensity: irradiance on a surface facing it (at distance 1 for point lights, falls off with distance^2)
+struct Light
+{
+    LightType Type = LightType::Directional;
+    //Point lights
+    glm::vec3 Position {0.0f};
+    //Directional lights: the direction the light travels in
+    glm::vec3 Direction {-1.0f};
+    glm::vec3 Color {1.0f};
+    float Intensity = 1.0f;
+};
+class BVH;
+struct Scene
+{
+    SceneArray<Sphere> Spheres; 
+    SceneArray<Material> Materials; 
+    SceneArray<Light> Lights;
+    //BVH that came with a scene file, built for Spheres as loaded - only used while Spheres is still a view of that file
+    std::shared_ptr<const BVH> Acceleration;
+};
@@ -0,0 +1,232 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//Numbers every change of every scene array, so a generation never stands for 2 different states
+inline uint64_t NextSceneGeneration()
+{
+    static std::atomic<uint64_t> generation{ 0 };
+    return ++generation;
+}
+
+//Elements [First, First + Count) changed
+struct SceneRange
+{
+    size_t First = 0;
+    size_t Count = 0;
+};
+
+//Array of scene objects that either owns its elements (built in code, loaded from a text file) or is a read only view
+//of memory someone else owns (a memory mapped scene file) - views cost nothing to create, no matter how big the scene
+//Reading is the same for both, writing goes through Edit/push_back/... which first copy a view into owned memory
+//
+//Every write is logged, so whoever mirrors the array (SoA copies, BVH) can update just the elements that changed:
+//remember GetGeneration() after syncing and ask GetChangesSince() next time
+//Edits of single elements are logged as ranges, anything that changes the size or replaces the whole array means
+//start over, same as a log that got too long to keep
+template<typename T>
+class SceneArray
+{
+public:
+    SceneArray() { Restructure(); }
+    SceneArray(const SceneArray& other) { *this = other; }
+    SceneArray(SceneArray&& other) noexcept { *this = std::move(other); }
+
+    SceneArray& operator=(const SceneArray& other)
+    {
+        m_Owned = other.m_Owned;
+        m_Storage = other.m_Storage;
+        m_Data = m_Storage ? other.m_Data : m_Owned.data();
+        m_Size = other.m_Size;
+        //Copies get edited on their own from here on, their logs would tell different stories with the same numbers
+        Restructure();
+        return *this;
+    }
+
+    SceneArray& operator=(SceneArray&& other) noexcept
+    {
+        m_Owned = std::move(other.m_Owned);
+        m_Storage = std::move(other.m_Storage);
+        m_Data = m_Storage ? other.m_Data : m_Owned.data();
+        m_Size = other.m_Size;
+        m_Changes = std::move(other.m_Changes);
+        m_Generation = other.m_Generation;
+        m_StructureGeneration = other.m_StructureGeneration;
+        other.clear();
+        return *this;
+    }
+
+    //count elements at data, storage keeps the memory alive for as long as any array points into it
+    static SceneArray View(const T* data, size_t count, std::shared_ptr<const void> storage)
+    {
+        SceneArray array;
+        array.m_Data = data;
+        array.m_Size = count;
+        array.m_Storage = std::move(storage);
+        return array;
+    }
+    bool IsView() const { return m_Storage != nullptr; }
+
+    size_t size() const { return m_Size; }
+    bool empty() const { return m_Size == 0; }
+    const T* data() const { return m_Data; }
+    const T* begin() const { return m_Data; }
+    const T* end() const { return m_Data + m_Size; }
+    const T& operator[](size_t index) const { return m_Data[index]; }
+
+    //Writable element, copies a view first and marks the element as changed
+    T& Edit(size_t index)
+    {
+        Detach();
+        LogChange(index);
+        return m_Owned[index];
+    }
+
+    void push_back(const T& value)
+    {
+        Detach();
+        m_Owned.push_back(value);
+        Sync();
+        Restructure();
+    }
+
+    T& emplace_back()
+    {
+        Detach();
+        T& value = m_Owned.emplace_back();
+        Sync();
+        Restructure();
+        return value;
+    }
+
+    void resize(size_t count)
+    {
+        Detach();
+        m_Owned.resize(count);
+        Sync();
+        Restructure();
+    }
+
+    void reserve(size_t count)
+    {
+        Detach();
+        m_Owned.reserve(count);
+        Sync();
+    }
+
+    void clear()
+    {
+        m_Storage.reset();
+        m_Owned.clear();
+        Sync();
+        Restructure();
+    }
+
+    //Make this array equal to source, which it was synced with at sourceGeneration before (0 = never): only the elements
+    //source logged as changed since then get copied, and are logged here the same way - whoever mirrors this array
+    //(BVH refit) stays incremental too. Returns false when source didnt change
+    bool SyncFrom(const SceneArray& source, uint64_t& sourceGeneration)
+    {
+        if (sourceGeneration == source.GetGeneration())
+            return false;
+
+        std::vector<SceneRange> ranges;
+        if (sourceGeneration != 0 && m_Size == source.size() && source.GetChangesSince(sourceGeneration, ranges))
+        {
+            for (const SceneRange& range : ranges)
+                for (size_t i = range.First; i < range.First + range.Count; i++)
+                    Edit(i) = source[i];
+        }
+        else
+            *this = source;
+
+        sourceGeneration = source.GetGeneration();
+        return true;
+    }
+
+    //Changes so far, compare with a later generation to see if anything changed
+    uint64_t GetGeneration() const { return m_Generation; }
+    //Ranges edited after generation, false when that is not known (size changed, array replaced, log dropped) and
+    //everything has to be treated as changed
+    bool GetChangesSince(uint64_t generation, std::vector<SceneRange>& ranges) const
+    {
+        ranges.clear();
+        if (generation < m_StructureGeneration)
+            return false;
+        for (const Change& change : m_Changes)
+            if (change.Generation > generation)
+                ranges.push_back(change.Range);
+        return true;
+    }
+
+private:
+    struct Change
+    {
+        uint64_t Generation;
+        SceneRange Range;
+    };
+    //Past this many logged ranges mirrors rebuild instead
+    static constexpr size_t MaxChanges = 256;
+
+    void LogChange(size_t index)
+    {
+        m_Generation = NextSceneGeneration();
+        //Dragging an element around edits it every frame, those all end up in 1 entry
+        if (!m_Changes.empty())
+        {
+            Change& last = m_Changes.back();
+            if (index + 1 >= last.Range.First && index <= last.Range.First + last.Range.Count)
+            {
+                size_t first = index < last.Range.First ? index : last.Range.First;
+                size_t end = index + 1 > last.Range.First + last.Range.Count ? index + 1 : last.Range.First + last.Range.Count;
+                last.Range = { first, end - first };
+                last.Generation = m_Generation;
+                return;
+            }
+        }
+
+        m_Changes.push_back({ m_Generation, { index, 1 } });
+        if (m_Changes.size() > MaxChanges)
+        {
+            //Whoever is behind the dropped change cant catch up anymore
+            m_StructureGeneration = m_Changes.front().Generation;
+            m_Changes.pop_front();
+        }
+    }
+
+    void Restructure()
+    {
+        m_Changes.clear();
+        m_Generation = m_StructureGeneration = NextSceneGeneration();
+    }
+
+    void Detach()
+    {
+        if (!m_Storage)
+            return;
+        m_Owned.assign(m_Data, m_Data + m_Size);
+        m_Storage.reset();
+        Sync();
+    }
+
+    void Sync()
+    {
+        m_Data = m_Owned.data();
+        m_Size = m_Owned.size();
+    }
+
+private:
+    std::vector<T> m_Owned;
+    const T* m_Data = nullptr;
+    size_t m_Size = 0;
+    std::shared_ptr<const void> m_Storage;
+
+    std::deque<Change> m_Changes;
+    uint64_t m_Generation = 0;
+    //Mirrors older than this have to rebuild
+    uint64_t m_StructureGeneration = 0;
+};
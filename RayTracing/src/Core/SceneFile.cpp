@@ -0,0 +1,276 @@
+#include "SceneFile.h"
+#include "BVH.h"
+#include "MappedFile.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
+
+namespace Utils
+{
+    static constexpr char BinaryMagic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', 0 };
+    static constexpr uint32_t BinaryVersion = 2;
+    //Written as is, reads back as something else on a machine with the other byte order
+    static constexpr uint32_t ByteOrderMark = 0x01020304;
+    static constexpr uint64_t ArrayAlignment = 64;
+
+    //Everything needed to find the arrays, the element sizes catch files written by a build with a different layout
+    struct BinaryHeader
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t ByteOrder;
+        uint32_t SphereSize, MaterialSize, NodeSize, LightSize;
+        uint64_t SphereCount, SphereOffset;
+        uint64_t MaterialCount, MaterialOffset;
+        uint64_t LightCount, LightOffset;
+        //NodeCount 0 = no BVH, otherwise SphereCount primitive indices follow the nodes
+        uint64_t NodeCount, NodeOffset;
+        uint64_t PrimitiveIndexOffset;
+    };
+
+    static uint64_t AlignUp(uint64_t offset)
+    {
+        return (offset + ArrayAlignment - 1) / ArrayAlignment * ArrayAlignment;
+    }
+
+    static void AppendArray(std::vector<uint8_t>& out, uint64_t offset, const void* data, uint64_t size)
+    {
+        out.resize(offset, 0);
+        out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+    }
+
+    static bool ArrayInFile(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize)
+    {
+        return offset % ArrayAlignment == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+    }
+
+    static bool WriteFile(const std::string& path, const void* data, size_t size)
+    {
+        std::ofstream stream(path, std::ios::binary);
+        if(!stream)
+            return false;
+        stream.write((const char*)data, (std::streamsize)size);
+        return (bool)stream;
+    }
+
+    static bool IsBinaryPath(const std::string& path)
+    {
+        std::string extension = path.substr(path.find_last_of('.') + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        return extension == "rtbin";
+    }
+}
+
+namespace SceneFile
+{
+    bool LoadText(const std::string& path, Scene& scene)
+    {
+        std::ifstream stream(path);
+        if(!stream)
+            return false;
+
+        Scene loaded;
+        std::string line;
+        while(std::getline(stream, line))
+        {
+            line = line.substr(0, line.find('#'));
+            std::istringstream words(line);
+            std::string type;
+            if(!(words >> type))
+                continue;
+
+            if(type == "material")
+            {
+                Material material;
+                if(!(words >> material.Albedo.r >> material.Albedo.g >> material.Albedo.b >> material.Roughness >> material.Metallic))
+                    return false;
+                //Emission is optional, but all 4 values or none
+                if(words >> material.EmissionColor.r &&
+                    !(words >> material.EmissionColor.g >> material.EmissionColor.b >> material.EmissionPower))
+                    return false;
+                loaded.Materials.push_back(material);
+            }
+            else if(type == "light")
+            {
+                Light light;
+                std::string lightType;
+                words >> lightType;
+                if(lightType == "directional")
+                    light.Type = LightType::Directional;
+                else if(lightType == "point")
+                    light.Type = LightType::Point;
+                else
+                    return false;
+                glm::vec3& vector = light.Type == LightType::Directional ? light.Direction : light.Position;
+                if(!(words >> vector.x >> vector.y >> vector.z >> light.Color.r >> light.Color.g >> light.Color.b >> light.Intensity))
+                    return false;
+                if(light.Type == LightType::Directional && glm::dot(light.Direction, light.Direction) == 0.0f)
+                    return false;
+                loaded.Lights.push_back(light);
+            }
+            else if(type == "sphere")
+            {
+                Sphere sphere;
+                if(!(words >> sphere.Position.x >> sphere.Position.y >> sphere.Position.z >> sphere.Radius >> sphere.MaterialIndex))
+                    return false;
+                loaded.Spheres.push_back(sphere);
+            }
+            else
+                return false;
+        }
+
+        for(const Sphere& sphere : loaded.Spheres)
+            if(sphere.MaterialIndex < 0 || sphere.MaterialIndex >= (int)loaded.Materials.size())
+                return false;
+
+        scene = std::move(loaded);
+        return true;
+    }
+
+    bool SaveText(const std::string& path, const Scene& scene)
+    {
+        std::ofstream stream(path);
+        if(!stream)
+            return false;
+
+        //Enough digits to read back the exact same floats
+        stream.precision(9);
+        stream << "# material <r> <g> <b> <roughness> <metallic> [<emission r> <emission g> <emission b> <emission power>]\n";
+        for(const Material& material : scene.Materials)
+        {
+            stream << "material " << material.Albedo.r << ' ' << material.Albedo.g << ' ' << material.Albedo.b << ' '
+                << material.Roughness << ' ' << material.Metallic;
+            if(material.EmissionPower != 0.0f || material.EmissionColor != glm::vec3(0.0f))
+                stream << ' ' << material.EmissionColor.r << ' ' << material.EmissionColor.g << ' ' << material.EmissionColor.b << ' '
+                    << material.EmissionPower;
+            stream << '\n';
+        }
+        stream << "# sphere <x> <y> <z> <radius> <material index>\n";
+        for(const Sphere& sphere : scene.Spheres)
+            stream << "sphere " << sphere.Position.x << ' ' << sphere.Position.y << ' ' << sphere.Position.z << ' '
+                << sphere.Radius << ' ' << sphere.MaterialIndex << '\n';
+        if(!scene.Lights.empty())
+            stream << "# light directional <direction x> <direction y> <direction z> <r> <g> <b> <intensity>\n"
+                "# light point <x> <y> <z> <r> <g> <b> <intensity>\n";
+        for(const Light& light : scene.Lights)
+        {
+            bool directional = light.Type == LightType::Directional;
+            const glm::vec3& vector = directional ? light.Direction : light.Position;
+            stream << "light " << (directional ? "directional " : "point ") << vector.x << ' ' << vector.y << ' ' << vector.z << ' '
+                << light.Color.r << ' ' << light.Color.g << ' ' << light.Color.b << ' ' << light.Intensity << '\n';
+        }
+        return (bool)stream;
+    }
+
+    void WriteBinary(const Scene& scene, const BVH* bvh, std::vector<uint8_t>& out)
+    {
+        Utils::BinaryHeader header = {};
+        memcpy(header.Magic, Utils::BinaryMagic, sizeof(header.Magic));
+        header.Version = Utils::BinaryVersion;
+        header.ByteOrder = Utils::ByteOrderMark;
+        header.SphereSize = sizeof(Sphere);
+        header.MaterialSize = sizeof(Material);
+        header.NodeSize = sizeof(BVHNode);
+        header.LightSize = sizeof(Light);
+
+        bool hasBVH = bvh && !bvh->IsEmpty() && bvh->GetPrimitiveIndices().size() == scene.Spheres.size();
+        header.SphereCount = scene.Spheres.size();
+        header.SphereOffset = Utils::AlignUp(sizeof(header));
+        header.MaterialCount = scene.Materials.size();
+        header.MaterialOffset = Utils::AlignUp(header.SphereOffset + header.SphereCount * sizeof(Sphere));
+        header.LightCount = scene.Lights.size();
+        header.LightOffset = Utils::AlignUp(header.MaterialOffset + header.MaterialCount * sizeof(Material));
+        header.NodeCount = hasBVH ? bvh->GetNodes().size() : 0;
+        header.NodeOffset = Utils::AlignUp(header.LightOffset + header.LightCount * sizeof(Light));
+        header.PrimitiveIndexOffset = Utils::AlignUp(header.NodeOffset + header.NodeCount * sizeof(BVHNode));
+
+        out.clear();
+        Utils::AppendArray(out, 0, &header, sizeof(header));
+        Utils::AppendArray(out, header.SphereOffset, scene.Spheres.data(), header.SphereCount * sizeof(Sphere));
+        Utils::AppendArray(out, header.MaterialOffset, scene.Materials.data(), header.MaterialCount * sizeof(Material));
+        Utils::AppendArray(out, header.LightOffset, scene.Lights.data(), header.LightCount * sizeof(Light));
+        if(hasBVH)
+        {
+            Utils::AppendArray(out, header.NodeOffset, bvh->GetNodes().data(), header.NodeCount * sizeof(BVHNode));
+            Utils::AppendArray(out, header.PrimitiveIndexOffset, bvh->GetPrimitiveIndices().data(), header.SphereCount * sizeof(uint32_t));
+        }
+    }
+
+    bool SaveBinary(const std::string& path, const Scene& scene, const BVH* bvh)
+    {
+        std::vector<uint8_t> out;
+        WriteBinary(scene, bvh, out);
+        return Utils::WriteFile(path, out.data(), out.size());
+    }
+
+    bool ReadBinary(const uint8_t* data, size_t size, std::shared_ptr<const void> storage, Scene& scene)
+    {
+        if(size < sizeof(Utils::BinaryHeader))
+            return false;
+
+        //Header first, then every index in the arrays - renderers index with them without checking
+        Utils::BinaryHeader header;
+        memcpy(&header, data, sizeof(header));
+        if(memcmp(header.Magic, Utils::BinaryMagic, sizeof(header.Magic)) != 0 || header.Version != Utils::BinaryVersion ||
+            header.ByteOrder != Utils::ByteOrderMark || header.SphereSize != sizeof(Sphere) ||
+            header.MaterialSize != sizeof(Material) || header.NodeSize != sizeof(BVHNode) || header.LightSize != sizeof(Light))
+            return false;
+        if(!Utils::ArrayInFile(header.SphereOffset, header.SphereCount, sizeof(Sphere), size) ||
+            !Utils::ArrayInFile(header.MaterialOffset, header.MaterialCount, sizeof(Material), size) ||
+            !Utils::ArrayInFile(header.LightOffset, header.LightCount, sizeof(Light), size))
+            return false;
+        if(header.NodeCount > 0 && (header.NodeCount > UINT32_MAX || header.SphereCount > UINT32_MAX ||
+            !Utils::ArrayInFile(header.NodeOffset, header.NodeCount, sizeof(BVHNode), size) ||
+            !Utils::ArrayInFile(header.PrimitiveIndexOffset, header.SphereCount, sizeof(uint32_t), size)))
+            return false;
+
+        //Same as the text format: every sphere has a material
+        const Sphere* spheres = (const Sphere*)(data + header.SphereOffset);
+        for(uint64_t i = 0; i < header.SphereCount; i++)
+            if(spheres[i].MaterialIndex < 0 || (uint64_t)spheres[i].MaterialIndex >= header.MaterialCount)
+                return false;
+        if(header.NodeCount > 0 && !BVH::IsValid((const BVHNode*)(data + header.NodeOffset), (uint32_t)header.NodeCount,
+            (const uint32_t*)(data + header.PrimitiveIndexOffset), (uint32_t)header.SphereCount))
+            return false;
+
+        //The arrays share ownership of the storage, it stays alive until the last of them is gone
+        Scene loaded;
+        loaded.Spheres = SceneArray<Sphere>::View((const Sphere*)(data + header.SphereOffset), header.SphereCount, storage);
+        loaded.Materials = SceneArray<Material>::View((const Material*)(data + header.MaterialOffset), header.MaterialCount, storage);
+        loaded.Lights = SceneArray<Light>::View((const Light*)(data + header.LightOffset), header.LightCount, storage);
+        if(header.NodeCount > 0)
+        {
+            auto bvh = std::make_shared<BVH>();
+            bvh->Load((const BVHNode*)(data + header.NodeOffset), (uint32_t)header.NodeCount,
+                (const uint32_t*)(data + header.PrimitiveIndexOffset), loaded.Spheres);
+            loaded.Acceleration = bvh;
+        }
+
+        scene = std::move(loaded);
+        return true;
+    }
+
+    bool LoadBinary(const std::string& path, Scene& scene)
+    {
+        //The mapping is the storage, it stays open as long as the scene uses it
+        auto file = std::make_shared<MappedFile>();
+        if(!file->Open(path))
+            return false;
+        return ReadBinary(file->GetData(), file->GetSize(), file, scene);
+    }
+
+    bool Load(const std::string& path, Scene& scene)
+    {
+        return Utils::IsBinaryPath(path) ? LoadBinary(path, scene) : LoadText(path, scene);
+    }
+
+    bool Save(const std::string& path, const Scene& scene, const BVH* bvh)
+    {
+        return Utils::IsBinaryPath(path) ? SaveBinary(path, scene, bvh) : SaveText(path, scene);
+    }
+}
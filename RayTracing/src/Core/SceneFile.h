@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "Scene.h"
+
+class BVH;
+
+//Loading and saving scenes, shared by the app and the headless renderer
+namespace SceneFile
+{
+    //Text scene (.rtscene): 1 object per line, # starts a comment, spheres refer to materials by their order in the file
+    //  material <r> <g> <b> <roughness> <metallic> [<emission r> <emission g> <emission b> <emission power>]
+    //  sphere <x> <y> <z> <radius> <material index>
+    //  light directional <direction x> <direction y> <direction z> <r> <g> <b> <intensity>
+    //  light point <x> <y> <z> <r> <g> <b> <intensity>
+    bool LoadText(const std::string& path, Scene& scene);
+    bool SaveText(const std::string& path, const Scene& scene);
+
+    //Binary snapshot (.rtbin): versioned header followed by the Sphere, Material and Light arrays exactly as they are in memory
+    //and optionally a prebuilt BVH, every array 64 byte aligned
+    //Loading memory maps the file and points the scene arrays straight into it: spheres and materials are not parsed or
+    //copied, a stored BVH only needs its leaf ordered sphere arrays refilled (linear, no SAH build)
+    bool SaveBinary(const std::string& path, const Scene& scene, const BVH* bvh = nullptr);
+    bool LoadBinary(const std::string& path, Scene& scene);
+
+    //The same bytes in memory, to send a scene elsewhere than a file (distributed rendering)
+    //Reading points the scene arrays into data, storage is what owns data and is kept alive by them
+    void WriteBinary(const Scene& scene, const BVH* bvh, std::vector<uint8_t>& out);
+    bool ReadBinary(const uint8_t* data, size_t size, std::shared_ptr<const void> storage, Scene& scene);
+
+    //Pick the format from the file extension
+    bool Load(const std::string& path, Scene& scene);
+    bool Save(const std::string& path, const Scene& scene, const BVH* bvh = nullptr);
+}
@@ -0,0 +1,166 @@
+#include "Scenes.h"
+#include "Random.h"
+
+#include <cmath>
+
+namespace Scenes
+{
+    Scene TwoSpheres()
+    {
+        Scene scene;
+
+        Material& pinkSphere = scene.Materials.emplace_back();
+        pinkSphere.Albedo = {1.0f, 0.0f, 1.0f};
+        pinkSphere.Roughness = 0.0f;
+
+        Material& blueSphere = scene.Materials.emplace_back();
+        blueSphere.Albedo = {0.2f, 0.3f, 1.0f};
+        blueSphere.Roughness = 0.1f;
+
+        {
+            Sphere sphere;
+            sphere.Position = {0.0f, 0.0f, 0.0f};
+            sphere.Radius = 1.0f;
+            sphere.MaterialIndex = 0;
+            scene.Spheres.push_back(sphere);
+        }
+
+        {
+            Sphere sphere;
+            sphere.Position = {0.0f, -101.0f, 0.0f};
+            sphere.Radius = 100.0f;
+            sphere.MaterialIndex = 1;
+            scene.Spheres.push_back(sphere);
+        }
+
+        return scene;
+    }
+
+    Scene RandomSpheres(uint32_t count, uint32_t seed)
+    {
+        Scene scene = TwoSpheres();
+        for(uint32_t i = 0; i < 8; i++)
+        {
+            Material& material = scene.Materials.emplace_back();
+            material.Albedo = {0.2f + 0.1f * i, 1.0f - 0.1f * i, 0.5f};
+            material.Roughness = 0.1f * i;
+        }
+
+        //Spread over a square that grows with the count so the density stays about the same
+        Utils::Random random(seed, 0);
+        float extent = 2.0f * std::sqrt((float)count);
+        scene.Spheres.reserve(scene.Spheres.size() + count);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            Sphere sphere;
+            sphere.Radius = 0.1f + 0.2f * random.Float();
+            sphere.Position = {(random.Float() - 0.5f) * extent, sphere.Radius - 1.0f, -random.Float() * extent};
+            sphere.MaterialIndex = 2 + (int)(random.UInt() % 8);
+            scene.Spheres.push_back(sphere);
+        }
+        return scene;
+    }
+
+    Scene RoughSpheres()
+    {
+        Scene scene;
+        Material& rough = scene.Materials.emplace_back();
+        rough.Albedo = {0.8f, 0.4f, 0.3f};
+        rough.Roughness = 1.0f;
+
+        Material& roughGround = scene.Materials.emplace_back();
+        roughGround.Albedo = {0.5f, 0.5f, 0.5f};
+        roughGround.Roughness = 1.0f;
+
+        {
+            Sphere ground;
+            ground.Position = {0.0f, -101.0f, 0.0f};
+            ground.Radius = 100.0f;
+            ground.MaterialIndex = 1;
+            scene.Spheres.push_back(ground);
+        }
+
+        for(int z = 0; z < 4; z++)
+        {
+            for(int x = -3; x <= 3; x++)
+            {
+                Sphere sphere;
+                sphere.Position = {(float)x * 1.2f, -0.5f, -(float)z * 1.2f};
+                sphere.Radius = 0.5f;
+                sphere.MaterialIndex = 0;
+                scene.Spheres.push_back(sphere);
+            }
+        }
+        return scene;
+    }
+
+    Scene MirrorSpheres()
+    {
+        Scene scene;
+        Material& mirror = scene.Materials.emplace_back();
+        mirror.Albedo = {0.9f, 0.9f, 0.9f};
+        mirror.Roughness = 0.0f;
+        mirror.Metallic = 1.0f;
+
+        Material& tinted = scene.Materials.emplace_back();
+        tinted.Albedo = {0.9f, 0.6f, 0.3f};
+        tinted.Roughness = 0.02f;
+        tinted.Metallic = 1.0f;
+
+        //Big spheres on a ring plus one above and below, with small gaps in between
+        const int ringCount = 8;
+        for(int i = 0; i < ringCount; i++)
+        {
+            float angle = 6.2831853f * (float)i / (float)ringCount;
+            Sphere sphere;
+            sphere.Position = {3.0f * std::cos(angle), 0.0f, 3.0f * std::sin(angle)};
+            sphere.Radius = 1.1f;
+            sphere.MaterialIndex = i % 2;
+            scene.Spheres.push_back(sphere);
+        }
+        for(float y : {-3.0f, 3.0f})
+        {
+            Sphere sphere;
+            sphere.Position = {0.0f, y, 0.0f};
+            sphere.Radius = 2.0f;
+            sphere.MaterialIndex = 0;
+            scene.Spheres.push_back(sphere);
+        }
+        return scene;
+    }
+
+    Scene LitSpheres()
+    {
+        Scene scene = RoughSpheres();
+
+        Material& lamp = scene.Materials.emplace_back();
+        lamp.Albedo = {0.0f, 0.0f, 0.0f};
+        lamp.EmissionColor = {1.0f, 0.85f, 0.6f};
+        lamp.EmissionPower = 20.0f;
+        {
+            Sphere sphere;
+            sphere.Position = {-1.5f, 1.5f, -1.0f};
+            sphere.Radius = 0.3f;
+            sphere.MaterialIndex = (int)scene.Materials.size() - 1;
+            scene.Spheres.push_back(sphere);
+        }
+
+        {
+            Light light;
+            light.Type = LightType::Point;
+            light.Position = {2.5f, 1.0f, 0.5f};
+            light.Color = {0.4f, 0.6f, 1.0f};
+            light.Intensity = 3.0f;
+            scene.Lights.push_back(light);
+        }
+        {
+            Light light;
+            light.Type = LightType::Directional;
+            light.Direction = {0.3f, -1.0f, -0.5f};
+            light.Color = {0.7f, 0.8f, 1.0f};
+            light.Intensity = 0.3f;
+            scene.Lights.push_back(light);
+        }
+        return scene;
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "Scene.h"
+
+//Built-in scenes shared by the app and the headless renderer
+namespace Scenes
+{
+    //Pink sphere resting on a big blue "ground" sphere
+    Scene TwoSpheres();
+    //count small spheres scattered over the ground sphere of TwoSpheres, for testing big scenes
+    Scene RandomSpheres(uint32_t count, uint32_t seed = 1);
+    //Rows of fully rough spheres: every bounce scatters in a random direction, so rays lose coherence right away
+    Scene RoughSpheres();
+    //Ring of mirror spheres around the origin (look from the center): most paths bounce the maximum number of times
+    Scene MirrorSpheres();
+    //Spheres lit only by a small emissive sphere, a dim blue point light and a weak "moon" directional light: mostly
+    //shadows and light falling off with distance, where light sampling matters most
+    Scene LitSpheres();
+}
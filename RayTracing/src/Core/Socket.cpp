@@ -0,0 +1,382 @@
+#include "Socket.h"
+
+#include <utility>
+#include <cstring>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #pragma comment(lib, "Ws2_32.lib")
+#else
+    #include <unistd.h>
+    #include <netdb.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <sys/stat.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <cerrno>
+#endif
+
+namespace Utils
+{
+#ifdef _WIN32
+    using NativeSocket = SOCKET;
+#else
+    using NativeSocket = int;
+#endif
+
+    static const char* UnixPrefix = "unix:";
+
+    static bool IsUnixAddress(const std::string& address)
+    {
+        return address.compare(0, strlen(UnixPrefix), UnixPrefix) == 0;
+    }
+
+    //"host:port", the port is after the last : so ipv6 hosts ("[::1]:5000") work too
+    static bool SplitAddress(const std::string& address, std::string& host, std::string& port)
+    {
+        size_t colon = address.find_last_of(':');
+        if(colon == std::string::npos || colon + 1 == address.size())
+            return false;
+        host = address.substr(0, colon);
+        port = address.substr(colon + 1);
+        if(host.size() >= 2 && host.front() == '[' && host.back() == ']')
+            host = host.substr(1, host.size() - 2);
+        if(host == "*")
+            host.clear();
+        return true;
+    }
+
+#ifdef _WIN32
+    //Winsock has to be started once per process before any other call
+    static bool StartSockets()
+    {
+        static bool started = []
+        {
+            WSADATA data;
+            return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+        }();
+        return started;
+    }
+#endif
+
+    //Only small request/response messages, dont let them wait for more data to fill a packet
+    static void DisableNagle(NativeSocket socket)
+    {
+        int enabled = 1;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&enabled, sizeof(enabled));
+    }
+}
+
+Socket::~Socket()
+{
+    Close();
+}
+
+Socket::Socket(Socket&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept
+{
+    if(this == &other)
+        return *this;
+    Close();
+    std::swap(m_Socket, other.m_Socket);
+#ifndef _WIN32
+    std::swap(m_UnixPath, other.m_UnixPath);
+#endif
+    return *this;
+}
+
+#ifdef _WIN32
+bool Socket::IsOpen() const
+{
+    return m_Socket != (uintptr_t)INVALID_SOCKET;
+}
+
+void Socket::Close()
+{
+    if(IsOpen())
+        closesocket((SOCKET)m_Socket);
+    m_Socket = (uintptr_t)INVALID_SOCKET;
+}
+
+bool Socket::Listen(const std::string& address)
+{
+    Close();
+    std::string host, port;
+    if(!Utils::StartSockets() || Utils::IsUnixAddress(address) || !Utils::SplitAddress(address, host, port))
+        return false;
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* result = nullptr;
+    if(getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0)
+        return false;
+
+    for(addrinfo* info = result; info && !IsOpen(); info = info->ai_next)
+    {
+        SOCKET s = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if(s == INVALID_SOCKET)
+            continue;
+        if(bind(s, info->ai_addr, (int)info->ai_addrlen) == 0 && listen(s, SOMAXCONN) == 0)
+            m_Socket = (uintptr_t)s;
+        else
+            closesocket(s);
+    }
+    freeaddrinfo(result);
+    return IsOpen();
+}
+
+bool Socket::Accept(Socket& connection)
+{
+    connection.Close();
+    SOCKET s = accept((SOCKET)m_Socket, nullptr, nullptr);
+    if(s == INVALID_SOCKET)
+        return false;
+    Utils::DisableNagle(s);
+    connection.m_Socket = (uintptr_t)s;
+    return true;
+}
+
+bool Socket::Connect(const std::string& address)
+{
+    Close();
+    std::string host, port;
+    if(!Utils::StartSockets() || Utils::IsUnixAddress(address) || !Utils::SplitAddress(address, host, port))
+        return false;
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if(getaddrinfo(host.empty() ? "localhost" : host.c_str(), port.c_str(), &hints, &result) != 0)
+        return false;
+
+    for(addrinfo* info = result; info && !IsOpen(); info = info->ai_next)
+    {
+        SOCKET s = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if(s == INVALID_SOCKET)
+            continue;
+        if(connect(s, info->ai_addr, (int)info->ai_addrlen) == 0)
+        {
+            Utils::DisableNagle(s);
+            m_Socket = (uintptr_t)s;
+        }
+        else
+            closesocket(s);
+    }
+    freeaddrinfo(result);
+    return IsOpen();
+}
+
+bool Socket::Send(const void* data, size_t size)
+{
+    const char* bytes = (const char*)data;
+    while(size > 0)
+    {
+        int sent = send((SOCKET)m_Socket, bytes, (int)(size < (1u << 30) ? size : (1u << 30)), 0);
+        if(sent <= 0)
+            return false;
+        bytes += sent;
+        size -= (size_t)sent;
+    }
+    return true;
+}
+
+bool Socket::Receive(void* data, size_t size)
+{
+    char* bytes = (char*)data;
+    while(size > 0)
+    {
+        int received = recv((SOCKET)m_Socket, bytes, (int)(size < (1u << 30) ? size : (1u << 30)), 0);
+        if(received <= 0)
+            return false;
+        bytes += received;
+        size -= (size_t)received;
+    }
+    return true;
+}
+#else
+bool Socket::IsOpen() const
+{
+    return m_Socket >= 0;
+}
+
+void Socket::Close()
+{
+    if(IsOpen())
+        close(m_Socket);
+    if(!m_UnixPath.empty())
+        unlink(m_UnixPath.c_str());
+    m_Socket = -1;
+    m_UnixPath.clear();
+}
+
+bool Socket::Listen(const std::string& address)
+{
+    Close();
+    if(Utils::IsUnixAddress(address))
+    {
+        std::string path = address.substr(strlen(Utils::UnixPrefix));
+        sockaddr_un unixAddress = {};
+        unixAddress.sun_family = AF_UNIX;
+        if(path.empty() || path.size() >= sizeof(unixAddress.sun_path))
+            return false;
+        memcpy(unixAddress.sun_path, path.c_str(), path.size() + 1);
+
+        //A socket left over from a coordinator that didnt get to clean up gets replaced, anything else at the path is
+        //somebody's file (a typo in the address) and stays
+        struct stat existing;
+        if(lstat(path.c_str(), &existing) == 0)
+        {
+            if(!S_ISSOCK(existing.st_mode))
+                return false;
+            unlink(path.c_str());
+        }
+
+        m_Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(m_Socket < 0)
+            return false;
+        if(bind(m_Socket, (const sockaddr*)&unixAddress, sizeof(unixAddress)) != 0 || listen(m_Socket, SOMAXCONN) != 0)
+        {
+            Close();
+            return false;
+        }
+        m_UnixPath = path;
+        return true;
+    }
+
+    std::string host, port;
+    if(!Utils::SplitAddress(address, host, port))
+        return false;
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* result = nullptr;
+    if(getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0)
+        return false;
+
+    for(addrinfo* info = result; info && !IsOpen(); info = info->ai_next)
+    {
+        int s = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if(s < 0)
+            continue;
+        //Restarting the coordinator right away shouldnt fail on the old connections still in TIME_WAIT
+        int reuse = 1;
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if(bind(s, info->ai_addr, info->ai_addrlen) == 0 && listen(s, SOMAXCONN) == 0)
+            m_Socket = s;
+        else
+            close(s);
+    }
+    freeaddrinfo(result);
+    return IsOpen();
+}
+
+bool Socket::Accept(Socket& connection)
+{
+    connection.Close();
+    int s = accept(m_Socket, nullptr, nullptr);
+    if(s < 0)
+        return false;
+    if(m_UnixPath.empty())
+        Utils::DisableNagle(s);
+    connection.m_Socket = s;
+    return true;
+}
+
+bool Socket::Connect(const std::string& address)
+{
+    Close();
+    if(Utils::IsUnixAddress(address))
+    {
+        std::string path = address.substr(strlen(Utils::UnixPrefix));
+        sockaddr_un unixAddress = {};
+        unixAddress.sun_family = AF_UNIX;
+        if(path.empty() || path.size() >= sizeof(unixAddress.sun_path))
+            return false;
+        memcpy(unixAddress.sun_path, path.c_str(), path.size() + 1);
+
+        m_Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(m_Socket < 0 || connect(m_Socket, (const sockaddr*)&unixAddress, sizeof(unixAddress)) != 0)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    std::string host, port;
+    if(!Utils::SplitAddress(address, host, port))
+        return false;
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if(getaddrinfo(host.empty() ? "localhost" : host.c_str(), port.c_str(), &hints, &result) != 0)
+        return false;
+
+    for(addrinfo* info = result; info && !IsOpen(); info = info->ai_next)
+    {
+        int s = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if(s < 0)
+            continue;
+        if(connect(s, info->ai_addr, info->ai_addrlen) == 0)
+        {
+            Utils::DisableNagle(s);
+            m_Socket = s;
+        }
+        else
+            close(s);
+    }
+    freeaddrinfo(result);
+    return IsOpen();
+}
+
+bool Socket::Send(const void* data, size_t size)
+{
+    //A worker that died shouldnt take the coordinator down with SIGPIPE, a failed send is enough
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    const uint8_t* bytes = (const uint8_t*)data;
+    while(size > 0)
+    {
+        ssize_t sent = send(m_Socket, bytes, size, flags);
+        if(sent < 0 && errno == EINTR)
+            continue;
+        if(sent <= 0)
+            return false;
+        bytes += sent;
+        size -= (size_t)sent;
+    }
+    return true;
+}
+
+bool Socket::Receive(void* data, size_t size)
+{
+    uint8_t* bytes = (uint8_t*)data;
+    while(size > 0)
+    {
+        ssize_t received = recv(m_Socket, bytes, size, 0);
+        if(received < 0 && errno == EINTR)
+            continue;
+        if(received <= 0)
+            return false;
+        bytes += received;
+        size -= (size_t)received;
+    }
+    return true;
+}
+#endif
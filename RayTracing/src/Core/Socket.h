@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+//Blocking stream socket, just enough for the distributed renderer's coordinator and workers to talk
+//Addresses are "host:port" for TCP ("*:port" or ":port" listens on every interface) or "unix:/path" for a Unix domain
+//socket (not on Windows) - workers on the same machine dont need the network stack
+class Socket
+{
+public:
+    Socket() = default;
+    ~Socket();
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+    Socket(Socket&& other) noexcept;
+    Socket& operator=(Socket&& other) noexcept;
+
+    bool Listen(const std::string& address);
+    //Wait for the next connection to a listening socket
+    bool Accept(Socket& connection);
+    bool Connect(const std::string& address);
+    void Close();
+
+    //Send/receive exactly size bytes, false once the connection is gone
+    bool Send(const void* data, size_t size);
+    bool Receive(void* data, size_t size);
+
+    bool IsOpen() const;
+private:
+#ifdef _WIN32
+    uintptr_t m_Socket = ~(uintptr_t)0; //SOCKET, INVALID_SOCKET when closed
+#else
+    int m_Socket = -1;
+    //Socket file of a listening unix socket, removed again on Close
+    std::string m_UnixPath;
+#endif
+};
@@ -0,0 +1,258 @@
+#include "SphereKernels.h"
+
+#include <cfloat>
+#include <glm/glm.hpp>
+
+#if RT_X86
+    #include <emmintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #endif
+#endif
+
+void SphereSoA::Build(const SceneArray<Sphere>& spheres, const std::vector<uint32_t>* order)
+{
+    Count = order ? (uint32_t)order->size() : (uint32_t)spheres.size();
+    uint32_t paddedCount = (Count + Padding - 1) / Padding * Padding + Padding;
+
+    //Padding: radius^2 of -1 around the origin makes the discriminant negative for every ray
+    X.assign(paddedCount, 0.0f);
+    Y.assign(paddedCount, 0.0f);
+    Z.assign(paddedCount, 0.0f);
+    RadiusSquared.assign(paddedCount, -1.0f);
+    Indices.assign(paddedCount, 0);
+
+    for (uint32_t i = 0; i < Count; i++)
+    {
+        uint32_t index = order ? (*order)[i] : i;
+        Set(i, spheres[index], index);
+    }
+}
+
+namespace SphereKernels
+{
+    /* Fn of circle substituted with values for a and b
+     * (bx^2 + by^2)t^2 + (2(axbx + ayby))t + (ax^2 + ay^2 - r^2) = 0
+     * where
+     * a = origin of ray
+     * b = direction
+     * r = radius
+     * t = hit distance
+     *
+     * All kernels solve this quadratic with b halved:
+     * oc = origin - center, a = dot(d, d), b = dot(oc, d), c = dot(oc, oc) - r^2
+     * discriminant = b^2 - ac, closest t = (-b - sqrt(discriminant)) / a
+     * a only depends on the ray, so it is computed once instead of per sphere, and only the near root gets a square root
+     */
+    void IntersectScalar(const SphereSoA& spheres, uint32_t first, uint32_t count, const Ray& ray, float& hitDistance, int& objectIndex)
+    {
+        const float a = glm::dot(ray.Direction, ray.Direction);
+        const float inverseA = 1.0f / a;
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            float ocX = ray.Origin.x - spheres.X[i];
+            float ocY = ray.Origin.y - spheres.Y[i];
+            float ocZ = ray.Origin.z - spheres.Z[i];
+            float b = ocX * ray.Direction.x + ocY * ray.Direction.y + ocZ * ray.Direction.z;
+            float c = (ocX * ocX + ocY * ocY + ocZ * ocZ) - spheres.RadiusSquared[i];
+            float discriminant = b * b - a * c;
+            if (discriminant < 0.0f)
+                continue;
+
+            float t = (-b - glm::sqrt(discriminant)) * inverseA;
+            if (t > 0.0f && t < hitDistance)
+            {
+                hitDistance = t;
+                objectIndex = (int)spheres.Indices[i];
+            }
+        }
+    }
+
+    //Same hits as IntersectScalar (near root only, t > 0), just no need to find the closest
+    int OccludedScalar(const SphereSoA& spheres, uint32_t first, uint32_t count, const Ray& ray, float maxDistance)
+    {
+        const float a = glm::dot(ray.Direction, ray.Direction);
+        const float inverseA = 1.0f / a;
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            float ocX = ray.Origin.x - spheres.X[i];
+            float ocY = ray.Origin.y - spheres.Y[i];
+            float ocZ = ray.Origin.z - spheres.Z[i];
+            float b = ocX * ray.Direction.x + ocY * ray.Direction.y + ocZ * ray.Direction.z;
+            float c = (ocX * ocX + ocY * ocY + ocZ * ocZ) - spheres.RadiusSquared[i];
+            float discriminant = b * b - a * c;
+            if (discriminant < 0.0f)
+                continue;
+
+            float t = (-b - glm::sqrt(discriminant)) * inverseA;
+            if (t > 0.0f && t < maxDistance)
+                return (int)spheres.Indices[i];
+        }
+        return -1;
+    }
+
+#if RT_X86
+    void IntersectSSE(const SphereSoA& spheres, uint32_t first, uint32_t count, const Ray& ray, float& hitDistance, int& objectIndex)
+    {
+        const float a = glm::dot(ray.Direction, ray.Direction);
+        const __m128 originX = _mm_set1_ps(ray.Origin.x), originY = _mm_set1_ps(ray.Origin.y), originZ = _mm_set1_ps(ray.Origin.z);
+        const __m128 directionX = _mm_set1_ps(ray.Direction.x), directionY = _mm_set1_ps(ray.Direction.y), directionZ = _mm_set1_ps(ray.Direction.z);
+        const __m128 va = _mm_set1_ps(a);
+        const __m128 inverseA = _mm_set1_ps(1.0f / a);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+        const __m128i end = _mm_set1_epi32((int)(first + count));
+
+        //Closest t and its SoA index per lane, reduced across lanes at the end
+        __m128 closestT = _mm_set1_ps(hitDistance);
+        __m128i closestIndex = _mm_set1_epi32(-1);
+
+        for (uint32_t i = first; i < first + count; i += 4)
+        {
+            __m128 ocX = _mm_sub_ps(originX, _mm_loadu_ps(&spheres.X[i]));
+            __m128 ocY = _mm_sub_ps(originY, _mm_loadu_ps(&spheres.Y[i]));
+            __m128 ocZ = _mm_sub_ps(originZ, _mm_loadu_ps(&spheres.Z[i]));
+            __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocX, directionX), _mm_mul_ps(ocY, directionY)), _mm_mul_ps(ocZ, directionZ));
+            __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocX, ocX), _mm_mul_ps(ocY, ocY)), _mm_mul_ps(ocZ, ocZ)),
+                _mm_loadu_ps(&spheres.RadiusSquared[i]));
+            __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(va, c));
+            //sqrt of a negative discriminant gives NaN, those lanes are masked out below
+            __m128 t = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(zero, b), _mm_sqrt_ps(discriminant)), inverseA);
+
+            __m128i index = _mm_add_epi32(_mm_set1_epi32((int)i), laneOffsets);
+            __m128 mask = _mm_and_ps(_mm_cmpge_ps(discriminant, zero), _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, closestT)));
+            //Lanes past the end of the range belong to the next leaf or padding
+            mask = _mm_and_ps(mask, _mm_castsi128_ps(_mm_cmplt_epi32(index, end)));
+
+            closestT = _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, closestT));
+            closestIndex = _mm_or_si128(_mm_and_si128(_mm_castps_si128(mask), index), _mm_andnot_si128(_mm_castps_si128(mask), closestIndex));
+        }
+
+        //Masked min reduction across the 4 lanes, ties go to the lowest index like the scalar loop
+        alignas(16) float lanesT[4];
+        alignas(16) int lanesIndex[4];
+        _mm_store_ps(lanesT, closestT);
+        _mm_store_si128((__m128i*)lanesIndex, closestIndex);
+        for (int lane = 0; lane < 4; lane++)
+        {
+            if (lanesIndex[lane] < 0)
+                continue;
+            if (lanesT[lane] < hitDistance || (lanesT[lane] == hitDistance && (int)spheres.Indices[lanesIndex[lane]] < objectIndex))
+            {
+                hitDistance = lanesT[lane];
+                objectIndex = (int)spheres.Indices[lanesIndex[lane]];
+            }
+        }
+    }
+
+    int OccludedSSE(const SphereSoA& spheres, uint32_t first, uint32_t count, const Ray& ray, float maxDistance)
+    {
+        const float a = glm::dot(ray.Direction, ray.Direction);
+        const __m128 originX = _mm_set1_ps(ray.Origin.x), originY = _mm_set1_ps(ray.Origin.y), originZ = _mm_set1_ps(ray.Origin.z);
+        const __m128 directionX = _mm_set1_ps(ray.Direction.x), directionY = _mm_set1_ps(ray.Direction.y), directionZ = _mm_set1_ps(ray.Direction.z);
+        const __m128 va = _mm_set1_ps(a);
+        const __m128 inverseA = _mm_set1_ps(1.0f / a);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 vMaxDistance = _mm_set1_ps(maxDistance);
+        const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+        const __m128i end = _mm_set1_epi32((int)(first + count));
+
+        for (uint32_t i = first; i < first + count; i += 4)
+        {
+            __m128 ocX = _mm_sub_ps(originX, _mm_loadu_ps(&spheres.X[i]));
+            __m128 ocY = _mm_sub_ps(originY, _mm_loadu_ps(&spheres.Y[i]));
+            __m128 ocZ = _mm_sub_ps(originZ, _mm_loadu_ps(&spheres.Z[i]));
+            __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocX, directionX), _mm_mul_ps(ocY, directionY)), _mm_mul_ps(ocZ, directionZ));
+            __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocX, ocX), _mm_mul_ps(ocY, ocY)), _mm_mul_ps(ocZ, ocZ)),
+                _mm_loadu_ps(&spheres.RadiusSquared[i]));
+            __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(va, c));
+            __m128 t = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(zero, b), _mm_sqrt_ps(discriminant)), inverseA);
+
+            __m128i index = _mm_add_epi32(_mm_set1_epi32((int)i), laneOffsets);
+            __m128 mask = _mm_and_ps(_mm_cmpge_ps(discriminant, zero), _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, vMaxDistance)));
+            mask = _mm_and_ps(mask, _mm_castsi128_ps(_mm_cmplt_epi32(index, end)));
+            int hits = _mm_movemask_ps(mask);
+            if (hits != 0)
+            {
+                uint32_t lane = 0;
+                while (!(hits & (1 << lane)))
+                    lane++;
+                return (int)spheres.Indices[i + lane];
+            }
+        }
+        return -1;
+    }
+
+    static bool CpuSupportsAVX2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        //AVX needs OS support for saving the ymm registers (OSXSAVE + XCR0)
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    SIMDLevel GetSupportedLevel()
+    {
+#if RT_X86
+        //SSE2 is part of x64, only AVX2 needs checking
+        static const SIMDLevel level = CpuSupportsAVX2() ? SIMDLevel::AVX2 : SIMDLevel::SSE;
+        return level;
+#else
+        return SIMDLevel::Scalar;
+#endif
+    }
+
+    const char* GetLevelName(SIMDLevel level)
+    {
+        switch (level)
+        {
+        case SIMDLevel::Scalar: return "Scalar";
+        case SIMDLevel::SSE: return "SSE";
+        case SIMDLevel::AVX2: return "AVX2";
+        }
+        return "Unknown";
+    }
+
+    IntersectFunction Get(SIMDLevel level)
+    {
+        if ((int)level > (int)GetSupportedLevel())
+            level = GetSupportedLevel();
+
+        switch (level)
+        {
+#if RT_X86
+        case SIMDLevel::AVX2: return IntersectAVX2;
+        case SIMDLevel::SSE: return IntersectSSE;
+#endif
+        default: return IntersectScalar;
+        }
+    }
+
+    OccludedFunction GetOccluded(SIMDLevel level)
+    {
+        if ((int)level > (int)GetSupportedLevel())
+            level = GetSupportedLevel();
+
+        switch (level)
+        {
+#if RT_X86
+        case SIMDLevel::AVX2: return OccludedAVX2;
+        case SIMDLevel::SSE: return OccludedSSE;
+#endif
+        default: return OccludedScalar;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Ray.h"
+#include "Scene.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define RT_X86 1
+#else
+    #define RT_X86 0
+#endif
+
+//Widest sphere kernel the cpu can run, picked at runtime
+enum class SIMDLevel
+{
+    Scalar = 0, SSE, AVX2
+};
+
+//Structure of arrays mirror of Scene::Spheres: 1 array per component so a SIMD register can load the same component
+//of 4 (SSE) or 8 (AVX2) spheres at once
+//Arrays are padded to SphereSoA::Padding with spheres that can never be hit, so kernels can always load full registers
+struct SphereSoA
+{
+    static constexpr uint32_t Padding = 8;
+
+    std::vector<float> X, Y, Z;
+    std::vector<float> RadiusSquared;
+    //Index into Scene::Spheres for every entry
+    std::vector<uint32_t> Indices;
+    uint32_t Count = 0;
+
+    //order = optional sphere index per entry (e.g. BVH leaf order), defaults to scene order
+    void Build(const SceneArray<Sphere>& spheres, const std::vector<uint32_t>* order = nullptr);
+    //Overwrite entry with sphere (scene index index)
+    void Set(uint32_t entry, const Sphere& sphere, uint32_t index)
+    {
+        X[entry] = sphere.Position.x;
+        Y[entry] = sphere.Position.y;
+        Z[entry] = sphere.Position.z;
+        RadiusSquared[entry] = sphere.Radius * sphere.Radius;
+        Indices[entry] = index;
+    }
+};
+
+namespace SphereKernels
+{
+    //Closest hit against spheres [first, first + count) of the SoA, only hits closer than hitDistance count
+    //Updates hitDistance and objectIndex (index into Scene::Spheres) when a closer hit is found
+    using IntersectFunction = void(*)(const SphereSoA& spheres, uint32_t first, uint32_t count, const Ray& ray, float& hitDistance, int& objectIndex);
+    //Any hit closer than maxDistance among spheres [first, first + count), for shadow rays: no closest hit to keep track
+    //of, stops at the first group of spheres with a hit
+    //Returns the sphere in the way (index into Scene::Spheres, the first one of its group), -1 when there is none
+    using OccludedFunction = int(*)(const SphereSoA& spheres, uint32_t first, uint32_t count, const Ray& ray, float maxDistance);
+
+    SIMDLevel GetSupportedLevel();
+    const char* GetLevelName(SIMDLevel level);
+    //Kernel for the requested level - falls back to the best supported level below it
+    IntersectFunction Get(SIMDLevel level);
+    OccludedFunction GetOccluded(SIMDLevel level);
+
+    void IntersectScalar(const SphereSoA& spheres, uint32_t first, uint32_t count, const Ray& ray, float& hitDistance, int& objectIndex);
+    int OccludedScalar(const SphereSoA& spheres, uint32_t first, uint32_t count, const Ray& ray, float maxDistance);
+#if RT_X86
+    void IntersectSSE(const SphereSoA& spheres, uint32_t first, uint32_t count, const Ray& ray, float& hitDistance, int& objectIndex);
+    int OccludedSSE(const SphereSoA& spheres, uint32_t first, uint32_t count, const Ray& ray, float maxDistance);
+    //Live in their own file, built with AVX2 code generation - only call when GetSupportedLevel() says so
+    void IntersectAVX2(const SphereSoA& spheres, uint32_t first, uint32_t count, const Ray& ray, float& hitDistance, int& objectIndex);
+    int OccludedAVX2(const SphereSoA& spheres, uint32_t first, uint32_t count, const Ray& ray, float maxDistance);
+#endif
+}
@@ -0,0 +1,106 @@
+#include "SphereKernels.h"
+
+//Built with AVX2 code generation (see premake5.lua), so nothing in here may run before checking GetSupportedLevel()
+#if RT_X86
+#include <immintrin.h>
+#include <glm/glm.hpp>
+
+namespace SphereKernels
+{
+    //Same math as IntersectSSE, 8 spheres per iteration
+    void IntersectAVX2(const SphereSoA& spheres, uint32_t first, uint32_t count, const Ray& ray, float& hitDistance, int& objectIndex)
+    {
+        const float a = glm::dot(ray.Direction, ray.Direction);
+        const __m256 originX = _mm256_set1_ps(ray.Origin.x), originY = _mm256_set1_ps(ray.Origin.y), originZ = _mm256_set1_ps(ray.Origin.z);
+        const __m256 directionX = _mm256_set1_ps(ray.Direction.x), directionY = _mm256_set1_ps(ray.Direction.y), directionZ = _mm256_set1_ps(ray.Direction.z);
+        const __m256 va = _mm256_set1_ps(a);
+        const __m256 inverseA = _mm256_set1_ps(1.0f / a);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i end = _mm256_set1_epi32((int)(first + count));
+
+        __m256 closestT = _mm256_set1_ps(hitDistance);
+        __m256i closestIndex = _mm256_set1_epi32(-1);
+
+        for (uint32_t i = first; i < first + count; i += 8)
+        {
+            __m256 ocX = _mm256_sub_ps(originX, _mm256_loadu_ps(&spheres.X[i]));
+            __m256 ocY = _mm256_sub_ps(originY, _mm256_loadu_ps(&spheres.Y[i]));
+            __m256 ocZ = _mm256_sub_ps(originZ, _mm256_loadu_ps(&spheres.Z[i]));
+            __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocX, directionX), _mm256_mul_ps(ocY, directionY)), _mm256_mul_ps(ocZ, directionZ));
+            __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocX, ocX), _mm256_mul_ps(ocY, ocY)), _mm256_mul_ps(ocZ, ocZ)),
+                _mm256_loadu_ps(&spheres.RadiusSquared[i]));
+            __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(va, c));
+            __m256 t = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(zero, b), _mm256_sqrt_ps(discriminant)), inverseA);
+
+            __m256i index = _mm256_add_epi32(_mm256_set1_epi32((int)i), laneOffsets);
+            __m256 mask = _mm256_and_ps(_mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ),
+                _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GT_OQ), _mm256_cmp_ps(t, closestT, _CMP_LT_OQ)));
+            mask = _mm256_and_ps(mask, _mm256_castsi256_ps(_mm256_cmpgt_epi32(end, index)));
+
+            closestT = _mm256_blendv_ps(closestT, t, mask);
+            closestIndex = _mm256_blendv_epi8(closestIndex, index, _mm256_castps_si256(mask));
+        }
+
+        //No lane hit anything closer: nothing to reduce
+        __m256i hitLanes = _mm256_cmpgt_epi32(closestIndex, _mm256_set1_epi32(-1));
+        if (_mm256_movemask_ps(_mm256_castsi256_ps(hitLanes)) == 0)
+            return;
+
+        alignas(32) float lanesT[8];
+        alignas(32) int lanesIndex[8];
+        _mm256_store_ps(lanesT, closestT);
+        _mm256_store_si256((__m256i*)lanesIndex, closestIndex);
+        for (int lane = 0; lane < 8; lane++)
+        {
+            if (lanesIndex[lane] < 0)
+                continue;
+            if (lanesT[lane] < hitDistance || (lanesT[lane] == hitDistance && (int)spheres.Indices[lanesIndex[lane]] < objectIndex))
+            {
+                hitDistance = lanesT[lane];
+                objectIndex = (int)spheres.Indices[lanesIndex[lane]];
+            }
+        }
+    }
+
+    //Same math as OccludedSSE, 8 spheres per iteration
+    int OccludedAVX2(const SphereSoA& spheres, uint32_t first, uint32_t count, const Ray& ray, float maxDistance)
+    {
+        const float a = glm::dot(ray.Direction, ray.Direction);
+        const __m256 originX = _mm256_set1_ps(ray.Origin.x), originY = _mm256_set1_ps(ray.Origin.y), originZ = _mm256_set1_ps(ray.Origin.z);
+        const __m256 directionX = _mm256_set1_ps(ray.Direction.x), directionY = _mm256_set1_ps(ray.Direction.y), directionZ = _mm256_set1_ps(ray.Direction.z);
+        const __m256 va = _mm256_set1_ps(a);
+        const __m256 inverseA = _mm256_set1_ps(1.0f / a);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 vMaxDistance = _mm256_set1_ps(maxDistance);
+        const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i end = _mm256_set1_epi32((int)(first + count));
+
+        for (uint32_t i = first; i < first + count; i += 8)
+        {
+            __m256 ocX = _mm256_sub_ps(originX, _mm256_loadu_ps(&spheres.X[i]));
+            __m256 ocY = _mm256_sub_ps(originY, _mm256_loadu_ps(&spheres.Y[i]));
+            __m256 ocZ = _mm256_sub_ps(originZ, _mm256_loadu_ps(&spheres.Z[i]));
+            __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocX, directionX), _mm256_mul_ps(ocY, directionY)), _mm256_mul_ps(ocZ, directionZ));
+            __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocX, ocX), _mm256_mul_ps(ocY, ocY)), _mm256_mul_ps(ocZ, ocZ)),
+                _mm256_loadu_ps(&spheres.RadiusSquared[i]));
+            __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(va, c));
+            __m256 t = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(zero, b), _mm256_sqrt_ps(discriminant)), inverseA);
+
+            __m256i index = _mm256_add_epi32(_mm256_set1_epi32((int)i), laneOffsets);
+            __m256 mask = _mm256_and_ps(_mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ),
+                _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GT_OQ), _mm256_cmp_ps(t, vMaxDistance, _CMP_LT_OQ)));
+            mask = _mm256_and_ps(mask, _mm256_castsi256_ps(_mm256_cmpgt_epi32(end, index)));
+            int hits = _mm256_movemask_ps(mask);
+            if (hits != 0)
+            {
+                uint32_t lane = 0;
+                while (!(hits & (1 << lane)))
+                    lane++;
+                return (int)spheres.Indices[i + lane];
+            }
+        }
+        return -1;
+    }
+}
+#endif
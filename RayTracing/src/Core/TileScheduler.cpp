@@ -0,0 +1,256 @@
+#include "TileScheduler.h"
+
+#include <algorithm>
+
+namespace Utils
+{
+    //Interleave the bits of x and y: z-order curve
+    static uint32_t MortonIndex(uint32_t x, uint32_t y)
+    {
+        uint32_t index = 0;
+        for (uint32_t bit = 0; bit < 16; bit++)
+            index |= ((x >> bit) & 1u) << (2 * bit) | ((y >> bit) & 1u) << (2 * bit + 1);
+        return index;
+    }
+
+    //Position along a hilbert curve covering a n x n grid (n power of 2)
+    //Unlike morton, consecutive tiles are always direct neighbours
+    static uint32_t HilbertIndex(uint32_t n, uint32_t x, uint32_t y)
+    {
+        uint32_t index = 0;
+        for (uint32_t s = n / 2; s > 0; s /= 2)
+        {
+            uint32_t rx = (x & s) > 0;
+            uint32_t ry = (y & s) > 0;
+            index += s * s * ((3 * rx) ^ ry);
+            //Rotate the quadrant so the curve stays continuous
+            if (ry == 0)
+            {
+                if (rx == 1)
+                {
+                    x = s - 1 - x;
+                    y = s - 1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return index;
+    }
+}
+
+TileScheduler::~TileScheduler()
+{
+    StopThreads();
+}
+
+void TileScheduler::SetThreadCount(uint32_t count)
+{
+    if (count == 0)
+        count = std::max(1u, std::thread::hardware_concurrency());
+    if (count == GetThreadCount())
+        return;
+
+    StopThreads();
+    StartThreads(count);
+}
+
+void TileScheduler::StartThreads(uint32_t count)
+{
+    m_Stop = false;
+    for (uint32_t i = 0; i < count; i++)
+        m_Queues.push_back(std::make_unique<WorkQueue>());
+    //Thread 0 is whoever calls Run
+    //New threads wait for the next Run: m_Generation keeps counting across thread count changes, a thread starting
+    //from 0 would take the last Run for a new one
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        generation = m_Generation;
+    }
+    for (uint32_t i = 1; i < count; i++)
+        m_Threads.emplace_back(&TileScheduler::WorkerLoop, this, i, generation);
+}
+
+void TileScheduler::StopThreads()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_WakeCondition.notify_all();
+    for (std::thread& thread : m_Threads)
+        thread.join();
+    m_Threads.clear();
+    m_Queues.clear();
+}
+
+void TileScheduler::Run(const std::vector<Tile>& tiles, const TileFunction& function)
+{
+    if (m_Queues.empty())
+        SetThreadCount(0);
+
+    //Hand every thread a contiguous run of tiles - with a space filling order that is a compact region of the image
+    uint32_t threadCount = GetThreadCount();
+    for (uint32_t t = 0; t < threadCount; t++)
+    {
+        size_t begin = tiles.size() * t / threadCount;
+        size_t end = tiles.size() * (t + 1) / threadCount;
+        WorkQueue& queue = *m_Queues[t];
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        for (size_t i = begin; i < end; i++)
+            queue.Tiles.push_back((uint32_t)i);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Tiles = &tiles;
+        m_Function = &function;
+        m_BusyWorkers = threadCount - 1;
+        m_Generation++;
+    }
+    m_WakeCondition.notify_all();
+
+    Execute(0);
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_DoneCondition.wait(lock, [this]() { return m_BusyWorkers == 0; });
+    m_Tiles = nullptr;
+    m_Function = nullptr;
+}
+
+void TileScheduler::ParallelFor(uint32_t count, uint32_t rangeSize, const RangeFunction& function)
+{
+    //A range is a 1 pixel high tile, so it gets the same scheduling (and stealing) as image tiles
+    std::vector<Tile> ranges;
+    for (uint32_t begin = 0; begin < count; begin += rangeSize)
+    {
+        Tile range;
+        range.X = begin;
+        range.Width = std::min(rangeSize, count - begin);
+        range.Height = 1;
+        range.Index = (uint32_t)ranges.size();
+        ranges.push_back(range);
+    }
+
+    Run(ranges, [&function](const Tile& range, uint32_t threadIndex)
+    {
+        function(range.X, range.X + range.Width, threadIndex);
+    });
+}
+
+void TileScheduler::WorkerLoop(uint32_t threadIndex, uint64_t generation)
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_WakeCondition.wait(lock, [&]() { return m_Stop || m_Generation != generation; });
+            if (m_Stop)
+                return;
+            generation = m_Generation;
+        }
+
+        Execute(threadIndex);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_BusyWorkers--;
+        }
+        m_DoneCondition.notify_one();
+    }
+}
+
+void TileScheduler::Execute(uint32_t threadIndex)
+{
+    uint32_t tileIndex;
+    while (PopTile(threadIndex, tileIndex))
+        (*m_Function)((*m_Tiles)[tileIndex], threadIndex);
+}
+
+bool TileScheduler::PopTile(uint32_t threadIndex, uint32_t& tileIndex)
+{
+    //Own work first, from the front: next tile along the curve
+    {
+        WorkQueue& queue = *m_Queues[threadIndex];
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        if (!queue.Tiles.empty())
+        {
+            tileIndex = queue.Tiles.front();
+            queue.Tiles.pop_front();
+            return true;
+        }
+    }
+
+    //Steal from the back of someone else's queue: the tile furthest away from what its owner is working on
+    //No tiles get added during a Run, so once every queue is empty we are done
+    uint32_t threadCount = GetThreadCount();
+    for (uint32_t i = 1; i < threadCount; i++)
+    {
+        WorkQueue& victim = *m_Queues[(threadIndex + i) % threadCount];
+        std::lock_guard<std::mutex> lock(victim.Mutex);
+        if (!victim.Tiles.empty())
+        {
+            tileIndex = victim.Tiles.back();
+            victim.Tiles.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+Tile TileScheduler::Unite(const Tile& a, const Tile& b)
+{
+    if (b.Width == 0 || b.Height == 0)
+        return a;
+    if (a.Width == 0 || a.Height == 0)
+        return { b.X, b.Y, b.Width, b.Height, 0 };
+
+    uint32_t x0 = std::min(a.X, b.X), y0 = std::min(a.Y, b.Y);
+    uint32_t x1 = std::max(a.X + a.Width, b.X + b.Width), y1 = std::max(a.Y + a.Height, b.Y + b.Height);
+    return { x0, y0, x1 - x0, y1 - y0, 0 };
+}
+
+std::vector<Tile> TileScheduler::CreateTiles(uint32_t width, uint32_t height, uint32_t tileSize, TileOrder order)
+{
+    std::vector<Tile> tiles;
+    if (width == 0 || height == 0 || tileSize == 0)
+        return tiles;
+
+    uint32_t tilesX = (width + tileSize - 1) / tileSize;
+    uint32_t tilesY = (height + tileSize - 1) / tileSize;
+    std::vector<std::pair<uint32_t, Tile>> ordered;
+    ordered.reserve(tilesX * tilesY);
+
+    //Curves are defined on a power of 2 square, tiles outside the image are simply not there
+    uint32_t gridSize = 1;
+    while (gridSize < std::max(tilesX, tilesY))
+        gridSize *= 2;
+
+    for (uint32_t ty = 0; ty < tilesY; ty++)
+    {
+        for (uint32_t tx = 0; tx < tilesX; tx++)
+        {
+            Tile tile;
+            tile.X = tx * tileSize;
+            tile.Y = ty * tileSize;
+            tile.Width = std::min(tileSize, width - tile.X);
+            tile.Height = std::min(tileSize, height - tile.Y);
+
+            uint32_t key = tx + ty * tilesX;
+            if (order == TileOrder::Morton)
+                key = Utils::MortonIndex(tx, ty);
+            else if (order == TileOrder::Hilbert)
+                key = Utils::HilbertIndex(gridSize, tx, ty);
+            ordered.push_back({ key, tile });
+        }
+    }
+
+    std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    tiles.reserve(ordered.size());
+    for (const auto& entry : ordered)
+    {
+        tiles.push_back(entry.second);
+        tiles.back().Index = (uint32_t)tiles.size() - 1;
+    }
+    return tiles;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <functional>
+#include <condition_variable>
+#include <cstdint>
+
+//Rectangle of pixels that gets rendered by 1 thread in one go
+struct Tile
+{
+    uint32_t X = 0, Y = 0;
+    uint32_t Width = 0, Height = 0;
+    //Position in the list of tiles, for per tile data
+    uint32_t Index = 0;
+};
+
+//Order tiles get handed out in - space filling curves keep consecutive tiles (and so a thread's tiles) next to each other
+enum class TileOrder
+{
+    Scanline = 0, Morton, Hilbert
+};
+
+//Persistent pool of render threads working through a list of tiles
+//Every thread starts with its own deque of neighbouring tiles and takes from the front, threads that run out of work
+//steal from the back of other deques, so expensive regions get spread over all threads
+class TileScheduler
+{
+public:
+    //threadIndex is in [0, GetThreadCount()), unique for the threads running at the same time
+    using TileFunction = std::function<void(const Tile& tile, uint32_t threadIndex)>;
+    using RangeFunction = std::function<void(uint32_t begin, uint32_t end, uint32_t threadIndex)>;
+
+    TileScheduler() = default;
+    ~TileScheduler();
+    TileScheduler(const TileScheduler&) = delete;
+    TileScheduler& operator=(const TileScheduler&) = delete;
+
+    //0 = 1 thread per core, the calling thread counts as 1 of them
+    void SetThreadCount(uint32_t count);
+    uint32_t GetThreadCount() const { return (uint32_t)m_Queues.size(); }
+
+    //Run function for every tile and wait for all of them to finish
+    void Run(const std::vector<Tile>& tiles, const TileFunction& function);
+    //Run function for [0, count) split in ranges of rangeSize (range i starts at i * rangeSize) - for loops over flat buffers
+    void ParallelFor(uint32_t count, uint32_t rangeSize, const RangeFunction& function);
+
+    static std::vector<Tile> CreateTiles(uint32_t width, uint32_t height, uint32_t tileSize, TileOrder order);
+    //Smallest rectangle covering both, a tile of width or height 0 covers nothing
+    static Tile Unite(const Tile& a, const Tile& b);
+private:
+    void StartThreads(uint32_t count);
+    void StopThreads();
+    void WorkerLoop(uint32_t threadIndex, uint64_t generation);
+    void Execute(uint32_t threadIndex);
+    bool PopTile(uint32_t threadIndex, uint32_t& tileIndex);
+private:
+    struct WorkQueue
+    {
+        std::mutex Mutex;
+        std::deque<uint32_t> Tiles;
+    };
+
+    std::vector<std::thread> m_Threads;
+    std::vector<std::unique_ptr<WorkQueue>> m_Queues;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_WakeCondition, m_DoneCondition;
+    uint64_t m_Generation = 0;
+    uint32_t m_BusyWorkers = 0;
+    bool m_Stop = false;
+
+    const std::vector<Tile>* m_Tiles = nullptr;
+    const TileFunction* m_Function = nullptr;
+};
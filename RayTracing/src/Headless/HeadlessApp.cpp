@@ -0,0 +1,398 @@
+#include "Renderer.h"
+#include "Camera.h"
+#include "Scenes.h"
+#include "ImageWriter.h"
+#include "SceneFile.h"
+#include "Profiler.h"
+#include "DistributedRenderer.h"
+#include "Checkpoint.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+//Offline renderer: no window, no Vulkan - renders a scene straight to a file
+//Usage: RayTracingHeadless [--width N] [--height N] [--samples N] [--output file.(ppm|png|exr)]
+//                          [--position x y z] [--direction x y z] [--packets] [--no-bvh] [--threads N]
+//                          [--cached-rays] [--no-jitter] [--adaptive threshold] [--wavefront] [--denoise]
+//                          [--max-bounces N] [--no-roulette] [--no-nee] [--frame-budget ms] [--srgb]
+//                          [--scene file.(rtscene|rtbin) | --random-spheres N | --lit-spheres] [--save-scene file.(rtscene|rtbin)]
+//                          [--trace file.json] [--coordinator address --workers N [--worker-tile-size N]]
+//                          [--checkpoint file.rtcheckpoint [--checkpoint-interval seconds] [--resume]]
+//       RayTracingHeadless --worker address [--threads N]
+//Addresses are host:port or unix:/path, see Socket
+
+struct HeadlessOptions
+{
+    uint32_t Width = 1280;
+    uint32_t Height = 720;
+    uint32_t Samples = 64;
+    std::string Output = "render.png";
+    glm::vec3 Position{ 0.0f, 0.0f, 5.0f };
+    glm::vec3 Direction{ 0.0f, 0.0f, -1.0f };
+    //Built-in two sphere scene when none is set
+    std::string ScenePath;
+    uint32_t RandomSpheres = 0;
+    bool LitSpheres = false;
+    //Write the scene (with its BVH for .rtbin) before rendering
+    std::string SaveScenePath;
+    //Chrome trace of every frame, empty = no trace
+    std::string TracePath;
+    //Distributed rendering: listen on CoordinatorAddress and split the image over Workers worker processes
+    std::string CoordinatorAddress;
+    uint32_t Workers = 1;
+    uint32_t WorkerTileSize = 128;
+    //Write the accumulation state every CheckpointInterval seconds, on SIGINT/SIGTERM and at the end
+    //Resume continues from the checkpoint when there is one for this scene and camera
+    std::string CheckpointPath;
+    float CheckpointInterval = 60.0f;
+    bool Resume = false;
+    //Run as a worker of the coordinator at this address instead of rendering anything itself
+    std::string WorkerAddress;
+    Renderer::Settings Settings;
+};
+
+static void PrintUsage()
+{
+    printf("Usage: RayTracingHeadless [--width N] [--height N] [--samples N] [--output file.(ppm|png|exr)]\n"
+           "                          [--position x y z] [--direction x y z] [--packets] [--no-bvh] [--threads N]\n"
+           "                          [--cached-rays] [--no-jitter] [--adaptive threshold] [--wavefront] [--denoise]\n"
+           "                          [--max-bounces N] [--no-roulette] [--no-nee] [--frame-budget ms] [--srgb]\n"
+           "                          [--scene file.(rtscene|rtbin) | --random-spheres N | --lit-spheres] [--save-scene file.(rtscene|rtbin)]\n"
+           "                          [--trace file.json] [--coordinator address --workers N [--worker-tile-size N]]\n"
+           "                          [--checkpoint file.rtcheckpoint [--checkpoint-interval seconds] [--resume]]\n"
+           "       RayTracingHeadless --worker address [--threads N]\n");
+}
+
+static bool ParseArguments(int argc, char** argv, HeadlessOptions& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        //Every option takes at least 1 value
+        auto hasValues = [&](int count) { return i + count < argc; };
+
+        if(arg == "--width" && hasValues(1))
+            options.Width = (uint32_t)atoi(argv[++i]);
+        else if(arg == "--height" && hasValues(1))
+            options.Height = (uint32_t)atoi(argv[++i]);
+        else if(arg == "--samples" && hasValues(1))
+            options.Samples = (uint32_t)atoi(argv[++i]);
+        else if(arg == "--output" && hasValues(1))
+            options.Output = argv[++i];
+        else if(arg == "--position" && hasValues(3))
+        {
+            for(int c = 0; c < 3; c++)
+                options.Position[c] = (float)atof(argv[++i]);
+        }
+        else if(arg == "--direction" && hasValues(3))
+        {
+            for(int c = 0; c < 3; c++)
+                options.Direction[c] = (float)atof(argv[++i]);
+        }
+        else if(arg == "--scene" && hasValues(1))
+            options.ScenePath = argv[++i];
+        else if(arg == "--random-spheres" && hasValues(1))
+            options.RandomSpheres = (uint32_t)atoi(argv[++i]);
+        else if(arg == "--lit-spheres")
+            options.LitSpheres = true;
+        else if(arg == "--save-scene" && hasValues(1))
+            options.SaveScenePath = argv[++i];
+        else if(arg == "--trace" && hasValues(1))
+            options.TracePath = argv[++i];
+        else if(arg == "--coordinator" && hasValues(1))
+            options.CoordinatorAddress = argv[++i];
+        else if(arg == "--workers" && hasValues(1))
+            options.Workers = (uint32_t)atoi(argv[++i]);
+        else if(arg == "--worker-tile-size" && hasValues(1))
+            options.WorkerTileSize = (uint32_t)atoi(argv[++i]);
+        else if(arg == "--checkpoint" && hasValues(1))
+            options.CheckpointPath = argv[++i];
+        else if(arg == "--checkpoint-interval" && hasValues(1))
+            options.CheckpointInterval = (float)atof(argv[++i]);
+        else if(arg == "--resume")
+            options.Resume = true;
+        else if(arg == "--worker" && hasValues(1))
+            options.WorkerAddress = argv[++i];
+        else if(arg == "--threads" && hasValues(1))
+            options.Settings.ThreadCount = (uint32_t)atoi(argv[++i]);
+        else if(arg == "--cached-rays")
+            options.Settings.CachedRayDirections = true;
+        else if(arg == "--no-jitter")
+            options.Settings.Jitter = false;
+        else if(arg == "--adaptive" && hasValues(1))
+        {
+            options.Settings.Adaptive = true;
+            options.Settings.AdaptiveThreshold = (float)atof(argv[++i]);
+        }
+        else if(arg == "--wavefront")
+            options.Settings.Wavefront = true;
+        else if(arg == "--denoise")
+            options.Settings.Denoise = true;
+        else if(arg == "--max-bounces" && hasValues(1))
+            options.Settings.MaxBounces = (uint32_t)glm::max(atoi(argv[++i]), 1);
+        else if(arg == "--no-roulette")
+            options.Settings.RussianRoulette = false;
+        else if(arg == "--no-nee")
+            options.Settings.NextEventEstimation = false;
+        else if(arg == "--srgb")
+            options.Settings.OutputEncoding = ImageResolve::Encoding::SRGB;
+        else if(arg == "--frame-budget" && hasValues(1))
+        {
+            options.Settings.FrameTimeBudget = true;
+            options.Settings.TargetFrameTime = (float)atof(argv[++i]);
+        }
+        else if(arg == "--packets")
+            options.Settings.PacketTracing = true;
+        else if(arg == "--no-bvh")
+            options.Settings.UseBVH = false;
+        else
+            return false;
+    }
+    //--scene, --random-spheres and --lit-spheres all pick the scene, only 1 of them can
+    int sceneSources = (int)!options.ScenePath.empty() + (int)(options.RandomSpheres > 0) + (int)options.LitSpheres;
+    return options.Width > 0 && options.Height > 0 && options.Samples > 0 && options.Workers > 0 && sceneSources <= 1 &&
+        (!options.Resume || !options.CheckpointPath.empty());
+}
+
+//Set by SIGINT/SIGTERM (preemption): finish the frame, write a checkpoint and exit
+static volatile std::sig_atomic_t s_StopRequested = 0;
+
+static void RequestStop(int)
+{
+    s_StopRequested = 1;
+}
+
+//Worker process: everything it renders comes from the coordinator
+static int RunWorker(const HeadlessOptions& options)
+{
+    RenderWorker worker;
+    if(!worker.Connect(options.WorkerAddress))
+    {
+        fprintf(stderr, "Failed to connect to %s\n", options.WorkerAddress.c_str());
+        return 1;
+    }
+    printf("Connected to %s\n", options.WorkerAddress.c_str());
+    bool finished = worker.Run(options.Settings.ThreadCount);
+    printf("%s after %u tiles\n", finished ? "Done" : "Lost the coordinator", worker.GetTilesRendered());
+    return finished ? 0 : 1;
+}
+
+static int RenderDistributed(const HeadlessOptions& options, const Scene& scene, const Camera& camera)
+{
+    RenderCoordinator coordinator;
+    if(!coordinator.Listen(options.CoordinatorAddress))
+    {
+        fprintf(stderr, "Failed to listen on %s\n", options.CoordinatorAddress.c_str());
+        return 1;
+    }
+    printf("Waiting for %u workers on %s\n", options.Workers, options.CoordinatorAddress.c_str());
+    if(!coordinator.AcceptWorkers(options.Workers))
+    {
+        fprintf(stderr, "Failed to connect %u workers (same build?)\n", options.Workers);
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    bool rendered = coordinator.Render(scene, camera, options.Settings, options.Samples, options.WorkerTileSize);
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    if(!rendered)
+    {
+        fprintf(stderr, "Every worker disconnected before the image was done\n");
+        return 1;
+    }
+
+    uint64_t totalSamples = 0;
+    for(uint32_t i = 0; i < options.Width * options.Height; i++)
+        totalSamples += coordinator.GetSampleCounts()[i];
+    printf("Rendered %ux%u on %u workers (%.2f samples/pixel) in %.3fs (%.2f Msamples/s)\n", options.Width, options.Height,
+        coordinator.GetWorkerCount(), (double)totalSamples / ((double)options.Width * options.Height), seconds, totalSamples / seconds / 1e6);
+    const std::vector<WorkerStats>& stats = coordinator.GetWorkerStats();
+    for(size_t i = 0; i < stats.size(); i++)
+        printf("  Worker %zu: %u tiles, %.3fs\n", i, stats[i].Tiles, stats[i].Seconds);
+
+    if(!ImageWriter::Write(options.Output, coordinator.GetImageData(), coordinator.GetAccumulationData(),
+        coordinator.GetSampleCounts(), coordinator.GetWidth(), coordinator.GetHeight()))
+    {
+        fprintf(stderr, "Failed to write %s (supported: .ppm, .png, .exr)\n", options.Output.c_str());
+        return 1;
+    }
+    printf("Saved %s\n", options.Output.c_str());
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    HeadlessOptions options;
+    if(!ParseArguments(argc, argv, options))
+    {
+        PrintUsage();
+        return 1;
+    }
+    if(!options.WorkerAddress.empty())
+        return RunWorker(options);
+
+    Scene scene;
+    auto loadStart = std::chrono::high_resolution_clock::now();
+    if(!options.ScenePath.empty())
+    {
+        if(!SceneFile::Load(options.ScenePath, scene))
+        {
+            fprintf(stderr, "Failed to load %s\n", options.ScenePath.c_str());
+            return 1;
+        }
+    }
+    else if(options.RandomSpheres > 0)
+        scene = Scenes::RandomSpheres(options.RandomSpheres);
+    else if(options.LitSpheres)
+        scene = Scenes::LitSpheres();
+    else
+        scene = Scenes::TwoSpheres();
+    double loadSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - loadStart).count();
+    printf("Scene: %zu spheres, %zu materials, %zu lights%s, loaded in %.3fms\n", scene.Spheres.size(), scene.Materials.size(),
+        scene.Lights.size(), scene.Acceleration ? " + BVH" : "", loadSeconds * 1000.0);
+
+    if(!options.SaveScenePath.empty())
+    {
+        //Binary snapshots get the BVH too, so loading them skips the build
+        BVH bvh;
+        if(!scene.Acceleration)
+            bvh.Build(scene.Spheres);
+        if(!SceneFile::Save(options.SaveScenePath, scene, scene.Acceleration ? scene.Acceleration.get() : &bvh))
+        {
+            fprintf(stderr, "Failed to write %s\n", options.SaveScenePath.c_str());
+            return 1;
+        }
+        printf("Saved %s\n", options.SaveScenePath.c_str());
+    }
+
+    Camera camera(45.0f, 0.1f, 100.0f);
+    camera.SetRayDirectionCaching(options.Settings.CachedRayDirections);
+    camera.OnResize(options.Width, options.Height);
+    camera.SetPosition(options.Position);
+    camera.SetDirection(options.Direction);
+
+    if(!options.CoordinatorAddress.empty())
+        return RenderDistributed(options, scene, camera);
+
+    Renderer renderer;
+    renderer.GetSettings() = options.Settings;
+    renderer.OnResize(options.Width, options.Height);
+
+    //A checkpoint only fits the scene, camera and settings it was rendered from
+    uint64_t sceneHash = 0, cameraHash = 0, settingsHash = 0;
+    uint32_t resumedFrames = 0;
+    CheckpointWriter checkpointWriter;
+    if(!options.CheckpointPath.empty())
+    {
+        sceneHash = Checkpoint::HashScene(scene);
+        cameraHash = Checkpoint::HashCamera(camera);
+        settingsHash = Checkpoint::HashSettings(options.Settings);
+        if(options.Resume)
+        {
+            Checkpoint::LoadResult result = Checkpoint::Load(options.CheckpointPath, renderer, sceneHash, cameraHash, settingsHash);
+            if(result == Checkpoint::LoadResult::Loaded)
+            {
+                resumedFrames = renderer.GetFrameIndex() - 1;
+                printf("Resumed %s at frame %u\n", options.CheckpointPath.c_str(), resumedFrames);
+            }
+            else if(result == Checkpoint::LoadResult::NotFound)
+                printf("No checkpoint at %s, starting from scratch\n", options.CheckpointPath.c_str());
+            else
+            {
+                fprintf(stderr, "%s is %s\n", options.CheckpointPath.c_str(), result == Checkpoint::LoadResult::Mismatch ?
+                    "a checkpoint of another scene, camera, image size or render settings" : "not a valid checkpoint");
+                return 1;
+            }
+        }
+        std::signal(SIGINT, RequestStop);
+        std::signal(SIGTERM, RequestStop);
+    }
+
+    //Every Render call adds a frame's worth of samples (1 per pixel, spread by error when adaptive, as many as fit with
+    //--frame-budget) to the accumulation buffer
+    //Adaptive renders stop early once every tile is below the error threshold
+    uint64_t totalSamples = 0, totalRays = 0;
+    uint32_t frames = 0;
+    ProfileCounters counters;
+    if(!options.TracePath.empty())
+        Profiler::BeginTrace();
+    auto start = std::chrono::high_resolution_clock::now();
+    auto lastCheckpoint = start;
+    while(resumedFrames + frames < options.Samples && !s_StopRequested)
+    {
+        renderer.Render(scene, camera);
+        Profiler::NextFrame();
+        counters.Add(Profiler::GetLastFrame().Counters);
+        if(renderer.IsConverged())
+            break;
+        totalSamples += renderer.GetSamplesLastFrame();
+        totalRays += renderer.GetRaysLastFrame();
+        frames++;
+
+        //Only copies the buffers, the file gets written while the next frames render
+        //Still busy with the last one (slow disk): try again after the next frame
+        auto now = std::chrono::high_resolution_clock::now();
+        if(!options.CheckpointPath.empty() && std::chrono::duration<float>(now - lastCheckpoint).count() >= options.CheckpointInterval &&
+            checkpointWriter.Write(options.CheckpointPath, renderer, sceneHash, cameraHash, settingsHash))
+            lastCheckpoint = now;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    if(!options.CheckpointPath.empty())
+    {
+        //Final state, so a finished render can also be continued with more samples
+        checkpointWriter.Wait();
+        if(!checkpointWriter.Write(options.CheckpointPath, renderer, sceneHash, cameraHash, settingsHash) || !checkpointWriter.Wait())
+        {
+            fprintf(stderr, "Failed to write %s\n", options.CheckpointPath.c_str());
+            return 1;
+        }
+        printf("Saved %s at frame %u\n", options.CheckpointPath.c_str(), resumedFrames + frames);
+        if(s_StopRequested)
+        {
+            printf("Stopped, continue with --resume\n");
+            return 2;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double pixels = (double)options.Width * options.Height;
+    printf("Rendered %ux%u, %u frames (%.2f samples/pixel) in %.3fs (%.3f ms/frame, %.2f Msamples/s)\n", options.Width, options.Height,
+        frames, totalSamples / pixels, seconds, seconds * 1000.0 / glm::max(frames, 1u), totalSamples / seconds / 1e6);
+    printf("Average path length: %.2f rays/sample\n", totalSamples > 0 ? (double)totalRays / totalSamples : 0.0);
+    if(options.Settings.FrameTimeBudget)
+    {
+        const FrameBudget::Level& level = renderer.GetBudgetLevel();
+        printf("Frame budget %.1fms, last frame: %u samples/pixel, %u bounces, 1/%u resolution\n", options.Settings.TargetFrameTime,
+            level.Samples, level.Bounces, level.Scale);
+    }
+#if RT_PROFILE
+    double rays = (double)glm::max(counters.GetRays(), (uint64_t)1);
+    printf("Rays: %llu primary, %llu bounce, %llu shadow, %.2f rays/path, %.1f%% hits, %.2f sphere tests/ray\n",
+        (unsigned long long)counters.PrimaryRays, (unsigned long long)counters.BounceRays, (unsigned long long)counters.ShadowRays,
+        counters.GetAveragePathLength(), 100.0 * counters.Hits / rays, counters.SphereTests / (rays + counters.ShadowRays));
+#endif
+
+    if(!options.TracePath.empty())
+    {
+        if(!Profiler::EndTrace(options.TracePath))
+        {
+            fprintf(stderr, "Failed to write %s\n", options.TracePath.c_str());
+            return 1;
+        }
+        printf("Saved %s\n", options.TracePath.c_str());
+    }
+
+    if(!ImageWriter::Write(options.Output, renderer.GetImageData(), renderer.GetAccumulationData(),
+        renderer.GetSampleCounts(), renderer.GetWidth(), renderer.GetHeight()))
+    {
+        fprintf(stderr, "Failed to write %s (supported: .ppm, .png, .exr)\n", options.Output.c_str());
+        return 1;
+    }
+    printf("Saved %s\n", options.Output.c_str());
+    return 0;
+}
@@ -1,49 +1,38 @@
 #include "Camera.h"
-#include "Renderer.h"
+#include "RenderThread.h"
+#include "Scenes.h"
+#include "SceneFile.h"
+#include "Profiler.h"
 #include "Walnut/Application.h"
 #include "Walnut/EntryPoint.h"
 #include "Walnut/Image.h"
 #include "Walnut/Random.h"
 #include "Walnut/Timer.h"
 #include <glm/gtc/type_ptr.hpp>
+#include <cfloat>
 
 using namespace Walnut;
 
 class ExampleLayer : public Walnut::Layer
 {
 public:
-	ExampleLayer()
+	ExampleLayer(const std::string& scenePath)
 		:m_Camera(45.0f,0.1f,100.f)
 	{
-		Material& pinkSphere = m_Scene.Materials.emplace_back();
-		pinkSphere.Albedo = {1.0f, 0.0f, 1.0f};
-		pinkSphere.Roughness = 0.0f;
-		
-		Material& blueSphere = m_Scene.Materials.emplace_back();
-		blueSphere.Albedo = {0.2f, 0.3f, 1.0f};
-		blueSphere.Roughness = 0.1f;
-			
-		{
-			Sphere sphere;
-			sphere.Position = {0.0f, 0.0f, 0.0f};
-			sphere.Radius = 1.0f;
-			sphere.MaterialIndex = 0;
-			m_Scene.Spheres.push_back(sphere);
-		}
-		
-		{
-			Sphere sphere;
-			sphere.Position = {0.0f, -101.0f, 0.0f};
-			sphere.Radius = 100.0f;
-			sphere.MaterialIndex = 1;
-			m_Scene.Spheres.push_back(sphere);
-		}
+		//Scene file from the command line (.rtscene text or .rtbin binary), the built-in scene otherwise
+		if (scenePath.empty() || !SceneFile::Load(scenePath, m_Scene))
+			m_Scene = Scenes::TwoSpheres();
+		//The camera moves and the scene gets edited all the time here, keep what still fits the new view and scene
+		m_Settings.TemporalReprojection = true;
+		m_Settings.SelectiveReset = true;
 	}
 	
 	virtual void OnUpdate(float ts) override
 	{
+		RT_PROFILE_ZONE("Camera update");
+		//Handed to the render thread in Render, which restarts accumulation
 		if(m_Camera.OnUpdate(ts))
-			m_Renderer.ResetFrameIndex();
+			m_CameraChanged = true;
 	}
 	virtual void OnUIRender() override
 	{
@@ -51,12 +40,86 @@ public:
 		if (ImGui::Button("Render")) {
 			Render();
 		}
-		ImGui::Text("Last render: %.3fms", m_LastRenderTime);
+		//Everything about the render comes with the frame being presented, the renderer itself is busy on its own thread
+		const RenderThread::Frame& frame = m_RenderThread.GetFrame();
+		ImGui::Text("Last render: %.3fms", frame.RenderTime);
+		ImGui::Text("UI frame: %.3fms", m_LastUIFrameTime);
+		if (frame.PreviewScale > 1)
+			ImGui::Text("Preview 1/%u", frame.PreviewScale);
+		if (frame.Samples > 0)
+			ImGui::Text("Average path length: %.2f rays", (double)frame.Rays / frame.Samples);
 
-		ImGui::Checkbox("Accumulate", &m_Renderer.GetSettings().Accumulate);
+		ImGui::Checkbox("Accumulate", &m_Settings.Accumulate);
+		ImGui::Checkbox("BVH", &m_Settings.UseBVH);
+		//Only offer the kernels this cpu can run
+		const char* simdLevels[] = { "Scalar", "SSE", "AVX2" };
+		int simdLevel = (int)m_Settings.SIMD;
+		if (ImGui::Combo("SIMD", &simdLevel, simdLevels, (int)SphereKernels::GetSupportedLevel() + 1))
+			m_Settings.SIMD = (SIMDLevel)simdLevel;
+		ImGui::Checkbox("Packet tracing", &m_Settings.PacketTracing);
+		ImGui::Checkbox("Wavefront", &m_Settings.Wavefront);
+		const char* tileOrders[] = { "Scanline", "Morton", "Hilbert" };
+		int tileOrder = (int)m_Settings.TileOrdering;
+		if (ImGui::Combo("Tile order", &tileOrder, tileOrders, 3))
+			m_Settings.TileOrdering = (TileOrder)tileOrder;
+		ImGui::Checkbox("Cached ray directions", &m_Settings.CachedRayDirections);
+		ImGui::Checkbox("Jitter", &m_Settings.Jitter);
+		int tileSize = (int)m_Settings.TileSize;
+		if (ImGui::DragInt("Tile size", &tileSize, 1.0f, 4, 256))
+			m_Settings.TileSize = (uint32_t)tileSize;
+		ImGui::Checkbox("Adaptive sampling", &m_Settings.Adaptive);
+		ImGui::DragFloat("Error threshold", &m_Settings.AdaptiveThreshold, 0.001f, 0.001f, 0.5f);
+		if (frame.Converged)
+			ImGui::Text("Converged");
+		else if (m_Settings.Adaptive)
+			ImGui::Text("Samples last frame: %llu", (unsigned long long)frame.Samples);
+		ImGui::Checkbox("Progressive preview", &m_Settings.ProgressivePreview);
+		//Camera moves keep the samples of pixels that still see the same surface
+		ImGui::Checkbox("Temporal reprojection", &m_Settings.TemporalReprojection);
+		if (m_Settings.TemporalReprojection)
+		{
+			int reprojectionMaxSamples = (int)m_Settings.ReprojectionMaxSamples;
+			if (ImGui::DragInt("Max reprojected samples", &reprojectionMaxSamples, 0.5f, 1, 4096))
+				m_Settings.ReprojectionMaxSamples = (uint32_t)reprojectionMaxSamples;
+			ImGui::Text("Reprojected: %.0f%%", frame.ReprojectedShare * 100.0f);
+		}
+		//Scene edits keep the samples of pixels that never touched what was edited
+		ImGui::Checkbox("Selective reset", &m_Settings.SelectiveReset);
+		if (m_Settings.SelectiveReset)
+			ImGui::Text("Reset by last edit: %.0f%%", frame.ResetShare * 100.0f);
+		int maxBounces = (int)m_Settings.MaxBounces;
+		if (ImGui::DragInt("Max bounces", &maxBounces, 0.1f, 1, 32))
+			m_Settings.MaxBounces = (uint32_t)maxBounces;
+		ImGui::Checkbox("Russian roulette", &m_Settings.RussianRoulette);
+		ImGui::Checkbox("Light sampling", &m_Settings.NextEventEstimation);
+		//Frame time budget: the renderer trades samples, bounces and resolution for a steady render time
+		ImGui::Checkbox("Frame time budget", &m_Settings.FrameTimeBudget);
+		if (m_Settings.FrameTimeBudget)
+		{
+			ImGui::DragFloat("Target frame time (ms)", &m_Settings.TargetFrameTime, 0.5f, 1.0f, 1000.0f);
+			int budgetMaxSamples = (int)m_Settings.BudgetMaxSamples;
+			if (ImGui::DragInt("Max samples per frame", &budgetMaxSamples, 0.1f, 1, 64))
+				m_Settings.BudgetMaxSamples = (uint32_t)budgetMaxSamples;
+			int budgetMinBounces = (int)m_Settings.BudgetMinBounces;
+			if (ImGui::DragInt("Min bounces", &budgetMinBounces, 0.1f, 1, (int)m_Settings.MaxBounces))
+				m_Settings.BudgetMinBounces = (uint32_t)budgetMinBounces;
+			ImGui::Text("Budget: %u samples/pixel, %u bounces, 1/%u resolution", frame.Budget.Samples, frame.Budget.Bounces,
+				frame.Budget.Scale);
+		}
+		ImGui::Checkbox("Denoise", &m_Settings.Denoise);
+		int denoiseIterations = (int)m_Settings.DenoiseIterations;
+		if (ImGui::DragInt("Denoise iterations", &denoiseIterations, 0.1f, 1, 8))
+			m_Settings.DenoiseIterations = (uint32_t)denoiseIterations;
+		ImGui::DragFloat("Denoise strength", &m_Settings.DenoiseStrength, 0.05f, 0.1f, 10.0f);
+		//Display encoding of the image, accumulation stays linear
+		bool srgb = m_Settings.OutputEncoding == ImageResolve::Encoding::SRGB;
+		if (ImGui::Checkbox("sRGB output", &srgb))
+			m_Settings.OutputEncoding = srgb ? ImageResolve::Encoding::SRGB : ImageResolve::Encoding::Linear;
 		if (ImGui::Button("Reset")) {
-			m_Renderer.ResetFrameIndex();
+			m_RenderThread.ResetFrameIndex();
 		}
+
+		ProfilerUI();
 		
 		ImGui::End();
 
@@ -67,10 +130,13 @@ public:
 			//Create unique id for controls - else imgui will change all spheres because it does not know which label to target
 			ImGui::PushID(i);
 			
-			Sphere& sphere = m_Scene.Spheres[i];
-			ImGui::DragFloat3("Position", glm::value_ptr(sphere.Position), 0.1f);
-			ImGui::DragFloat("Radius", &sphere.Radius, 0.1f);
-			ImGui::DragInt("Material", &sphere.MaterialIndex, 1.0f, 0, (int) m_Scene.Materials.size() - 1);
+			//Edit a copy and only write it back when something changed - writing copies a scene loaded from a binary file
+			Sphere sphere = m_Scene.Spheres[i];
+			bool changed = ImGui::DragFloat3("Position", glm::value_ptr(sphere.Position), 0.1f);
+			changed |= ImGui::DragFloat("Radius", &sphere.Radius, 0.1f);
+			changed |= ImGui::DragInt("Material", &sphere.MaterialIndex, 1.0f, 0, (int) m_Scene.Materials.size() - 1);
+			if (changed)
+				m_Scene.Spheres.Edit(i) = sphere;
 			
 			ImGui::Separator();
 			ImGui::PopID();
@@ -80,14 +146,48 @@ public:
 		{
 			ImGui::PushID(i);
 
-			Material& material = m_Scene.Materials[i];
-			ImGui::ColorEdit3("Albedo", glm::value_ptr(material.Albedo));
-			ImGui::DragFloat("Roughness", &material.Roughness, 0.05f, 0.0f, 1.0f);
-			ImGui::DragFloat("Metallic", &material.Metallic, 0.05f, 0.0f, 1.0f);
+			Material material = m_Scene.Materials[i];
+			bool changed = ImGui::ColorEdit3("Albedo", glm::value_ptr(material.Albedo));
+			changed |= ImGui::DragFloat("Roughness", &material.Roughness, 0.05f, 0.0f, 1.0f);
+			changed |= ImGui::DragFloat("Metallic", &material.Metallic, 0.05f, 0.0f, 1.0f);
+			changed |= ImGui::ColorEdit3("Emission color", glm::value_ptr(material.EmissionColor));
+			changed |= ImGui::DragFloat("Emission power", &material.EmissionPower, 0.05f, 0.0f, FLT_MAX);
+			if (changed)
+				m_Scene.Materials.Edit(i) = material;
 			
 			ImGui::Separator();
 			ImGui::PopID();
 		}
+
+		for(size_t i = 0; i < m_Scene.Lights.size(); i++)
+		{
+			ImGui::PushID(i);
+
+			Light light = m_Scene.Lights[i];
+			const char* lightTypes[] = { "Directional", "Point" };
+			int lightType = (int)light.Type;
+			bool changed = ImGui::Combo("Light", &lightType, lightTypes, 2);
+			light.Type = (LightType)lightType;
+			if (light.Type == LightType::Directional)
+				changed |= ImGui::DragFloat3("Direction", glm::value_ptr(light.Direction), 0.05f);
+			else
+				changed |= ImGui::DragFloat3("Light position", glm::value_ptr(light.Position), 0.1f);
+			changed |= ImGui::ColorEdit3("Light color", glm::value_ptr(light.Color));
+			changed |= ImGui::DragFloat("Intensity", &light.Intensity, 0.05f, 0.0f, FLT_MAX);
+			//A direction of length 0 points nowhere
+			if (changed && glm::dot(light.Direction, light.Direction) > 0.0f)
+				m_Scene.Lights.Edit(i) = light;
+
+			ImGui::Separator();
+			ImGui::PopID();
+		}
+		if (ImGui::Button("Add light"))
+		{
+			Light light;
+			light.Type = LightType::Point;
+			light.Position = glm::vec3(0.0f, 2.0f, 0.0f);
+			m_Scene.Lights.push_back(light);
+		}
 			ImGui::End();
 
 		//Push style var to get rid of border
@@ -99,7 +199,7 @@ public:
 		m_ViewportHeight= ImGui::GetContentRegionAvail().y;
 
 		//Display image if it exists
-		auto image = m_Renderer.GetFinalImage();
+		auto image = m_FinalImage;
 		if(image)
 			ImGui::Image(image->GetDescriptorSet(), { (float)image->GetWidth(),
 				(float)image->GetHeight()},ImVec2(0,1), ImVec2(1,0));
@@ -113,21 +213,100 @@ public:
 
 	void Render() {
 		Timer timer;
-		m_Renderer.OnResize(m_ViewportWidth, m_ViewportHeight);
-		m_Camera.OnResize(m_ViewportWidth, m_ViewportHeight);
+		//The ray direction buffer only needs to exist when the renderer is set to use it
+		if (m_Camera.IsCachingRayDirections() != m_Settings.CachedRayDirections || m_Camera.GetViewportWidth() != m_ViewportWidth ||
+			m_Camera.GetViewportHeight() != m_ViewportHeight)
+		{
+			m_Camera.SetRayDirectionCaching(m_Settings.CachedRayDirections);
+			m_Camera.OnResize(m_ViewportWidth, m_ViewportHeight);
+			m_CameraChanged = true;
+		}
+
+		//Rendering happens on the render thread: hand it whatever changed, it never makes us wait for a frame
 		//Pass a camera to renderer , instead of having it in renderer itself -> dont want renderer to control where we render from
-		//Pass as a viewport to render from
-		m_Renderer.Render(m_Scene, m_Camera);
-		//Set timer to see how long it took to render
-		m_LastRenderTime = timer.ElapsedMillis();
+		m_RenderThread.SetSettings(m_Settings);
+		m_RenderThread.SetScene(m_Scene);
+		if (m_CameraChanged)
+			m_RenderThread.SetCamera(m_Camera);
+		m_CameraChanged = false;
+
+		//Upload the newest finished frame, if there is one - otherwise the last one stays on screen
+		//Renderer only produces cpu side pixels - the app owns the Walnut::Image and uploads them to the gpu
+		if (m_RenderThread.AcquireFrame())
+		{
+			const RenderThread::Frame& frame = m_RenderThread.GetFrame();
+			//New or resized images have nothing in them yet, otherwise only frames that changed pixels get uploaded
+			//Walnut::Image can only upload whole images, not just the dirty region
+			bool upload = frame.Dirty.Width > 0;
+			if(!m_FinalImage)
+			{
+				m_FinalImage = std::make_shared<Walnut::Image>(frame.Width, frame.Height, Walnut::ImageFormat::RGBA);
+				upload = true;
+			}
+			else if(m_FinalImage->GetWidth() != frame.Width || m_FinalImage->GetHeight() != frame.Height)
+			{
+				m_FinalImage->Resize(frame.Width, frame.Height);
+				upload = true;
+			}
+			if(upload)
+			{
+				RT_PROFILE_ZONE("SetData");
+				m_FinalImage->SetData(frame.ImageData.data());
+			}
+		}
+		//Set timer to see how long the ui side of a frame takes
+		m_LastUIFrameTime = timer.ElapsedMillis();
+	}
+
+	//Counters and zone times of the last frame, and starting/stopping a Chrome trace
+	void ProfilerUI()
+	{
+		if (!ImGui::CollapsingHeader("Profiler"))
+			return;
+#if RT_PROFILE
+		ProfileFrame frame = Profiler::GetLastFrame();
+		const ProfileCounters& counters = frame.Counters;
+		double rays = (double)glm::max(counters.GetRays(), (uint64_t)1);
+		ImGui::Text("Rays: %llu primary, %llu bounce, %llu shadow", (unsigned long long)counters.PrimaryRays,
+			(unsigned long long)counters.BounceRays, (unsigned long long)counters.ShadowRays);
+		ImGui::Text("Average path length: %.2f", counters.GetAveragePathLength());
+		ImGui::Text("Hits: %llu (%.1f%%), misses: %llu", (unsigned long long)counters.Hits, 100.0 * counters.Hits / rays,
+			(unsigned long long)counters.Misses);
+		ImGui::Text("Sphere tests: %llu (%.2f/ray)", (unsigned long long)counters.SphereTests, counters.SphereTests / (rays + counters.ShadowRays));
+
+		//Summed over threads: Tile runs on every render thread at once
+		for (const ProfileZoneStats& zone : frame.Zones)
+			ImGui::Text("%-24s %8.3fms (%u)", zone.Name, zone.Milliseconds, zone.Calls);
+
+		if (!Profiler::IsTracing())
+		{
+			if (ImGui::Button("Start trace"))
+				Profiler::BeginTrace();
+		}
+		else if (ImGui::Button("Stop trace"))
+		{
+			m_TraceMessage = Profiler::EndTrace(m_TracePath) ? "Saved " + m_TracePath : "Failed to write " + m_TracePath;
+		}
+		if (!m_TraceMessage.empty())
+			ImGui::Text("%s", m_TraceMessage.c_str());
+#else
+		ImGui::Text("Profiling is compiled out (RT_PROFILE=0)");
+#endif
 	}
 
 private:
-	Renderer m_Renderer;
+	//Owns the Renderer, m_Settings/m_Camera/m_Scene are the ui's copies it gets handed every frame
+	RenderThread m_RenderThread;
+	Renderer::Settings m_Settings;
+	std::shared_ptr<Walnut::Image> m_FinalImage;
 	uint32_t m_ViewportWidth = 0, m_ViewportHeight = 0;
-	float m_LastRenderTime = 0.0f;
+	float m_LastUIFrameTime = 0.0f;
 	Camera m_Camera;
+	bool m_CameraChanged = true;
 	Scene m_Scene; 
+	//Open in chrome://tracing or ui.perfetto.dev
+	std::string m_TracePath = "RayTracing-trace.json";
+	std::string m_TraceMessage;
 };
 
 //Walnut app entry point
@@ -137,7 +316,7 @@ Walnut::Application* Walnut::CreateApplication(int argc, char** argv)
 	spec.Name = "RayTracer";
 
 	Walnut::Application* app = new Walnut::Application(spec);
-	app->PushLayer<ExampleLayer>();
+	app->PushLayer(std::make_shared<ExampleLayer>(argc > 1 ? argv[1] : ""));
 	app->SetMenubarCallback([app]()
 	{
 		if (ImGui::BeginMenu("File"))
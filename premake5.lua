@@ -1,10 +1,36 @@
 -- premake5.lua
+newoption
+{
+   trigger = "headless",
+   description = "Only generate the core library and command line tools (no Walnut/Vulkan), for GPU-less build machines"
+}
+
+newoption
+{
+   trigger = "render-kernels",
+   value = "SET",
+   description = "Specialised render kernels to compile, fewer make a smaller binary",
+   allowed =
+   {
+      { "full", "Every combination of render options, for every bounce limit up to 8 (default)" },
+      { "options", "Every combination of render options, bounce limit read at runtime" },
+      { "dynamic", "Only the kernel that reads everything at runtime" }
+   },
+   default = "full"
+}
+
 workspace "RayTracing"
    architecture "x64"
    configurations { "Debug", "Release", "Dist" }
-   startproject "RayTracing"
+   if _OPTIONS["headless"] then
+      startproject "RayTracingHeadless"
+   else
+      startproject "RayTracing"
+   end
 
 outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
-include "Walnut/WalnutExternal.lua"
+if not _OPTIONS["headless"] then
+   include "Walnut/WalnutExternal.lua"
+end
 
-include "RayTracing"
\ No newline at end of file
+include "RayTracing"